@@ -29,3 +29,8 @@ cd "$BUILD_ROOT/src/host/libpixyusb"
 cmake -DBoost_NO_SYSTEM_PATHS=ON -DBoost_LIBRARY_DIRS="$BUILD_ROOT/build/boost_1_65_1/stage/lib" -DBoost_INCLUDE_DIR="$BUILD_ROOT/build/boost_1_65_1" -DLIBUSB_1_INCLUDE_DIRS="$BUILD_ROOT/build/libusb-1.0.21_out/include/libusb-1.0" -DLIBUSB_1_LIBRARIES="$BUILD_ROOT/build/libusb-1.0.21_out/lib/libusb-1.0.a" -DCMAKE_C_COMPILER=arm-frc-linux-gnueabi-gcc -DCMAKE_CXX_COMPILER=arm-frc-linux-gnueabi-g++ -DCMAKE_INSTALL_PREFIX="$BUILD_ROOT/out"
 make
 make install
+
+cd "$BUILD_ROOT/src/host/pixyvision"
+cmake -DCMAKE_C_COMPILER=arm-frc-linux-gnueabi-gcc -DCMAKE_CXX_COMPILER=arm-frc-linux-gnueabi-g++ -DCMAKE_INSTALL_PREFIX="$BUILD_ROOT/out" .
+make
+make install
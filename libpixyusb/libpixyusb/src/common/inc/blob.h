@@ -25,9 +25,6 @@
 //
 // *** Priority 4:
 //
-// Think about heap management of CBlobs
-// Think about heap management of SLinkedSegments
-//
 // *** Priority 5 (maybe never do):
 // 
 // Try small and large SMoments structure (small for segment)
@@ -35,6 +32,7 @@
 //
 // *** DONE
 //
+// DONE Heap management of CBlobs and SLinkedSegments (CPool)
 // DONE Compute elongation, major/minor axes (SMoments::GetStats)
 // DONE Make XRC LUT
 // DONE Use XRC LUT
@@ -54,11 +52,17 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <new>
 //#include <memory.h>
 #include <math.h>
 
 //#define INCLUDE_STATS
 
+#ifndef PIXY
+#define BA_MAX_BANDS   8
+#define BA_MAX_LABELS  512
+#endif
+
 // Uncomment this for verbose output for testing
 //#include <iostream.h>
 
@@ -79,6 +83,8 @@ struct SMomentStats {
 // Full-screen blob area is 97856
 // Full-screen centroid is 176,139
 // sumX, sumY is then 17222656, 13601984; well within 32 bits
+// With INCLUDE_STATS the second moments are always accumulated, so that
+// adding a segment doesn't branch, computeAxes only matters to GetStats().
 struct SMoments {
     // Skip major/minor axis computation when this is false
     static bool computeAxes;
@@ -103,11 +109,9 @@ struct SMoments {
 #ifdef INCLUDE_STATS
         sumX += moments.sumX;
         sumY += moments.sumY;
-        if (computeAxes) {
-            sumXX += moments.sumXX;
-            sumYY += moments.sumYY;
-            sumXY += moments.sumXY;
-        }
+        sumXX += moments.sumXX;
+        sumYY += moments.sumYY;
+        sumXY += moments.sumXY;
 #endif
     }
 #ifdef INCLUDE_STATS
@@ -152,13 +156,12 @@ struct SSegment {
         moments.sumX = ( (e2-s2) + (e-s) ) / 2;
         moments.sumY = (e-s) * y;
 
-        if (SMoments::computeAxes) {
-            int e3= e2*e;
-            int s3= s2*s;
-            moments.sumXY= moments.sumX*y;
-            moments.sumXX= (2*(e3-s3) + 3*(e2-s2) + (e-s)) / 6;
-            moments.sumYY= moments.sumY*y;
-        }
+        // 1023^3 is close to the int range on the host's wider frames
+        long long e3= (long long)e2*e;
+        long long s3= (long long)s2*s;
+        moments.sumXY= moments.sumX*y;
+        moments.sumXX= (2*(e3-s3) + 3*(e2-s2) + (e-s)) / 6;
+        moments.sumYY= moments.sumY*y;
 #endif
     }
 #ifdef INCLUDE_STATS
@@ -173,6 +176,92 @@ struct SLinkedSegment {
         segment(segmentInit), next(NULL) {}
 };
 
+// Objects per block of a CPool
+#ifdef PIXY
+#define POOL_BLOCK_SIZE 16
+#else
+#define POOL_BLOCK_SIZE 64
+#endif
+
+// Free-list arena for fixed size objects.  Memory comes from the heap one
+// block of POOL_BLOCK_SIZE objects at a time and goes back only when the
+// pool is destroyed, so once the pool has grown to the largest frame,
+// Alloc() and Free() never touch the heap.  Reset() frees every object at
+// once without calling destructors.
+template <class T> class CPool {
+    union SSlot {
+        SSlot *next;
+        void *alignPointer;
+        long long alignLong;
+        char object[sizeof(T)];
+    };
+    struct SBlock {
+        SSlot slots[POOL_BLOCK_SIZE];
+        SBlock *next;
+    };
+
+    SBlock *firstBlock;
+    SBlock *currentBlock;   // block slots are bump allocated from
+    SSlot *nextSlot;        // next unused slot of currentBlock
+    SSlot *freeSlots;       // slots returned by Free()
+
+public:
+    CPool() {
+        firstBlock= currentBlock= NULL;
+        nextSlot= NULL;
+        freeSlots= NULL;
+    }
+    ~CPool() {
+        SBlock *tmp;
+        while (firstBlock) {
+            tmp= firstBlock;
+            firstBlock= tmp->next;
+            delete tmp;
+        }
+    }
+
+    // Returns uninitialized memory for one T, NULL if the heap is full
+    void *Alloc() {
+        SSlot *slot;
+        if (freeSlots) {
+            slot= freeSlots;
+            freeSlots= slot->next;
+            return slot;
+        }
+        if (currentBlock==NULL || nextSlot==currentBlock->slots+POOL_BLOCK_SIZE) {
+            // Reuse the blocks of previous frames before growing
+            SBlock *block= currentBlock ? currentBlock->next : firstBlock;
+            if (block==NULL) {
+                block= new (std::nothrow) SBlock;
+                if (block==NULL)
+                    return NULL;
+                block->next= NULL;
+                if (currentBlock)
+                    currentBlock->next= block;
+                else
+                    firstBlock= block;
+            }
+            currentBlock= block;
+            nextSlot= block->slots;
+        }
+        return nextSlot++;
+    }
+
+    void Free(void *object) {
+        SSlot *slot= (SSlot *)object;
+        slot->next= freeSlots;
+        freeSlots= slot;
+    }
+
+    void Reset() {
+        currentBlock= NULL;
+        nextSlot= NULL;
+        freeSlots= NULL;
+    }
+};
+
+typedef CPool<SLinkedSegment> CSegmentPool;
+
 class CBlob {
     // These are at the beginning for fast inclusion checking
 public:
@@ -213,11 +302,19 @@ public:
 
     SMoments moments;
 
+    // Where segments come from, the heap if NULL
+    CSegmentPool *segmentPool;
+
+#ifndef PIXY
+    // Seam label given by CBlobAssembler::bandTop, -1 if none
+    int label;
+#endif
+
     static bool recordSegments;
     // Set to true for testing code only.  Very slow!
     static bool testMoments;
 
-    CBlob();
+    CBlob(CSegmentPool *segmentPoolInit=NULL);
     ~CBlob();
 
     int GetArea() const {
@@ -261,6 +358,8 @@ public:
 // At the end of a frame, call EndFrame() on each assembler
 // Get blobs from finishedBlobs.  Blobs will remain valid until
 //    the next call to Reset(), at which point they will be deleted.
+//    Blobs and their segments come from per-assembler pools, which
+//    Reset() empties at once.
 //
 // To get statistics for a blob, do the following:
 //  SMomentStats stats;
@@ -290,6 +389,13 @@ public:
     CBlob *finishedBlobs;
     short maxRowDelta;
     static bool keepFinishedSorted;
+#ifndef PIXY
+    // Row where this assembler's band starts, -1 if it assembles whole
+    // frames.  Blobs created on this row get seam labels 0, 1, 2... in
+    // segment order, and are kept even if short, since the band above
+    // may continue them.
+    short bandTop;
+#endif
 
 public:
     CBlobAssembler();
@@ -322,6 +428,12 @@ public:
     // Assert that finishedBlobs is in fact sorted.  For testing only.
     void AssertFinishedSorted();
 
+#ifndef PIXY
+    // Returns the label now carried by the blob that took in the blob
+    // labelled 'label', which may have been assimilated since
+    short FindLabel(short label);
+#endif
+
 protected:
     // Manage currentBlob
     //
@@ -350,8 +462,79 @@ protected:
     void BlobNewRow(CBlob **ptr);
     void RewindCurrent();
     void AdvanceCurrent();
+    void DeleteBlob(CBlob *blob);
 
     int m_blobCount;
+    CPool<CBlob> m_blobPool;
+    CSegmentPool m_segmentPool;
+
+#ifndef PIXY
+    // A row has at most 512 segments, since columns have 10 bits
+    short m_labels[BA_MAX_LABELS]; // parent of each label
+    short m_numLabels;
+#endif
+};
+
+#ifndef PIXY
+// Strategy for using CBandAssembler:
+//
+// Assembly is strictly top to bottom, so one signature is one thread's
+// work.  CBandAssembler splits a frame into horizontal bands instead, with
+// one CBlobAssembler each, so that the bands can be assembled on different
+// threads.  Blobs that touch across a seam are then joined: a blob starting
+// on the band's first row joins every blob of the band above whose
+// lastBottom span it overlaps, as the serial assembly would have attached
+// its segments.  This relies on maxRowDelta being 1.
+//
+// The result matches the serial assembly except where the serial one
+// attaches a segment through the gap between two segments of the same blob
+// on the row above, a connection that comes from rows above the seam.
+// Those gaps can be bridged on any row of a band, not only at its seam,
+// so matching them would mean carrying the blobs of the bands above into
+// each band, which is the serial dependency the bands remove.  Until the
+// blocks match, the bands are not part of pixyvision.h.
+//
+// Call Split() with the frame's segments in row order, then
+// AssembleBand() for each band, possibly concurrently, then Merge() to
+// pass the blobs to an assembler's finished list, as if that assembler
+// had done the work.  The blobs stay valid until the bands are assembled
+// again.
+
+class CBandAssembler {
+public:
+    CBandAssembler();
+    ~CBandAssembler();
+
+    // 1 to BA_MAX_BANDS
+    int SetBands(int bands);
+
+    void Split(const SSegment *segments, int numSegments);
+    void AssembleBand(int band);
+    // -1 if the seam blobs could not be indexed, the blobs passed on
+    // are then incomplete
+    int Merge(CBlobAssembler &assembler);
+
+private:
+    int Reserve(int count);
+    int Find(int index);
+    void Join(int index0, int index1);
+
+    CBlobAssembler m_assemblers[BA_MAX_BANDS];
+    int m_numBands;
+    int m_frameBands; // bands of this frame, fewer if it has fewer rows
+
+    const SSegment *m_segments;
+    int m_starts[BA_MAX_BANDS+1]; // first segment of each band
+    int m_ends[BA_MAX_BANDS];     // end of the segments each band took
+    short m_tops[BA_MAX_BANDS];   // first row of each band
+    short m_lastRow;
+
+    // Union-find over the blobs touching a seam, grown as needed
+    CBlob **m_blobs;
+    int *m_parents;
+    int m_capacity;
+    CBlob *m_owners[BA_MAX_LABELS]; // blob of each seam segment
 };
+#endif
 
 #endif // _BLOB_H
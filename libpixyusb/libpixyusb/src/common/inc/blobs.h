@@ -20,18 +20,38 @@
 #include "pixytypes.h"
 #include "colorlut.h"
 #include "qqueue.h"
+#ifndef PIXY
+#include "rowkernel.h"
+#include "simplevector.h"
+#include "boxgrid.h"
+#endif
 
+#ifndef MAX_BLOBS // host builds may raise it
 #define MAX_BLOBS             100
+#endif
 #define MAX_BLOBS_PER_MODEL   20
 #define MAX_MERGE_DIST        7
 #define MIN_AREA              20
 #define MIN_COLOR_CODE_AREA   10
 #define MAX_CODED_DIST        8
 #define MAX_COLOR_CODE_MODELS 5
+#define MAX_QVALS             0x8000
+#define QVAL_BATCH            64 // host, Qvals dequeued at a time
 
 #define BL_BEGIN_MARKER	      0xaa55
 #define BL_BEGIN_MARKER_CC    0xaa56
 
+#ifndef PIXY
+// Runs tasks 0 to count-1, possibly concurrently, and returns when all of
+// them are done
+class TaskRunner
+{
+public:
+    virtual ~TaskRunner() {}
+    virtual void run(void (*task)(void *arg, uint32_t index), void *arg, uint32_t count) = 0;
+};
+#endif
+
 enum ColorCodeMode
 {
     DISABLED = 0,
@@ -53,7 +73,22 @@ public:
     int setParams(uint16_t maxBlobs, uint16_t maxBlobsPerModel, uint32_t minArea, ColorCodeMode ccMode);
     int runlengthAnalysis();
 #ifndef PIXY
+    int blobify(const Frame8 &frame);
+    int runlengthAnalysis(const Frame8 &frame);
     void getRunlengths(uint32_t **qvals, uint32_t *len);
+    // with a runner, segments are kept per signature and each signature is
+    // assembled as a task at the end of the frame, NULL assembles as they come
+    void setTaskRunner(TaskRunner *runner);
+    // with a runner and more than 1 band, each signature is split into
+    // horizontal bands assembled as separate tasks (see CBandAssembler)
+    int setBands(uint8_t bands);
+    // with the grid, combine() and combine2() only compare blobs that are
+    // near each other once there are BG_MIN_BOXES of them, same results
+    void setUseGrid(bool useGrid);
+#endif
+#ifdef INCLUDE_STATS
+    // moments of the blobs and color code blobs of getBlobs(), same order
+    void getMoments(SMoments **moments, SMoments **ccMoments);
 #endif
 
 	ColorLUT m_clut;
@@ -61,9 +96,12 @@ public:
 
 private:
     int handleSegment(uint8_t signature, uint16_t row, uint16_t startCol, uint16_t length);
-	void endFrame();
+	int endFrame();
+    void collectBlobs();
     uint16_t combine(uint16_t *blobs, uint16_t numBlobs);
     uint16_t combine2(uint16_t *blobs, uint16_t numBlobs);
+    uint16_t firstNear(uint16_t i, uint16_t numBlobs);
+    uint16_t nextNear(uint16_t j, uint16_t numBlobs);
     uint16_t compress(uint16_t *blobs, uint16_t numBlobs);
 
     bool closeby(BlobA *blob0, BlobA *blob1);
@@ -76,6 +114,7 @@ private:
     void cleanup2(BlobA *blobs[], int16_t *numBlobs);
     bool analyzeDistances(BlobA *blobs0[], int16_t numBlobs0, BlobA *blobs[], int16_t numBlobs, BlobA **blobA, BlobA **blobB);
     void mergeClumps(uint16_t scount0, uint16_t scount1);
+    uint16_t clump(BlobA *blob);
 
     void printBlobs();
 
@@ -99,10 +138,33 @@ private:
     uint16_t m_maxCodedDist;
     ColorCodeMode m_ccMode;
     BlobA *m_maxBlob;
+#ifdef INCLUDE_STATS
+    SMoments *m_moments;   // MAX_BLOBS entries, parallel to m_blobs
+    SMoments *m_ccMoments; // MAX_BLOBS entries, parallel to m_ccBlobs
+#endif
 
 #ifndef PIXY
     uint32_t m_numQvals;
     uint32_t *m_qvals;
+    RowKernel m_rowKernel;
+
+    static void assembleTask(void *arg, uint32_t index);
+    static void bandTask(void *arg, uint32_t index);
+    TaskRunner *m_runner;
+    SimpleVector<SSegment> m_segments[CL_NUM_SIGNATURES];
+    uint8_t m_order[CL_NUM_SIGNATURES]; // signature of each task
+    CBandAssembler *m_bandAssemblers; // one per signature, NULL if 1 band
+    uint8_t m_numBands;
+    BoxGrid m_grid;
+    bool m_useGrid;
+    bool m_gridBuilt; // during combine(), combine2() and processCC()
+
+    // processCC() scratch, MAX_BLOBS+1 entries each in one allocation
+    uint16_t findClump(uint16_t index);
+    void setClumps(uint16_t count);
+    uint16_t *m_clumpParents; // union-find over clump indexes
+    uint16_t *m_clumpHeads;   // first blob of each clump, m_numBlobs if none
+    uint16_t *m_clumpNext;    // next blob of the same clump
 #endif
 };
 
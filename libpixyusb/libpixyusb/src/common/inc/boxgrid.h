@@ -0,0 +1,67 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef BOXGRID_H
+#define BOXGRID_H
+
+#include <stdint.h>
+
+#define BG_CELL_SHIFT         4  // 16x16 grid cells
+#define BG_MIN_BOXES          48 // fewer boxes are compared pairwise
+
+// Uniform grid over the boxes of a Blobs::m_blobs list (model, left, right,
+// top, bottom), so that Blobs::combine() and Blobs::combine2() only compare
+// a box with the boxes near it instead of with every box after it.  Each box
+// is filed in the cells it covers once grown by the margin, so the boxes
+// found for a box include every box within the margin of it.
+class BoxGrid
+{
+public:
+    BoxGrid();
+    ~BoxGrid();
+
+    // Files the valid boxes (nonzero model).  Returns -1 if out of memory.
+    int build(const uint16_t *blobs, uint16_t numBlobs, uint16_t margin);
+
+    // Boxes after box 'index' that may be within the margin of it, in
+    // increasing order, 'end' when there are no more.  'index' must not
+    // have been moved since build().
+    uint16_t first(uint16_t index, uint16_t end);
+    uint16_t next(uint16_t end)
+    {
+        return m_nearIndex<m_numNear ? m_near[m_nearIndex++] : end;
+    }
+
+private:
+    int reserve(uint32_t cells, uint32_t entries, uint16_t boxes);
+
+    const uint16_t *m_blobs;
+    uint16_t m_cols;
+    uint16_t m_rows;
+
+    uint32_t *m_cellStarts;   // first entry of each cell, cells+1 of them
+    uint16_t *m_entries;      // boxes of each cell, in increasing order
+    uint32_t m_cellCapacity;
+    uint32_t m_entryCapacity;
+
+    uint32_t *m_stamps;       // last query that found each box
+    uint32_t m_stamp;
+    uint16_t *m_near;
+    uint16_t m_numNear;
+    uint16_t m_nearIndex;
+    uint16_t m_boxCapacity;
+};
+
+#endif // BOXGRID_H
@@ -19,6 +19,12 @@
 #define CRP_RES_ERROR_MEMORY            -5
 #define CRP_RES_ERROR_NOT_CONNECTED     -6
 
+// protocol events reported through Chirp::handleEvent()
+#define CRP_EVENT_RESYNC                0 // packet discarded while searching for a start code
+#define CRP_EVENT_NACK_SENT             1
+#define CRP_EVENT_NACK_RECEIVED         2
+#define CRP_EVENT_CRC_ERROR             3
+
 #define CRP_MAX_NAK                     3
 #define CRP_RETRIES                     3
 #define CRP_HEADER_TIMEOUT    	        100
@@ -204,7 +210,7 @@ class Chirp
 {
 public:
     Chirp(bool hinterested=false, bool client=false, Link *link=NULL);
-    ~Chirp();
+    virtual ~Chirp();
 
     virtual int init(bool connect);
     int setLink(Link *link);
@@ -239,6 +245,7 @@ protected:
     int recvChirp(uint8_t *type, ChirpProc *proc, void *args[], bool wait=false); // null pointer terminates
     virtual int handleChirp(uint8_t type, ChirpProc proc, const void *args[]); // null pointer terminates
     virtual void handleXdata(const void *data[]) {}
+    virtual void handleEvent(uint8_t event) {}
     virtual int sendChirp(uint8_t type, ChirpProc proc);
 
     uint8_t *m_buf;
@@ -33,6 +33,30 @@
 #define CL_DEFAULT_TOL                  0.80f
 #define CL_DEFAULT_CCGAIN               1.5f
 #define CL_MODEL_TYPE_COLORCODE         1
+#define CL_MAX_Y                        (3*((1<<8)-1))
+#define CL_TABLE_Y_SHIFT                4
+#define CL_TABLE_Y_BINS                 ((CL_MAX_Y>>CL_TABLE_Y_SHIFT)+1)
+#define CL_TABLE_SIZE                   (CL_LUT_SIZE*CL_TABLE_Y_BINS)
+#define CL_CLASSIFIER_EXACT             0
+#define CL_CLASSIFIER_TABLE             1
+#define CL_SORT_BITS                    9 // 2 passes sort the CL_LUT_ENTRY_SCALE+2 bits of u or v
+
+#ifndef PIXY
+// ceil(2^33/c) for each brightness c, see clDivide()
+extern uint64_t g_clReciprocals[CL_MAX_Y+1];
+
+// Same as (x<<CL_LUT_ENTRY_SCALE)/c, truncated, for |x|<=255 and 0<c<=CL_MAX_Y,
+// with a multiply instead.  ceil(2^33/c) is high by e/c with e<c<2^10, and
+// |x<<CL_LUT_ENTRY_SCALE|*e < 2^23*2^10, so the quotient is high by less
+// than 1/c and truncates to the same integer.
+inline int32_t clDivide(int32_t x, int32_t c)
+{
+    uint32_t q;
+
+    q = ((uint64_t)((x<0 ? -x : x)<<CL_LUT_ENTRY_SCALE)*g_clReciprocals[c])>>33;
+    return x<0 ? -(int32_t)q : (int32_t)q;
+}
+#endif
 
 
 struct ColorSignature
@@ -71,13 +95,20 @@ public:
     bool next(UVPixel *uv, RGBPixel *rgb=NULL);
     bool reset(bool cleari=true);
 	uint32_t averageRgb(uint32_t *pixels=NULL);
+#ifndef PIXY
+    // Batch version of next(): decodes all of the pixels, a row at a time,
+    // into the arrays us and vs, which must hold size() values.  Returns
+    // the number decoded.
+    uint32_t decode(int32_t *us, int32_t *vs);
+    uint32_t size();
+#endif
 
 private:
     bool nextHelper(UVPixel *uv, RGBPixel *rgb);
 
     Frame8 m_frame;
     RectA m_region;
-    uint32_t m_x, m_y;
+    int32_t m_x, m_y; // signed: m_pixels[m_x - 1] must not wrap on 64-bit hosts
     uint8_t *m_pixels;
     const Points *m_points;
     int m_i;
@@ -104,11 +135,23 @@ public:
 	void setGrowDist(uint32_t dist);
     void setCCGain(float gain);
     uint32_t getType(uint8_t signum);
+#ifndef PIXY
+    int setClassifier(uint8_t classifier);
+    // Regenerates the LUT for one signature after setSignature() or
+    // setSigRange().  Same LUT as generateLUT(), provided the brightness
+    // and the color code gain haven't changed since the last generateLUT().
+    int updateLUT(uint8_t signum);
+#endif
 
     // these should be in little access methods, but they're here to speed things up a tad
     ColorSignature m_signatures[CL_NUM_SIGNATURES];
     RuntimeSignature m_runtimeSigs[CL_NUM_SIGNATURES];
     uint32_t m_miny;
+#ifndef PIXY
+    // CL_CLASSIFIER_TABLE only: signature of each LUT bin and brightness bin,
+    // indexed by (c>>CL_TABLE_Y_SHIFT)<<(CL_LUT_COMPONENT_SCALE*2) | bin
+    uint8_t *m_table;
+#endif
 
 private:
     bool growRegion(RectA *region, const Frame8 &frame, uint8_t dir);
@@ -124,6 +167,31 @@ private:
     float m_minRatio;
     float m_ccGain;
     float m_sigRanges[CL_NUM_SIGNATURES];
+#ifndef PIXY
+    void generateTable();
+    void generateTableBin(int32_t bin);
+
+    // iterate() decodes the pixels into m_us and m_vs once and sorts them,
+    // so that each pass of its search counts with binary searches.
+    // growRegion() decodes the pixels of its points as it tests them and
+    // leaves them there for iterate(), with m_uvGrown set.
+    bool reserveUV(uint32_t size);
+    bool decode(IterPixel *ip);
+    void sortUV();
+    void calcRatios(ColorSignature *sig, float ratios[]);
+    // same as getMean(), but leaves the decoded pixels after the first
+    // m_uvSize of m_us and m_vs, and returns their number
+    uint32_t decodeMean(const RectA &region, const Frame8 &frame, UVPixel *mean);
+    int32_t *m_us;
+    int32_t *m_vs;
+    int32_t *m_uvTemp;
+    uint32_t m_uvSize;
+    uint32_t m_uvCapacity;
+    bool m_uvGrown;
+
+    // signatures that match somewhere in each LUT bin, bit signum-1
+    uint8_t m_binSigs[CL_LUT_SIZE];
+#endif
 };
 
 #endif // COLORLUT_H
@@ -57,6 +57,11 @@ typedef struct
 #endif
 
 
+#ifndef PIXY
+#define QQ_CACHE_LINE 64
+#endif
+
+#ifdef PIXY
 struct QqueueFields
 {
     volatile uint16_t readIndex;
@@ -68,6 +73,32 @@ struct QqueueFields
     // (array size below doesn't matter-- we're just going to cast a pointer to this struct)
     Qval data[1]; // data
 };
+#else
+// On the host the producer and the consumer are threads of a multicore
+// CPU, so the queue is a single producer, single consumer ring: each side
+// writes only the fields of its own cache line, publishes its count with a
+// release store and reads the other side's count with an acquire load.
+// Each side also keeps the other's count as it last read it, and only
+// reads the shared one again when that isn't enough.
+struct QqueueFields
+{
+    // consumer's line
+    uint32_t consumed;
+    uint32_t readIndex;
+    uint32_t producedSeen;
+    uint8_t consumerPad[QQ_CACHE_LINE-3*sizeof(uint32_t)];
+
+    // producer's line
+    uint32_t produced;
+    uint32_t writeIndex;
+    uint32_t consumedSeen;
+    uint8_t producerPad[QQ_CACHE_LINE-3*sizeof(uint32_t)];
+
+    Qval data[1]; // data
+};
+
+struct QqueueWait;
+#endif
 
 #ifdef __cplusplus  // M4 is C++ and the "consumer" of data
 
@@ -78,12 +109,21 @@ public:
     ~Qqueue();
 
     uint32_t dequeue(Qval *val);
+#ifdef PIXY
 	uint32_t queued()
 	{
 		return m_fields->produced - m_fields->consumed;
 	}
-#ifndef PIXY
+#else
+    uint32_t queued();
     int enqueue(Qval *val);
+    // Bulk versions, which copy up to n Qvals and return the number copied.
+    // Blocking, dequeue() waits for at least 1 and enqueue() for room for all n.
+    uint32_t dequeue(Qval *vals, uint32_t n);
+    uint32_t enqueue(const Qval *vals, uint32_t n);
+    // Blocking, dequeue() waits for a Qval and enqueue() for room instead
+    // of returning 0, for a producer and a consumer on separate threads.
+    int setBlocking(bool blocking);
 #endif
 
     uint32_t readAll(Qval *mem, uint32_t size);
@@ -91,6 +131,16 @@ public:
 
 private:
     QqueueFields *m_fields;
+#ifndef PIXY
+    uint8_t *m_memory;
+    QqueueWait *m_wait; // NULL unless blocking
+
+    uint32_t readable(uint32_t want);
+    uint32_t writable(uint32_t want);
+    uint32_t wait(bool producer);
+    void wake();
+    void consume(uint32_t n);
+#endif
 };
 
 #else //  M0 is C and the "producer" of data (Qvals)
@@ -0,0 +1,69 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef ROWKERNEL_H
+#define ROWKERNEL_H
+
+#include <stdint.h>
+
+#define RK_MAX_CELLS          512 // 2x2 Bayer cells per line pair, 1024 pixel wide frames
+#define RK_MASK_WORDS         (RK_MAX_CELLS/32)
+
+class ColorLUT;
+
+// Host replacement for the M0 side of the Qqueue and for the per-Qval checks
+// of Blobs::runlengthAnalysis(). Classifies every 2x2 Bayer cell of a line pair
+// against the color LUT and against the runtime bounds of all signatures (or
+// ColorLUT::m_table with CL_CLASSIFIER_TABLE), 16 cells at a time where SSE2
+// is available, and keeps the results as bitmasks so runs can be extracted
+// without touching the cells that don't matter.
+// Cell i is the cell whose red pixel is at x=2i+1.
+class RowKernel
+{
+public:
+    RowKernel(const uint8_t *lut, const ColorLUT *clut);
+
+    // line points to the red (odd) line of the pair, the blue line precedes it.
+    // Returns the number of cells in the line pair.
+    uint16_t classify(const uint8_t *line, uint16_t width);
+
+    static uint32_t lowestBit(uint32_t bits)
+    {
+#ifdef __GNUC__
+        return __builtin_ctz(bits);
+#else
+        uint32_t bit;
+        for (bit=0; (bits&1)==0; bit++)
+            bits >>= 1;
+        return bit;
+#endif
+    }
+
+    uint32_t m_mask[RK_MASK_WORDS]; // bit i set if cell i hit the LUT
+    uint32_t m_pass[RK_MASK_WORDS]; // bit i set if cell i also passed the bounds of m_sig[i]
+    uint8_t m_sig[RK_MAX_CELLS];    // LUT signature of each cell, 0 if none
+
+private:
+    void classifyCells(const uint8_t *line, uint16_t width, uint16_t cell, uint16_t end);
+
+    const uint8_t *m_lut;
+    const ColorLUT *m_clut;
+
+    int16_t m_u[RK_MAX_CELLS];      // r-g, same as Qval::m_u
+    int16_t m_v[RK_MAX_CELLS];      // b-g, same as Qval::m_v
+    uint16_t m_y[RK_MAX_CELLS];     // r+g+b, same as Qval::m_y
+};
+
+#endif // ROWKERNEL_H
@@ -16,7 +16,7 @@
 #include <new>
 #ifdef PIXY
 #include "pixy_init.h"
-#else
+#elif !defined(HOST)
 #include "pixymon.h"
 #endif
 #include "debug.h"
@@ -38,7 +38,11 @@ bool CBlob::recordSegments= false;
 // Set to true for testing code only.  Very slow!
 bool CBlob::testMoments= false;
 // Skip major/minor axis computation when this is false
+#ifdef PIXY
 bool SMoments::computeAxes= false;
+#else
+bool SMoments::computeAxes= true;
+#endif
 int CBlob::leakcheck=0;
 
 #ifdef INCLUDE_STATS
@@ -98,23 +102,25 @@ void SSegment::GetMomentsTest(SMoments &moments) const {
         moments.area++;
         moments.sumX += x;
         moments.sumY += y;
-        if (SMoments::computeAxes) {
-            moments.sumXY += x*y;
-            moments.sumXX += x*x;
-            moments.sumYY += y*y;
-        }
+        moments.sumXY += x*y;
+        moments.sumXX += x*x;
+        moments.sumYY += y*y;
     }
 }
 #endif
 
 ///////////////////////////////////////////////////////////////////////////
 // CBlob
-CBlob::CBlob() 
+CBlob::CBlob(CSegmentPool *segmentPoolInit) 
 {
     DBG_BLOB(leakcheck++);
     // Setup pointers
+    segmentPool= segmentPoolInit;
     firstSegment= NULL;
     lastSegmentPtr= &firstSegment;
+#ifndef PIXY
+    label= -1;
+#endif
 
     // Reset blob data
     Reset();
@@ -144,7 +150,10 @@ CBlob::Reset()
     while(firstSegment!=NULL) {
         tmp = firstSegment;
         firstSegment = tmp->next;
-        delete tmp;
+        if (segmentPool)
+            segmentPool->Free(tmp);
+        else
+            delete tmp;
     }
     lastSegmentPtr= &firstSegment;
 }
@@ -186,7 +195,12 @@ CBlob::Add(const SSegment &segment)
     }
     if (recordSegments) {
         // Add segment to the _end_ of the linked list
-        *lastSegmentPtr= new (std::nothrow) SLinkedSegment(segment);
+        if (segmentPool) {
+            void *memory= segmentPool->Alloc();
+            *lastSegmentPtr= memory ? new (memory) SLinkedSegment(segment) : NULL;
+        }
+        else
+            *lastSegmentPtr= new (std::nothrow) SLinkedSegment(segment);
         if (*lastSegmentPtr==NULL)
             return;
         lastSegmentPtr= &((*lastSegmentPtr)->next);
@@ -217,7 +231,7 @@ CBlob::Assimilate(CBlob &futileResister)
         lastBottom.endCol= futileResister.lastBottom.endCol;
     }
     
-    if (recordSegments) {
+    if (recordSegments && futileResister.segmentPool==segmentPool) {
         // Take segments from futileResister, append on end
         *lastSegmentPtr= futileResister.firstSegment;
         lastSegmentPtr= futileResister.lastSegmentPtr;
@@ -225,6 +239,32 @@ CBlob::Assimilate(CBlob &futileResister)
         futileResister.lastSegmentPtr= &futileResister.firstSegment;
         // Futile resister is left with no segments
     }
+    else if (recordSegments) {
+        // Blobs of different assemblers (CBandAssembler::Merge()): copy
+        // the segments into our pool and free them into their own
+        SLinkedSegment *segment, *next, *copy;
+        void *memory;
+        for (segment= futileResister.firstSegment; segment; segment= next) {
+            next= segment->next;
+            if (segmentPool) {
+                memory= segmentPool->Alloc();
+                copy= memory ? new (memory) SLinkedSegment(segment->segment) : NULL;
+            }
+            else
+                copy= new (std::nothrow) SLinkedSegment(segment->segment);
+            // Like Add(), segments that don't fit are dropped
+            if (copy) {
+                *lastSegmentPtr= copy;
+                lastSegmentPtr= &copy->next;
+            }
+            if (futileResister.segmentPool)
+                futileResister.segmentPool->Free(segment);
+            else
+                delete segment;
+        }
+        futileResister.firstSegment= NULL;
+        futileResister.lastSegmentPtr= &futileResister.firstSegment;
+    }
 }
 
 // Only updates left, top, and right.  bottom is updated 
@@ -247,6 +287,10 @@ CBlobAssembler::CBlobAssembler()
     currentRow=-1;
     maxRowDelta=1;
     m_blobCount=0;
+#ifndef PIXY
+    bandTop=-1;
+    m_numLabels=0;
+#endif
 }
 
 CBlobAssembler::~CBlobAssembler() 
@@ -299,6 +343,15 @@ int CBlobAssembler::Add(const SSegment &segment) {
                     currentBlob->next = futileResister->next;
                     // Assimilate it's segments and moments
                     currentBlob->Assimilate(*(futileResister));
+#ifndef PIXY
+                    // Both labels now name currentBlob
+                    if (futileResister->label>=0) {
+                        if (currentBlob->label>=0)
+                            m_labels[futileResister->label]= currentBlob->label;
+                        else
+                            currentBlob->label= futileResister->label;
+                    }
+#endif
 
                     // Uncomment this for verbose output for testing
                     // cout << " NEW curr: bottom=" << currentBlob->bottom
@@ -307,7 +360,7 @@ int CBlobAssembler::Add(const SSegment &segment) {
                     //     << ", area " << currentBlob->moments.area << endl;
 
                     // Delete it
-                    delete futileResister;
+                    DeleteBlob(futileResister);
 
                     BlobNewRow(&currentBlob->next);
                 }
@@ -317,17 +370,25 @@ int CBlobAssembler::Add(const SSegment &segment) {
     }
     
     // Could not attach to previous blob, insert new one before currentBlob
-    CBlob *newBlob= new (std::nothrow) CBlob();
-    if (newBlob==NULL)
+    void *memory= m_blobPool.Alloc();
+    if (memory==NULL)
     {
         DBG("blobs %d\nheap full", m_blobCount);
         return -1;
     }
+    CBlob *newBlob= new (memory) CBlob(&m_segmentPool);
     m_blobCount++;
     newBlob->next= currentBlob;
     *previousBlobPtr= newBlob;
     previousBlobPtr= &newBlob->next;
     newBlob->Add(segment);
+#ifndef PIXY
+    if (segment.row==bandTop && m_numLabels<BA_MAX_LABELS) {
+        newBlob->label= m_numLabels;
+        m_labels[m_numLabels]= m_numLabels;
+        m_numLabels++;
+    }
+#endif
     return 0;
 }
 
@@ -468,11 +529,14 @@ void CBlobAssembler::Reset() {
     currentBlob= NULL;
     currentRow=-1;
     m_blobCount=0;
-    while (finishedBlobs) {
-        CBlob *tmp= finishedBlobs->next;
-        delete finishedBlobs;
-        finishedBlobs= tmp;
-    }
+#ifndef PIXY
+    m_numLabels=0;
+#endif
+    // Blobs and segments only hold pool memory, drop them all at once
+    DBG_BLOB(for (CBlob *tmp= finishedBlobs; tmp; tmp= tmp->next) CBlob::leakcheck--);
+    finishedBlobs= NULL;
+    m_blobPool.Reset();
+    m_segmentPool.Reset();
     DBG_BLOB(printf("after CBlobAssember::Reset, leakcheck=%d\n", CBlob::leakcheck));
 }
 
@@ -513,14 +577,19 @@ CBlobAssembler::BlobNewRow(CBlob **ptr)
             *ptr= blob->next; // cut out of current list
             // check to see if it meets height and area constraints
             blob->getBBox(left, top, right, bottom);
-            if (bottom-top>1) //&& blob->GetArea()>=MIN_COLOR_CODE_AREA)
+            bool keep= bottom-top>1; //&& blob->GetArea()>=MIN_COLOR_CODE_AREA
+#ifndef PIXY
+            // The band above may continue it, CBandAssembler::Merge() decides
+            keep= keep || top==bandTop;
+#endif
+            if (keep)
             {
                 // add to finished blobs
                 blob->next= finishedBlobs;
                 finishedBlobs= blob;
             }
             else
-                delete blob;
+                DeleteBlob(blob);
         } else {
             // Blob is valid
             return;
@@ -528,6 +597,14 @@ CBlobAssembler::BlobNewRow(CBlob **ptr)
     }
 }
 
+void 
+CBlobAssembler::DeleteBlob(CBlob *blob) 
+{
+    // Returns its segments to the pool too
+    blob->~CBlob();
+    m_blobPool.Free(blob);
+}
+
 void 
 CBlobAssembler::RewindCurrent() 
 {
@@ -546,4 +623,247 @@ CBlobAssembler::AdvanceCurrent()
     if (currentBlob) BlobNewRow(&currentBlob->next);
 }
 
+#ifndef PIXY
+short
+CBlobAssembler::FindLabel(short label)
+{
+    while (m_labels[label]!=label) {
+        m_labels[label]= m_labels[m_labels[label]];
+        label= m_labels[label];
+    }
+    return label;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// CBandAssembler
+
+CBandAssembler::CBandAssembler()
+{
+    m_numBands= m_frameBands= 1;
+    m_segments= NULL;
+    m_starts[0]= m_starts[1]= 0;
+    m_tops[0]= 0;
+    m_lastRow= 0;
+    m_blobs= NULL;
+    m_parents= NULL;
+    m_capacity= 0;
+}
+
+CBandAssembler::~CBandAssembler()
+{
+    delete [] m_blobs;
+    delete [] m_parents;
+}
+
+int
+CBandAssembler::SetBands(int bands)
+{
+    if (bands<1 || bands>BA_MAX_BANDS)
+        return -1;
+    m_numBands= bands;
+    return 0;
+}
+
+void
+CBandAssembler::Split(const SSegment *segments, int numSegments)
+{
+    int band, rows, i=0;
+
+    m_segments= segments;
+    if (numSegments==0) {
+        m_frameBands= 1;
+        m_tops[0]= m_lastRow= 0;
+        m_starts[0]= m_starts[1]= 0;
+        return;
+    }
 
+    // Equal row ranges, and no more bands than rows so that no band is
+    // empty just because it has no rows
+    m_lastRow= segments[numSegments-1].row;
+    rows= m_lastRow-segments[0].row+1;
+    m_frameBands= rows<m_numBands ? rows : m_numBands;
+    for (band=0; band<m_frameBands; band++) {
+        m_tops[band]= segments[0].row + rows*band/m_frameBands;
+        while (i<numSegments && segments[i].row<m_tops[band])
+            i++;
+        m_starts[band]= i;
+    }
+    m_starts[m_frameBands]= numSegments;
+}
+
+void
+CBandAssembler::AssembleBand(int band)
+{
+    CBlobAssembler &assembler= m_assemblers[band];
+    int i;
+
+    assembler.Reset();
+    if (band>=m_frameBands)
+        return;
+    assembler.bandTop= band>0 ? m_tops[band] : -1;
+    for (i=m_starts[band]; i<m_starts[band+1]; i++) {
+        if (assembler.Add(m_segments[i])<0)
+            break;
+    }
+    m_ends[band]= i;
+    assembler.EndFrame();
+}
+
+int
+CBandAssembler::Merge(CBlobAssembler &assembler)
+{
+    int band, i, j, numBlobs, first, previous, numUppers, numSeam, owner;
+    int uppers[BA_MAX_LABELS];
+    CBlob *blob, *next, *finished;
+
+    finished= assembler.finishedBlobs;
+    for (band=0, numBlobs=0, previous=0; band<m_frameBands; band++) {
+        CBlobAssembler &bandAssembler= m_assemblers[band];
+
+        // Blob of each seam segment, from the labels, before indexes
+        // replace the labels.  m_owners[] can be resolved in place since
+        // the entry of a root label is its own.
+        numSeam= 0;
+        if (band>0) {
+            for (blob= bandAssembler.finishedBlobs; blob; blob= blob->next) {
+                if (blob->label>=0)
+                    m_owners[blob->label]= blob;
+            }
+            while (m_starts[band]+numSeam<m_ends[band] && numSeam<BA_MAX_LABELS &&
+                   m_segments[m_starts[band]+numSeam].row==m_tops[band]) {
+                m_owners[numSeam]= m_owners[bandAssembler.FindLabel(numSeam)];
+                numSeam++;
+            }
+        }
+
+        // Index the blobs touching a seam, the others are passed on as
+        // they are
+        first= numBlobs;
+        for (blob= bandAssembler.finishedBlobs; blob; blob= next) {
+            next= blob->next;
+            if ((band==0 || blob->top!=m_tops[band]) &&
+                (band==m_frameBands-1 || blob->lastBottom.row!=m_tops[band+1]-1)) {
+                blob->next= finished;
+                finished= blob;
+                continue;
+            }
+            if (numBlobs==m_capacity && Reserve(2*m_capacity+BA_MAX_LABELS)<0)
+                break;
+            blob->label= numBlobs;
+            m_blobs[numBlobs]= blob;
+            m_parents[numBlobs]= -1;
+            numBlobs++;
+        }
+        bandAssembler.finishedBlobs= NULL;
+        if (blob) {
+            assembler.finishedBlobs= finished;
+            return -1;
+        }
+
+        // Blobs of the band above that reach the seam, at most one per
+        // segment on the row above
+        for (i=previous, numUppers=0; i<first && numUppers<BA_MAX_LABELS; i++) {
+            if (m_blobs[i]->lastBottom.row==m_tops[band]-1)
+                uppers[numUppers++]= i;
+        }
+        previous= first;
+
+        // Attach as CBlobAssembler::Add() would have
+        for (i=0; i<numSeam; i++) {
+            const SSegment &segment= m_segments[m_starts[band]+i];
+            owner= m_owners[i]->label;
+            for (j=0; j<numUppers; j++) {
+                blob= m_blobs[uppers[j]];
+                if (segment.startCol<=blob->lastBottom.endCol && segment.endCol>=blob->lastBottom.startCol)
+                    Join(owner, uppers[j]);
+            }
+        }
+    }
+
+    // Assimilate each blob into its root, the first blob of its component
+    for (i=0; i<numBlobs; i++) {
+        j= Find(i);
+        if (j!=i) {
+            m_blobs[j]->Assimilate(*m_blobs[i]);
+            if (m_blobs[i]->lastBottom.row>m_blobs[j]->lastBottom.row)
+                m_blobs[j]->lastBottom.row= m_blobs[i]->lastBottom.row;
+        }
+    }
+
+    // Pass the roots on.  Like CBlobAssembler::BlobNewRow(), drop short
+    // blobs that end early enough for the serial assembly to finish them.
+    for (i=numBlobs-1; i>=0; i--) {
+        if (m_parents[i]>=0)
+            continue;
+        blob= m_blobs[i];
+        if (blob->lastBottom.row-blob->top<=1 && blob->lastBottom.row+1<m_lastRow)
+            continue;
+        blob->label= -1;
+        blob->next= finished;
+        finished= blob;
+    }
+    assembler.finishedBlobs= finished;
+
+    return 0;
+}
+
+// Keeps the blobs indexed so far
+int
+CBandAssembler::Reserve(int count)
+{
+    CBlob **blobs;
+    int *parents;
+    int i;
+
+    if (count<=m_capacity)
+        return 0;
+
+    blobs= new (std::nothrow) CBlob *[count];
+    parents= new (std::nothrow) int[count];
+    if (blobs==NULL || parents==NULL) {
+        delete [] blobs;
+        delete [] parents;
+        return -1;
+    }
+    for (i=0; i<m_capacity; i++) {
+        blobs[i]= m_blobs[i];
+        parents[i]= m_parents[i];
+    }
+    delete [] m_blobs;
+    delete [] m_parents;
+    m_blobs= blobs;
+    m_parents= parents;
+    m_capacity= count;
+    return 0;
+}
+
+// Roots have negative parents
+int
+CBandAssembler::Find(int index)
+{
+    while (m_parents[index]>=0) {
+        if (m_parents[m_parents[index]]>=0)
+            m_parents[index]= m_parents[m_parents[index]];
+        index= m_parents[index];
+    }
+    return index;
+}
+
+void
+CBandAssembler::Join(int index0, int index1)
+{
+    int tmp;
+
+    index0= Find(index0);
+    index1= Find(index1);
+    if (index0==index1)
+        return;
+    if (index1<index0) {
+        tmp= index0;
+        index0= index1;
+        index1= tmp;
+    }
+    // The lower index stays the root
+    m_parents[index1]= index0;
+}
+#endif
@@ -24,6 +24,9 @@
 #define CC_SIGNATURE(s) (m_ccMode==CC_ONLY || m_clut.getType(s)==CL_MODEL_TYPE_COLORCODE)
 
 Blobs::Blobs(Qqueue *qq, uint8_t *lut) : m_clut(lut)
+#ifndef PIXY
+    , m_rowKernel(lut, &m_clut)
+#endif
 {
     int i;
 
@@ -39,11 +42,23 @@ Blobs::Blobs(Qqueue *qq, uint8_t *lut) : m_clut(lut)
     m_maxCodedDist = MAX_CODED_DIST;
 #else
     m_maxCodedDist = MAX_CODED_DIST/2;
-    m_qvals = new uint32_t[0x8000];
+    m_qvals = new uint32_t[MAX_QVALS];
+    m_runner = NULL;
+    m_bandAssemblers = NULL;
+    m_numBands = 1;
+    m_useGrid = true;
+    m_gridBuilt = false;
+    m_clumpParents = new uint16_t[3*(MAX_BLOBS+1)];
+    m_clumpHeads = m_clumpParents + MAX_BLOBS+1;
+    m_clumpNext = m_clumpHeads + MAX_BLOBS+1;
 #endif
     m_ccMode = DISABLED;
 
     m_blobs = new uint16_t[MAX_BLOBS*5];
+#ifdef INCLUDE_STATS
+    m_moments = new SMoments[MAX_BLOBS*2];
+    m_ccMoments = m_moments + MAX_BLOBS;
+#endif
     m_numBlobs = 0;
     m_blobReadIndex = 0;
     m_ccBlobReadIndex = 0;
@@ -70,8 +85,13 @@ int Blobs::setParams(uint16_t maxBlobs, uint16_t maxBlobsPerModel, uint32_t minA
 Blobs::~Blobs()
 {
     delete [] m_blobs;
+#ifdef INCLUDE_STATS
+    delete [] m_moments;
+#endif
 #ifndef PIXY
     delete [] m_qvals;
+    delete [] m_bandAssemblers;
+    delete [] m_clumpParents;
 #endif
 }
 
@@ -91,7 +111,17 @@ int Blobs::handleSegment(uint8_t signature, uint16_t row, uint16_t startCol, uin
     qval |= startCol<<3;
     qval |= length<<12;
 
-    m_qvals[m_numQvals++] = qval;
+    if (m_numQvals<MAX_QVALS)
+        m_qvals[m_numQvals++] = qval;
+
+    if (m_runner)
+    {
+        SimpleVector<SSegment> &segments = m_segments[signature-1];
+        // SimpleVector only grows by SPARE_CAPACITY
+        if (segments.size()==segments.capacity() && segments.resize(segments.capacity()*2)<0)
+            return -1;
+        return segments.push_back(s);
+    }
 #endif
 
     return m_assembler[signature-1].Add(s);
@@ -113,12 +143,26 @@ int Blobs::runlengthAnalysis()
 	register int32_t u, v, c;
 
 #ifndef PIXY
+    Qval qvals[QVAL_BATCH];
+    uint32_t qvalIndex=0, qvalCount=0;
+
     m_numQvals = 0;
 #endif
 
     while(1)
     {
+#ifdef PIXY
         while (m_qq->dequeue(&qval)==0);
+#else
+        // the producer may be another thread, a batch at a time keeps
+        // the two from trading the queue's cache lines for every Qval
+        if (qvalIndex==qvalCount)
+        {
+            qvalIndex = 0;
+            while ((qvalCount = m_qq->dequeue(qvals, QVAL_BATCH))==0);
+        }
+        qval = qvals[qvalIndex++];
+#endif
         if (qval.m_col>=0xfffe)
             break;
 		if (res<0)
@@ -134,7 +178,8 @@ int Blobs::runlengthAnalysis()
             }
             row++;
 #ifndef PIXY
-            m_qvals[m_numQvals++] = 0;
+            if (m_numQvals<MAX_QVALS)
+                m_qvals[m_numQvals++] = 0;
 #else
 			if (icount++==5) // an interleave of every 5 lines or about every 175us seems good
 			{
@@ -150,13 +195,18 @@ int Blobs::runlengthAnalysis()
         u = qval.m_u;
         v = qval.m_v;
 
-        u <<= CL_LUT_ENTRY_SCALE;
-        v <<= CL_LUT_ENTRY_SCALE;
         c = qval.m_y;
         if (c==0)
             c = 1;
+#ifdef PIXY
+        u <<= CL_LUT_ENTRY_SCALE;
+        v <<= CL_LUT_ENTRY_SCALE;
         u /= c;
         v /= c;
+#else
+        u = clDivide(u, c);
+        v = clDivide(v, c);
+#endif
 
         if (m_clut.m_runtimeSigs[sig-1].m_uMin<u && u<m_clut.m_runtimeSigs[sig-1].m_uMax &&
                 m_clut.m_runtimeSigs[sig-1].m_vMin<v && v<m_clut.m_runtimeSigs[sig-1].m_vMax && c>=(int32_t)m_clut.m_miny)
@@ -188,7 +238,8 @@ int Blobs::runlengthAnalysis()
             segmentSig = 0;
         }
     }
-	endFrame();
+	if (endFrame()<0)
+		return -1;
 
     if (qval.m_col==0xfffe) // error code, queue overrun
 		return -1;
@@ -197,12 +248,7 @@ int Blobs::runlengthAnalysis()
 
 int Blobs::blobify()
 {
-    uint32_t i, j, k;
-    bool colorCode;
-    CBlob *blob;
-    uint16_t *blobsStart;
-    uint16_t numBlobsStart, invalid, invalid2;
-    uint16_t left, top, right, bottom;
+    uint32_t i;
     //uint32_t timer, timer2=0;
 
 	if (runlengthAnalysis()<0)
@@ -214,6 +260,38 @@ int Blobs::blobify()
 		return -1;
 	}
 
+    collectBlobs();
+	return 0;
+}
+
+#ifndef PIXY
+int Blobs::blobify(const Frame8 &frame)
+{
+    uint32_t i;
+
+    if (runlengthAnalysis(frame)<0)
+    {
+        for (i=0; i<CL_NUM_SIGNATURES; i++)
+            m_assembler[i].Reset();
+        m_numBlobs = 0;
+        m_numCCBlobs = 0;
+        return -1;
+    }
+
+    collectBlobs();
+    return 0;
+}
+#endif
+
+void Blobs::collectBlobs()
+{
+    uint32_t i, j, k;
+    bool colorCode;
+    CBlob *blob;
+    uint16_t *blobsStart;
+    uint16_t numBlobsStart, invalid, invalid2;
+    uint16_t left, top, right, bottom;
+
     // copy blobs into memory
     invalid = 0;
     // mutex keeps interrupt routine from stepping on us
@@ -239,6 +317,9 @@ int Blobs::blobify()
             m_blobs[j + 2] = right;
             m_blobs[j + 3] = top;
             m_blobs[j + 4] = bottom;
+#ifdef INCLUDE_STATS
+            m_moments[m_numBlobs] = blob->moments;
+#endif
             m_numBlobs++;
             j += 5;
 
@@ -289,10 +370,181 @@ int Blobs::blobify()
         cprintf("%d: blobs 0\n", frame);
     frame++;
 #endif
-	return 0;
 }
 
 #ifndef PIXY
+// Same as runlengthAnalysis() but takes the Bayer frame itself instead of the
+// Qvals produced by the M0 core.  The row kernel does the LUT lookups and the
+// bounds checks of a whole line pair and the runs are extracted from its
+// bitmasks, so the segments are identical to the ones of the queue path.
+//
+// The queue path state machine reduces to this: a Qval that fails its bounds
+// only matters when it closes an open segment, so only the passing cells are
+// visited, and a passing cell either extends the open segment (merge) or
+// closes it and emits itself as a 2 pixel segment.  While a segment is open
+// its signature is prevSig, so merge already implies the same signature.
+// Segments are collected and handled at the end of the row.
+int Blobs::runlengthAnalysis(const Frame8 &frame)
+{
+    struct Run
+    {
+        uint16_t sig;
+        uint16_t startCol;
+        uint16_t length;
+    } runs[RK_MAX_CELLS*2+1], *run;
+    int32_t row, rows;
+    uint32_t startCol, sig, prevSig, prevStartCol, segmentStartCol, segmentEndCol;
+    uint32_t cells, cell, word, bits, fails, numRuns, i;
+    bool open, failed, merge;
+    int32_t res=0;
+    const uint8_t *line;
+
+    m_numQvals = 0;
+    rows = frame.m_height/2;
+    open = false;
+    segmentStartCol = segmentEndCol = 0;
+
+    for (row=0, line=frame.m_pixels+frame.m_width; row<rows && res>=0; row++, line+=frame.m_width*2)
+    {
+        // start of row, the segment still open belongs to the previous row
+        if (open)
+        {
+            res = handleSegment(prevSig, row-1, segmentStartCol-1, segmentEndCol - segmentStartCol+1);
+            open = false;
+        }
+        if (m_numQvals<MAX_QVALS)
+            m_qvals[m_numQvals++] = 0;
+        prevStartCol = 0xffff;
+        prevSig = 0;
+
+        cells = m_rowKernel.classify(line, frame.m_width);
+
+        // failed is set when a cell failed since the last passing cell
+        for (word=0, numRuns=0, failed=false; word<(cells+31)/32; word++)
+        {
+            fails = m_rowKernel.m_mask[word] & ~m_rowKernel.m_pass[word];
+            for (bits=m_rowKernel.m_pass[word]; bits; bits&=bits-1)
+            {
+                cell = RowKernel::lowestBit(bits);
+                failed = failed || (fails & ((1u<<cell)-1));
+                fails &= ~((2u<<cell)-1);
+                cell += word<<5;
+
+                sig = m_rowKernel.m_sig[cell];
+                startCol = (cell<<1) + 1;
+                merge = startCol-prevStartCol<=5 && prevSig==sig;
+
+                // open segment closed by a failed cell, or by a cell that doesn't merge
+                if (open && (failed || !merge))
+                {
+                    run = runs + numRuns++;
+                    run->sig = prevSig;
+                    run->startCol = segmentStartCol-1;
+                    run->length = segmentEndCol - segmentStartCol+1;
+                }
+                if (merge)
+                {
+                    if (!open || failed)
+                        segmentStartCol = prevStartCol;
+                    segmentEndCol = startCol;
+                }
+                else
+                {
+                    // lone cell
+                    run = runs + numRuns++;
+                    run->sig = sig;
+                    run->startCol = startCol-1;
+                    run->length = 2;
+                }
+                open = merge;
+                failed = false;
+                prevSig = sig;
+                prevStartCol = startCol;
+            }
+            failed = failed || fails;
+        }
+        if (open && failed)
+        {
+            run = runs + numRuns++;
+            run->sig = prevSig;
+            run->startCol = segmentStartCol-1;
+            run->length = segmentEndCol - segmentStartCol+1;
+            open = false;
+        }
+
+        for (i=0; i<numRuns && res>=0; i++)
+            res = handleSegment(runs[i].sig, row, runs[i].startCol, runs[i].length);
+    }
+    // like the queue path, a segment still open at the end of the frame is dropped
+    if (endFrame()<0)
+        res = -1;
+
+    // a segment that could not be stored leaves the blobs incomplete
+    if (res<0)
+        return -1;
+    return 0;
+}
+
+void Blobs::setTaskRunner(TaskRunner *runner)
+{
+    m_runner = runner;
+}
+
+int Blobs::setBands(uint8_t bands)
+{
+    int i;
+
+    if (bands<1 || bands>BA_MAX_BANDS)
+        return -1;
+
+    delete [] m_bandAssemblers;
+    m_bandAssemblers = NULL;
+    m_numBands = 1;
+    if (bands==1)
+        return 0;
+
+    m_bandAssemblers = new (std::nothrow) CBandAssembler[CL_NUM_SIGNATURES];
+    if (m_bandAssemblers==NULL)
+        return -1;
+    for (i=0; i<CL_NUM_SIGNATURES; i++)
+        m_bandAssemblers[i].SetBands(bands);
+    m_numBands = bands;
+
+    return 0;
+}
+
+// The assemblers share nothing, so each one can run on its own thread.  The
+// finished blobs don't depend on which thread ran them.
+void Blobs::assembleTask(void *arg, uint32_t index)
+{
+    Blobs *blobs = (Blobs *)arg;
+    uint8_t signature = blobs->m_order[index];
+    SimpleVector<SSegment> &segments = blobs->m_segments[signature];
+    int i;
+
+    for (i=0; i<segments.size(); i++)
+    {
+        if (blobs->m_assembler[signature].Add(segments[i])<0)
+            break;
+    }
+    segments.clear();
+    blobs->m_assembler[signature].EndFrame();
+    blobs->m_assembler[signature].SortFinished();
+}
+
+void Blobs::setUseGrid(bool useGrid)
+{
+    m_useGrid = useGrid;
+}
+
+// The bands of a signature share nothing until CBandAssembler::Merge()
+void Blobs::bandTask(void *arg, uint32_t index)
+{
+    Blobs *blobs = (Blobs *)arg;
+
+    blobs->m_bandAssemblers[blobs->m_order[index/blobs->m_numBands]].AssembleBand(index%blobs->m_numBands);
+}
+
 void Blobs::getRunlengths(uint32_t **qvals, uint32_t *len)
 {
     *qvals = m_qvals;
@@ -513,6 +765,14 @@ void Blobs::getBlobs(BlobA **blobs, uint32_t *len, BlobB **ccBlobs, uint32_t *cc
     *ccLen = m_numCCBlobs;
 }
 
+#ifdef INCLUDE_STATS
+void Blobs::getMoments(SMoments **moments, SMoments **ccMoments)
+{
+    *moments = m_moments;
+    *ccMoments = m_ccMoments;
+}
+#endif
+
 
 
 uint16_t Blobs::compress(uint16_t *blobs, uint16_t numBlobs)
@@ -532,6 +792,9 @@ uint16_t Blobs::compress(uint16_t *blobs, uint16_t numBlobs)
         }
         if (destination)
         {
+#ifdef INCLUDE_STATS
+            m_moments[(destination-blobs)/5] = m_moments[i];
+#endif
             destination[0] = blobs[ii+0];
             destination[1] = blobs[ii+1];
             destination[2] = blobs[ii+2];
@@ -543,12 +806,36 @@ uint16_t Blobs::compress(uint16_t *blobs, uint16_t numBlobs)
     return invalid;
 }
 
+// Blobs after blob i that combine() and combine2() compare with it, in
+// increasing order: all of them, or only those the grid finds near it
+inline uint16_t Blobs::firstNear(uint16_t i, uint16_t numBlobs)
+{
+#ifndef PIXY
+    if (m_gridBuilt)
+        return m_grid.first(i, numBlobs);
+#endif
+    return i+1;
+}
+
+inline uint16_t Blobs::nextNear(uint16_t j, uint16_t numBlobs)
+{
+#ifndef PIXY
+    if (m_gridBuilt)
+        return m_grid.next(numBlobs);
+#endif
+    return j+1;
+}
+
 uint16_t Blobs::combine(uint16_t *blobs, uint16_t numBlobs)
 {
     uint16_t i, j, ii, jj, left0, right0, top0, bottom0;
     uint16_t left, right, top, bottom;
     uint16_t invalid;
 
+#ifndef PIXY
+    // enclosed boxes overlap
+    m_gridBuilt = m_useGrid && numBlobs>=BG_MIN_BOXES && m_grid.build(blobs, numBlobs, 0)>=0;
+#endif
     // delete blobs that are fully enclosed by larger blobs
     for (i=0, ii=0, invalid=0; i<numBlobs; i++, ii+=5)
     {
@@ -559,8 +846,9 @@ uint16_t Blobs::combine(uint16_t *blobs, uint16_t numBlobs)
         top0 = blobs[ii+3];
         bottom0 = blobs[ii+4];
 
-        for (j=i+1, jj=ii+5; j<numBlobs; j++, jj+=5)
+        for (j=firstNear(i, numBlobs); j<numBlobs; j=nextNear(j, numBlobs))
         {
+            jj = j*5;
             if (blobs[jj+0]==0)
                 continue;
             left = blobs[jj+1];
@@ -580,6 +868,9 @@ uint16_t Blobs::combine(uint16_t *blobs, uint16_t numBlobs)
             }
         }
     }
+#ifndef PIXY
+    m_gridBuilt = false;
+#endif
 
     return invalid;
 }
@@ -589,7 +880,15 @@ uint16_t Blobs::combine2(uint16_t *blobs, uint16_t numBlobs)
     uint16_t i, j, ii, jj, left0, right0, top0, bottom0;
     uint16_t left, right, top, bottom;
     uint16_t invalid;
+#ifdef INCLUDE_STATS
+    SMoments *moments = m_moments + (blobs-m_blobs)/5;
+#endif
 
+#ifndef PIXY
+    // Only blob i's box changes during its turn, after its grid query.  The
+    // blobs that merge with it overlap its box grown by m_mergeDist.
+    m_gridBuilt = m_useGrid && numBlobs>=BG_MIN_BOXES && m_grid.build(blobs, numBlobs, m_mergeDist)>=0;
+#endif
     for (i=0, ii=0, invalid=0; i<numBlobs; i++, ii+=5)
     {
         if (blobs[ii+0]==0)
@@ -599,8 +898,9 @@ uint16_t Blobs::combine2(uint16_t *blobs, uint16_t numBlobs)
         top0 = blobs[ii+3];
         bottom0 = blobs[ii+4];
 
-        for (j=i+1, jj=ii+5; j<numBlobs; j++, jj+=5)
+        for (j=firstNear(i, numBlobs); j<numBlobs; j=nextNear(j, numBlobs))
         {
+            jj = j*5;
             if (blobs[jj+0]==0)
                 continue;
             left = blobs[jj+1];
@@ -666,9 +966,16 @@ uint16_t Blobs::combine2(uint16_t *blobs, uint16_t numBlobs)
                 blobs[jj+0] = 0; // invalidate
                 invalid++;
             }
+#endif
+#ifdef INCLUDE_STATS
+            if (blobs[jj+0]==0) // merged into blob i
+                moments[i].Add(moments[j]);
 #endif
         }
     }
+#ifndef PIXY
+    m_gridBuilt = false;
+#endif
 
     return invalid;
 }
@@ -911,8 +1218,23 @@ void Blobs::printBlobs()
 #endif
 }
 
+// On the host, clumps are merged in a union-find and the models are only
+// rewritten once all clumps are merged, see setClumps()
+inline uint16_t Blobs::clump(BlobA *blob)
+{
+#ifndef PIXY
+    return findClump(blob->m_model>>3)<<3;
+#else
+    return blob->m_model&~0x07;
+#endif
+}
+
 void Blobs::mergeClumps(uint16_t scount0, uint16_t scount1)
 {
+#ifndef PIXY
+    // scount0 stays the root, as it keeps its name
+    m_clumpParents[findClump(scount1>>3)] = findClump(scount0>>3);
+#else
     int i;
     BlobA *blobs = (BlobA *)m_blobs;
     for (i=0; i<m_numBlobs; i++)
@@ -920,12 +1242,46 @@ void Blobs::mergeClumps(uint16_t scount0, uint16_t scount1)
         if ((blobs[i].m_model&~0x07)==scount1)
             blobs[i].m_model = (blobs[i].m_model&0x07) | scount0;
     }
+#endif
+}
+
+#ifndef PIXY
+uint16_t Blobs::findClump(uint16_t index)
+{
+    while (m_clumpParents[index]!=index)
+    {
+        m_clumpParents[index] = m_clumpParents[m_clumpParents[index]];
+        index = m_clumpParents[index];
+    }
+    return index;
+}
+
+// Renames the blobs of merged clumps, then lists the blobs of each clump in
+// blob order, as processCC() looks for them
+void Blobs::setClumps(uint16_t count)
+{
+    int16_t i;
+    uint16_t index;
+    BlobA *blobs = (BlobA *)m_blobs;
+
+    for (index=1; index<=count; index++)
+        m_clumpHeads[index] = m_numBlobs;
+    for (i=m_numBlobs-1; i>=0; i--)
+    {
+        if (blobs[i].m_model<=CL_NUM_SIGNATURES)
+            continue;
+        index = findClump(blobs[i].m_model>>3);
+        blobs[i].m_model = (blobs[i].m_model&0x07) | (index<<3);
+        m_clumpNext[i] = m_clumpHeads[index];
+        m_clumpHeads[index] = i;
+    }
 }
+#endif
 
 void Blobs::processCC()
 {
     int16_t i, j, k;
-    uint16_t scount, scount1, count = 0;
+    uint16_t scount, scount1, other, count = 0;
     int16_t left, right, top, bottom;
     uint16_t codedModel0, codedModel;
     int32_t width, height, avgWidth, avgHeight;
@@ -956,11 +1312,18 @@ void Blobs::processCC()
 
     endBlob = (BlobA *)m_blobs + m_numBlobs;
 
+#ifndef PIXY
+    // closeby blobs overlap once grown by m_maxCodedDist, and no blob
+    // moves or is invalidated before the 3rd pass
+    m_gridBuilt = m_useGrid && m_numBlobs>=BG_MIN_BOXES && m_grid.build(m_blobs, m_numBlobs, m_maxCodedDist)>=0;
+#endif
+
     // 1st pass: mark all closeby blobs
     for (blob0=(BlobA *)m_blobs; blob0<endBlob; blob0++)
     {
-        for (blob1=(BlobA *)blob0+1; blob1<endBlob; blob1++)
+        for (other=firstNear(blob0-(BlobA *)m_blobs, m_numBlobs); other<m_numBlobs; other=nextNear(other, m_numBlobs))
         {
+            blob1 = (BlobA *)m_blobs + other;
             if (closeby(blob0, blob1))
             {
                 if (blob0->m_model<=CL_NUM_SIGNATURES && blob1->m_model<=CL_NUM_SIGNATURES)
@@ -983,6 +1346,10 @@ void Blobs::processCC()
             }
         }
     }
+#ifndef PIXY
+    for (k=1; k<=count; k++)
+        m_clumpParents[k] = k;
+#endif
 
 #if 1
     // 2nd pass: merge blob clumps
@@ -990,18 +1357,23 @@ void Blobs::processCC()
     {
         if (blob0->m_model<=CL_NUM_SIGNATURES) // skip normal blobs
             continue;
-        scount = blob0->m_model&~0x07;
-        for (blob1=(BlobA *)blob0+1; blob1<endBlob; blob1++)
+        scount = clump(blob0);
+        for (other=firstNear(blob0-(BlobA *)m_blobs, m_numBlobs); other<m_numBlobs; other=nextNear(other, m_numBlobs))
         {
+            blob1 = (BlobA *)m_blobs + other;
             if (blob1->m_model<=CL_NUM_SIGNATURES)
                 continue;
 
-            scount1 = blob1->m_model&~0x07;
+            scount1 = clump(blob1);
             if (scount!=scount1 && closeby(blob0, blob1))
                 mergeClumps(scount, scount1);
         }
     }
 #endif
+#ifndef PIXY
+    m_gridBuilt = false;
+    setClumps(count);
+#endif
 
     // 3rd and final pass, find each blob clean it up and add it to the table
     endBlobB = (BlobB *)((BlobA *)m_blobs + MAX_BLOBS)-1;
@@ -1009,11 +1381,16 @@ void Blobs::processCC()
     {
         scount = i<<3;
         // find all blobs with index i
+#ifndef PIXY
+        for (j=0, other=m_clumpHeads[i]; other<m_numBlobs && j<MAX_COLOR_CODE_MODELS*2; other=m_clumpNext[other])
+            blobs[j++] = (BlobA *)m_blobs + other;
+#else
         for (j=0, blob0=(BlobA *)m_blobs; blob0<endBlob && j<MAX_COLOR_CODE_MODELS*2; blob0++)
         {
             if ((blob0->m_model&~0x07)==scount)
                 blobs[j++] = blob0;
         }
+#endif
 
 #if 1
         // cleanup blobs, deal with cases where there are more blobs than models
@@ -1063,6 +1440,11 @@ void Blobs::processCC()
             continue;
         else if (j>5)
             j = 5;
+#endif
+#ifdef INCLUDE_STATS
+        m_ccMoments[m_numCCBlobs].Reset();
+        for (k=0; k<j; k++)
+            m_ccMoments[m_numCCBlobs].Add(m_moments[blobs[k]-(BlobA *)m_blobs]);
 #endif
         // create new blob, compare the coded models, pick the smaller one
         for (k=0, codedModel0=0; k<j; k++)
@@ -1106,13 +1488,55 @@ void Blobs::processCC()
     }
 }
 
-void Blobs::endFrame()
+// -1 if the blobs of a signature are incomplete
+int Blobs::endFrame()
 {
-    int i;
+    int i, res=0;
+#ifndef PIXY
+    uint32_t j, numTasks=0, tasks=0;
+
+    if (m_runner)
+    {
+        // busiest signature first, so the longest task starts right away
+        for (i=0; i<CL_NUM_SIGNATURES; i++)
+        {
+            if (m_segments[i].empty())
+                continue;
+            for (j=numTasks++; j>0 && m_segments[m_order[j-1]].size()<m_segments[i].size(); j--)
+                m_order[j] = m_order[j-1];
+            m_order[j] = i;
+            tasks |= 1<<i;
+        }
+        if (m_bandAssemblers)
+        {
+            // all bands of the busiest signature first
+            for (j=0; j<numTasks; j++)
+                m_bandAssemblers[m_order[j]].Split(m_segments[m_order[j]].data(), m_segments[m_order[j]].size());
+            m_runner->run(bandTask, this, numTasks*m_numBands);
+            for (j=0; j<numTasks; j++)
+            {
+                if (m_bandAssemblers[m_order[j]].Merge(m_assembler[m_order[j]])<0)
+                    res = -1;
+                m_segments[m_order[j]].clear();
+            }
+            // ended and sorted below
+            tasks = 0;
+        }
+        else
+            m_runner->run(assembleTask, this, numTasks);
+    }
+#endif
     for (i=0; i<CL_NUM_SIGNATURES; i++)
     {
+#ifndef PIXY
+        // the tasks end their own frames
+        if (tasks&(1<<i))
+            continue;
+#endif
         m_assembler[i].EndFrame();
         m_assembler[i].SortFinished();
     }
+
+    return res;
 }
 
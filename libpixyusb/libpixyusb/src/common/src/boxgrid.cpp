@@ -0,0 +1,188 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <new>
+#include <algorithm>
+#include "boxgrid.h"
+
+BoxGrid::BoxGrid()
+{
+    m_blobs = NULL;
+    m_cols = m_rows = 0;
+    m_cellStarts = NULL;
+    m_entries = NULL;
+    m_cellCapacity = m_entryCapacity = 0;
+    m_stamps = NULL;
+    m_stamp = 0;
+    m_near = NULL;
+    m_numNear = m_nearIndex = 0;
+    m_boxCapacity = 0;
+}
+
+BoxGrid::~BoxGrid()
+{
+    delete [] m_cellStarts;
+    delete [] m_entries;
+    delete [] m_stamps;
+    delete [] m_near;
+}
+
+int BoxGrid::reserve(uint32_t cells, uint32_t entries, uint16_t boxes)
+{
+    if (cells+1>m_cellCapacity)
+    {
+        delete [] m_cellStarts;
+        m_cellCapacity = 2*(cells+1);
+        m_cellStarts = new (std::nothrow) uint32_t[m_cellCapacity];
+    }
+    if (entries>m_entryCapacity)
+    {
+        delete [] m_entries;
+        m_entryCapacity = 2*entries;
+        m_entries = new (std::nothrow) uint16_t[m_entryCapacity];
+    }
+    if (boxes>m_boxCapacity)
+    {
+        delete [] m_stamps;
+        delete [] m_near;
+        m_boxCapacity = boxes;
+        m_stamps = new (std::nothrow) uint32_t[m_boxCapacity];
+        m_near = new (std::nothrow) uint16_t[m_boxCapacity];
+        if (m_stamps)
+            std::fill(m_stamps, m_stamps+m_boxCapacity, 0);
+        m_stamp = 0;
+    }
+
+    if (m_cellStarts==NULL || m_entries==NULL || m_stamps==NULL || m_near==NULL)
+    {
+        // start over next time
+        delete [] m_cellStarts;
+        delete [] m_entries;
+        delete [] m_stamps;
+        delete [] m_near;
+        m_cellStarts = NULL;
+        m_entries = NULL;
+        m_stamps = NULL;
+        m_near = NULL;
+        m_cellCapacity = m_entryCapacity = 0;
+        m_boxCapacity = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int BoxGrid::build(const uint16_t *blobs, uint16_t numBlobs, uint16_t margin)
+{
+    uint32_t i, ii, cell, entries, right, bottom;
+    uint16_t col, row, col0, col1, row0, row1;
+
+    // grid size, and the number of entries
+    for (i=0, ii=0, right=bottom=0, entries=0; i<numBlobs; i++, ii+=5)
+    {
+        if (blobs[ii+0]==0)
+            continue;
+        if (blobs[ii+2]>right)
+            right = blobs[ii+2];
+        if (blobs[ii+4]>bottom)
+            bottom = blobs[ii+4];
+        entries += (((blobs[ii+2]+margin)>>BG_CELL_SHIFT) - ((blobs[ii+1]>margin ? blobs[ii+1]-margin : 0)>>BG_CELL_SHIFT) + 1)*
+            (((blobs[ii+4]+margin)>>BG_CELL_SHIFT) - ((blobs[ii+3]>margin ? blobs[ii+3]-margin : 0)>>BG_CELL_SHIFT) + 1);
+    }
+    m_cols = ((right+margin)>>BG_CELL_SHIFT) + 1;
+    m_rows = ((bottom+margin)>>BG_CELL_SHIFT) + 1;
+    m_blobs = blobs;
+    m_numNear = m_nearIndex = 0;
+    if (reserve((uint32_t)m_cols*m_rows, entries, numBlobs)<0)
+        return -1;
+
+    // count the entries of each cell, then place them, boxes in increasing
+    // order since they are filed in that order
+    std::fill(m_cellStarts, m_cellStarts+m_cols*m_rows+1, 0);
+    for (i=0, ii=0; i<numBlobs; i++, ii+=5)
+    {
+        if (blobs[ii+0]==0)
+            continue;
+        col0 = (blobs[ii+1]>margin ? blobs[ii+1]-margin : 0)>>BG_CELL_SHIFT;
+        col1 = (blobs[ii+2]+margin)>>BG_CELL_SHIFT;
+        row0 = (blobs[ii+3]>margin ? blobs[ii+3]-margin : 0)>>BG_CELL_SHIFT;
+        row1 = (blobs[ii+4]+margin)>>BG_CELL_SHIFT;
+        for (row=row0; row<=row1; row++)
+        {
+            for (col=col0; col<=col1; col++)
+                m_cellStarts[row*m_cols + col + 1]++;
+        }
+    }
+    for (cell=0; cell<(uint32_t)m_cols*m_rows; cell++)
+        m_cellStarts[cell+1] += m_cellStarts[cell];
+    for (i=0, ii=0; i<numBlobs; i++, ii+=5)
+    {
+        if (blobs[ii+0]==0)
+            continue;
+        col0 = (blobs[ii+1]>margin ? blobs[ii+1]-margin : 0)>>BG_CELL_SHIFT;
+        col1 = (blobs[ii+2]+margin)>>BG_CELL_SHIFT;
+        row0 = (blobs[ii+3]>margin ? blobs[ii+3]-margin : 0)>>BG_CELL_SHIFT;
+        row1 = (blobs[ii+4]+margin)>>BG_CELL_SHIFT;
+        for (row=row0; row<=row1; row++)
+        {
+            for (col=col0; col<=col1; col++)
+                m_entries[m_cellStarts[row*m_cols + col]++] = i;
+        }
+    }
+    // placing moved each start to the next cell's
+    for (cell=m_cols*m_rows; cell>0; cell--)
+        m_cellStarts[cell] = m_cellStarts[cell-1];
+    m_cellStarts[0] = 0;
+
+    return 0;
+}
+
+uint16_t BoxGrid::first(uint16_t index, uint16_t end)
+{
+    const uint16_t *box = m_blobs + index*5;
+    uint32_t entry, last;
+    uint16_t col, row, col0, col1, row0, row1, box1;
+
+    // the entries are grown by the margin, so the box itself isn't
+    col0 = box[1]>>BG_CELL_SHIFT;
+    col1 = box[2]>>BG_CELL_SHIFT;
+    row0 = box[3]>>BG_CELL_SHIFT;
+    row1 = box[4]>>BG_CELL_SHIFT;
+
+    // a new stamp forgets the boxes found by the previous query
+    if (++m_stamp==0)
+    {
+        std::fill(m_stamps, m_stamps+m_boxCapacity, 0);
+        m_stamp = 1;
+    }
+
+    for (row=row0, m_numNear=0; row<=row1 && row<m_rows; row++)
+    {
+        for (col=col0; col<=col1 && col<m_cols; col++)
+        {
+            for (entry=m_cellStarts[row*m_cols + col], last=m_cellStarts[row*m_cols + col + 1]; entry<last; entry++)
+            {
+                box1 = m_entries[entry];
+                if (box1<=index || m_stamps[box1]==m_stamp)
+                    continue;
+                m_stamps[box1] = m_stamp;
+                m_near[m_numNear++] = box1;
+            }
+        }
+    }
+    std::sort(m_near, m_near+m_numNear);
+
+    m_nearIndex = 0;
+    return next(end);
+}
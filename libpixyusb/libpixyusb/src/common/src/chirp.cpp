@@ -802,8 +802,9 @@ int32_t Chirp::handleEnumerate(char *procName, ChirpProc *callback)
 	ChirpProc proc;
 	// lookup in table
 	proc = lookupTable(procName);
-	// set remote index in table
-	m_procTable[proc].chirpProc = *callback;
+	// set remote index in table, if we have the procedure
+	if (proc>=0)
+		m_procTable[proc].chirpProc = *callback;
 
 	return proc;
 }
@@ -1014,9 +1015,13 @@ int Chirp::deserializeParse(uint8_t *buf, uint32_t len, void *args[])
 
 		dataType = buf[i++];
 		size = dataType & 0x0f;
+		if (size == 0) // no such type
+			return CRP_RES_ERROR;
 		if (!(dataType&CRP_ARRAY)) // if we're a scalar
 		{
 			ALIGN(i, size);
+			if (i > len || buf[i - 1] != dataType) // the type is repeated before aligned data
+				return CRP_RES_ERROR;
 			args[a] = (void *)(buf + i);
 			i += dataType & 0x0f; // extract size of scalar, add it
 		}
@@ -1024,20 +1029,29 @@ int Chirp::deserializeParse(uint8_t *buf, uint32_t len, void *args[])
 		{
 			if (dataType == CRP_STRING || dataType == CRP_HSTRING) // string is a special case
 			{
+				if (memchr(buf + i, '\0', len - i) == NULL)
+					return CRP_RES_ERROR; // unterminated string
 				args[a] = (void *)(buf + i);
 				i += strlen((char *)(buf + i)) + 1; // +1 include null character
 			}
 			else
 			{
 				ALIGN(i, 4);
-				uint32_t len = *(uint32_t *)(buf + i);
+				if (i + 4 > len || buf[i - 1] != dataType)
+					return CRP_RES_ERROR;
+				uint32_t arrayLen = *(uint32_t *)(buf + i);
 				args[a++] = (void *)(buf + i);
 				i += 4;
 				ALIGN(i, size);
+				if (i > len || arrayLen > (len - i)/size) // corrupted length
+					return CRP_RES_ERROR;
 				args[a] = (void *)(buf + i);
-				i += len*size;
+				i += arrayLen*size;
 			}
 		}
+		// a corrupted length can point past the data
+		if (i > len)
+			return CRP_RES_ERROR;
 	}
 	args[a] = NULL; // terminate list
 	return CRP_RES_OK;
@@ -1117,7 +1131,10 @@ int Chirp::sendHeader(uint8_t type, ChirpProc proc)
 	if (ack)
 		m_offset = chunk;
 	else
+	{
+		handleEvent(CRP_EVENT_NACK_RECEIVED);
 		return CRP_RES_ERROR_CRC;
+	}
 
 	return CRP_RES_OK;
 }
@@ -1154,6 +1171,8 @@ int Chirp::sendData()
 			m_offset += chunk;
 			sequence++;
 		}
+		else
+			handleEvent(CRP_EVENT_NACK_RECEIVED);
 	}
 	return CRP_RES_OK;
 }
@@ -1165,7 +1184,10 @@ int Chirp::sendAck(bool ack) // false=nack
 	if (ack)
 		c = CRP_ACK;
 	else
+	{
 		c = CRP_NACK;
+		handleEvent(CRP_EVENT_NACK_SENT);
+	}
 
 	if (m_link->send(&c, 1, m_sendTimeout) < 0)
 		return CRP_RES_ERROR_SEND_TIMEOUT;
@@ -1247,6 +1269,7 @@ int Chirp::recvHeader(uint8_t *type, ChirpProc *proc, bool wait)
 	}
 	else
 	{
+		handleEvent(CRP_EVENT_CRC_ERROR);
 		sendAck(false); // send nack
 		return_value = CRP_RES_ERROR_CRC;
 		goto chirp_recvheader__exit;
@@ -1272,11 +1295,15 @@ int Chirp::recvFull(uint8_t *type, ChirpProc *proc, bool wait)
 			return res;
 		// check to see if we received less data than expected
 		if (res<sizeof(uint32_t))
+		{
+			handleEvent(CRP_EVENT_RESYNC);
 			continue;
+		}
 		recvd = res;
 		startCode = *(uint32_t *)m_buf;
 		if (startCode == CRP_START_CODE)
 			break;
+		handleEvent(CRP_EVENT_RESYNC);
 	}
 	*type = *(uint8_t *)(m_buf + 4);
 	*proc = *(ChirpProc *)(m_buf + 6);
@@ -1355,6 +1382,7 @@ int Chirp::recvData()
 		}
 		else
 		{
+			handleEvent(CRP_EVENT_CRC_ERROR);
 			sendAck(false);
 			naks++;
 			if (naks < m_maxNak)
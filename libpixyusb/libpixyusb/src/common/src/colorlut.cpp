@@ -23,6 +23,21 @@
 #include "calc.h"
 
 
+#ifndef PIXY
+uint64_t g_clReciprocals[CL_MAX_Y+1];
+
+static struct ReciprocalsInit
+{
+    ReciprocalsInit()
+    {
+        uint32_t c;
+
+        g_clReciprocals[0] = 0; // c==0 is never divided by
+        for (c=1; c<=CL_MAX_Y; c++)
+            g_clReciprocals[c] = (((uint64_t)1<<33) + c-1)/c;
+    }
+} g_clReciprocalsInit;
+#endif
 
 IterPixel::IterPixel(const Frame8 &frame, const RectA &region)
 {
@@ -110,14 +125,22 @@ bool IterPixel::nextHelper(UVPixel *uv, RGBPixel *rgb)
 				m_x += 2;
             	continue;
 			}
+#ifdef PIXY
         	u = ((r-g1)<<CL_LUT_ENTRY_SCALE)/c;
+#else
+            u = clDivide(r-g1, c);
+#endif
         	c = r+g2+b;
             if (c<miny)
 			{
 				m_x += 2;
             	continue;
 			}
+#ifdef PIXY
         	v = ((b-g2)<<CL_LUT_ENTRY_SCALE)/c;
+#else
+            v = clDivide(b-g2, c);
+#endif
 
         	uv->m_u = u;
         	uv->m_v = v;
@@ -149,6 +172,53 @@ uint32_t IterPixel::averageRgb(uint32_t *pixels)
 	return (r<<16) | (g<<8) | b;
 }
 
+#ifndef PIXY
+// u and v of the Bayer cell whose red pixel is at p, as nextHelper() decodes
+// them.  False if the cell is darker than CL_MIN_Y, nextHelper() skips those.
+static inline bool decodeCell(const uint8_t *p, int32_t width, int32_t *u, int32_t *v)
+{
+    int32_t r, g1, g2, b, c1, c2;
+
+    r = p[0];
+    g1 = p[-1];
+    g2 = p[-width];
+    b = p[-width - 1];
+    c1 = r+g1+b;
+    c2 = r+g2+b;
+    *u = clDivide(r-g1, c1); // g_clReciprocals[0] is 0, so c==0 is harmless here
+    *v = clDivide(b-g2, c2);
+    return c1>=CL_MIN_Y && c2>=CL_MIN_Y;
+}
+
+uint32_t IterPixel::size()
+{
+    if (m_points)
+        return m_points->size()*((CL_GROW_INC+1)/2)*((CL_GROW_INC+1)/2);
+    return ((m_region.m_width+1)/2)*((m_region.m_height+1)/2);
+}
+
+uint32_t IterPixel::decode(int32_t *us, int32_t *vs)
+{
+    int32_t x, y, width = m_frame.m_width;
+    uint32_t n = 0;
+    const uint8_t *row;
+
+    if (!reset())
+        return 0;
+    do
+    {
+        // dark cells are written, then overwritten by the next cell
+        for (y=0, row=m_pixels; y<m_region.m_height; y+=2, row+=width*2)
+        {
+            for (x=0; x<m_region.m_width; x+=2)
+                n += decodeCell(row + x, width, us + n, vs + n);
+        }
+    } while (m_points && reset(false));
+
+    return n;
+}
+#endif
+
 ColorLUT::ColorLUT(uint8_t *lut)
 {
 	int i; 
@@ -164,11 +234,24 @@ ColorLUT::ColorLUT(uint8_t *lut)
     m_ccGain = CL_DEFAULT_CCGAIN;
 	for (i=0; i<CL_NUM_SIGNATURES; i++)
 		m_sigRanges[i] = CL_DEFAULT_SIG_RANGE;
+#ifndef PIXY
+    m_table = NULL;
+    memset(m_binSigs, 0, CL_LUT_SIZE);
+    m_us = m_vs = m_uvTemp = NULL;
+    m_uvSize = m_uvCapacity = 0;
+    m_uvGrown = false;
+#endif
 }
 
 
 ColorLUT::~ColorLUT()
 {
+#ifndef PIXY
+    delete [] m_table;
+    delete [] m_us;
+    delete [] m_vs;
+    delete [] m_uvTemp;
+#endif
 }
 
 #if 0
@@ -268,15 +351,125 @@ void ColorLUT::calcRatios(IterPixel *ip, ColorSignature *sig, float ratios[])
 }
 #endif
 
+#ifndef PIXY
+// One counting sort pass of an LSD radix sort, on CL_SORT_BITS bits of the
+// values offset by 1<<CL_LUT_ENTRY_SCALE, which makes them positive.
+static void sortPass(const int32_t *src, int32_t *dest, uint32_t n, uint32_t shift)
+{
+    uint32_t i, key, sum, counts[1<<CL_SORT_BITS];
+
+    memset(counts, 0, sizeof(counts));
+    for (i=0; i<n; i++)
+        counts[((src[i] + (1<<CL_LUT_ENTRY_SCALE))>>shift)&((1<<CL_SORT_BITS)-1)]++;
+    for (key=0, sum=0; key<(1<<CL_SORT_BITS); key++)
+    {
+        sum += counts[key];
+        counts[key] = sum - counts[key];
+    }
+    for (i=0; i<n; i++)
+        dest[counts[((src[i] + (1<<CL_LUT_ENTRY_SCALE))>>shift)&((1<<CL_SORT_BITS)-1)]++] = src[i];
+}
+
+// Number of the n sorted values that are less than x, or at most x if 'equal'
+static uint32_t rank(const int32_t *sorted, uint32_t n, int32_t x, bool equal)
+{
+    uint32_t lo, hi, mid;
+
+    for (lo=0, hi=n; lo<hi; )
+    {
+        mid = (lo + hi)/2;
+        if (sorted[mid]<x || (equal && sorted[mid]==x))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Grows m_us and m_vs to hold at least size values, keeping the first m_uvSize
+bool ColorLUT::reserveUV(uint32_t size)
+{
+    int32_t *us, *vs;
+
+    if (size<=m_uvCapacity)
+        return true;
+    if (size<2*m_uvCapacity)
+        size = 2*m_uvCapacity;
+
+    us = new (std::nothrow) int32_t[size];
+    vs = new (std::nothrow) int32_t[size];
+    if (us==NULL || vs==NULL)
+    {
+        delete [] us;
+        delete [] vs;
+        return false;
+    }
+    memcpy(us, m_us, m_uvSize*sizeof(int32_t));
+    memcpy(vs, m_vs, m_uvSize*sizeof(int32_t));
+    delete [] m_us;
+    delete [] m_vs;
+    delete [] m_uvTemp;
+    m_us = us;
+    m_vs = vs;
+    m_uvTemp = new (std::nothrow) int32_t[size];
+    m_uvCapacity = m_uvTemp ? size : 0;
+    return m_uvTemp!=NULL;
+}
+
+bool ColorLUT::decode(IterPixel *ip)
+{
+    m_uvSize = 0;
+    if (!reserveUV(ip->size()))
+        return false;
+    m_uvSize = ip->decode(m_us, m_vs);
+    return true;
+}
+
+void ColorLUT::sortUV()
+{
+    // |u| and |v| are at most 1<<CL_LUT_ENTRY_SCALE, two passes cover them
+    sortPass(m_us, m_uvTemp, m_uvSize, 0);
+    sortPass(m_uvTemp, m_us, m_uvSize, CL_SORT_BITS);
+    sortPass(m_vs, m_uvTemp, m_uvSize, 0);
+    sortPass(m_uvTemp, m_vs, m_uvSize, CL_SORT_BITS);
+}
+
+// Same counts as calcRatios(IterPixel *, ...), over the sorted pixels
+void ColorLUT::calcRatios(ColorSignature *sig, float ratios[])
+{
+    uint32_t n = m_uvSize;
+
+    ratios[0] = (float)(n - rank(m_us, n, sig->m_uMin, true))/n;
+    ratios[1] = (float)rank(m_us, n, sig->m_uMax, false)/n;
+    ratios[2] = (float)(n - rank(m_vs, n, sig->m_vMin, true))/n;
+    ratios[3] = (float)rank(m_vs, n, sig->m_vMax, false)/n;
+    sig->m_uMean = (sig->m_uMin + sig->m_uMax)/2;
+    sig->m_vMean = (sig->m_vMin + sig->m_vMax)/2;
+}
+#endif
+
 void ColorLUT::iterate(IterPixel *ip, ColorSignature *sig)
 {
     int32_t scale;
     float ratios[4];
+#ifndef PIXY
+    // growRegion() leaves the pixels of its points decoded
+    bool decoded = m_uvGrown || decode(ip);
+
+    m_uvGrown = false;
+    if (decoded)
+        sortUV();
+#endif
 
     // binary search -- this rouine is guaranteed to find the right value +/- 1, which is good enough!
     // find all four values, umin, umax, vmin, vmax simultaneously
     for (scale=1<<30, sig->m_uMin=sig->m_uMax=sig->m_vMin=sig->m_vMax=0; scale!=0; scale>>=1)
     {
+#ifndef PIXY
+        if (decoded)
+            calcRatios(sig, ratios);
+        else
+#endif
         calcRatios(ip, sig, ratios);
         if (ratios[0]>m_ratio)
             sig->m_uMin += scale;
@@ -309,6 +502,9 @@ int ColorLUT::generateSignature(const Frame8 &frame, const RectA &region, uint8_
 		return -1;
    // this is cool-- this routine doesn't allocate any extra memory other than some stack variables
     IterPixel ip(frame, region);
+#ifndef PIXY
+    m_uvGrown = false;
+#endif
     iterate(&ip, m_signatures+signum-1);
 	m_signatures[signum-1].m_type = 0;
 
@@ -372,9 +568,12 @@ int ColorLUT::setSignature(uint8_t signum, const ColorSignature &sig)
 
 int ColorLUT::generateLUT()
 {
-    int32_t r, g, b, u, v, y, bin, sig;
+    int32_t r, g, b, u, v, y, ubin, vbin, bin, sig;
 
     clearLUT();
+#ifndef PIXY
+    memset(m_binSigs, 0, CL_LUT_SIZE);
+#endif
 
     // recalc bounds for each signature
     for (r=0; r<CL_NUM_SIGNATURES; r++)
@@ -400,26 +599,159 @@ int ColorLUT::generateLUT()
                     if ((m_runtimeSigs[sig].m_uMin<u) && (u<m_runtimeSigs[sig].m_uMax) &&
                             (m_runtimeSigs[sig].m_vMin<v) && (v<m_runtimeSigs[sig].m_vMax))
                     {
-                        u = r-g;
-                        u >>= 9-CL_LUT_COMPONENT_SCALE;
-                        u &= (1<<CL_LUT_COMPONENT_SCALE)-1;
-                        v = b-g;
-                        v >>= 9-CL_LUT_COMPONENT_SCALE;
-                        v &= (1<<CL_LUT_COMPONENT_SCALE)-1;
+                        // keep u and v for the signatures after this one
+                        ubin = r-g;
+                        ubin >>= 9-CL_LUT_COMPONENT_SCALE;
+                        ubin &= (1<<CL_LUT_COMPONENT_SCALE)-1;
+                        vbin = b-g;
+                        vbin >>= 9-CL_LUT_COMPONENT_SCALE;
+                        vbin &= (1<<CL_LUT_COMPONENT_SCALE)-1;
 
-                        bin = (u<<CL_LUT_COMPONENT_SCALE)+ v;
+                        bin = (ubin<<CL_LUT_COMPONENT_SCALE)+ vbin;
 
                         if (m_lut[bin]==0 || m_lut[bin]>sig+1)
                             m_lut[bin] = sig+1;
+#ifndef PIXY
+                        m_binSigs[bin] |= 1<<sig;
+#endif
                     }
                 }
             }
         }
     }
 
+#ifndef PIXY
+    if (m_table)
+        generateTable();
+#endif
+
+    return 0;
+}
+
+#ifndef PIXY
+// CL_CLASSIFIER_EXACT checks the bounds of the LUT signature of each cell
+// with (u<<CL_LUT_ENTRY_SCALE)/c and (v<<CL_LUT_ENTRY_SCALE)/c.
+// CL_CLASSIFIER_TABLE looks the signature up in m_table instead, which holds
+// the result of that check at the center of each LUT bin and brightness bin.
+// The brightness check itself stays exact.  Takes effect immediately, and
+// the table follows the signatures through generateLUT().
+int ColorLUT::setClassifier(uint8_t classifier)
+{
+    if (classifier==CL_CLASSIFIER_EXACT)
+    {
+        delete [] m_table;
+        m_table = NULL;
+        return 0;
+    }
+    if (classifier!=CL_CLASSIFIER_TABLE)
+        return -1;
+
+    if (m_table==NULL)
+        m_table = new uint8_t[CL_TABLE_SIZE];
+    generateTable();
     return 0;
 }
 
+void ColorLUT::generateTable()
+{
+    int32_t bin;
+
+    for (bin=0; bin<CL_LUT_SIZE; bin++)
+        generateTableBin(bin);
+}
+
+void ColorLUT::generateTableBin(int32_t bin)
+{
+    int32_t ybin, u, v, c, sig;
+    const RuntimeSignature *runtimeSig;
+
+    sig = m_lut[bin];
+    for (ybin=0; ybin<CL_TABLE_Y_BINS; ybin++)
+    {
+        m_table[(ybin<<(CL_LUT_COMPONENT_SCALE*2)) | bin] = 0;
+        if (sig==0)
+            continue;
+
+        // bin centers, in halves so they stay integers
+        u = bin>>CL_LUT_COMPONENT_SCALE;
+        v = bin&((1<<CL_LUT_COMPONENT_SCALE)-1);
+        u = (u<<(9-CL_LUT_COMPONENT_SCALE)) - (u>>(CL_LUT_COMPONENT_SCALE-1)<<9);
+        v = (v<<(9-CL_LUT_COMPONENT_SCALE)) - (v>>(CL_LUT_COMPONENT_SCALE-1)<<9);
+        u = 2*u + (1<<(9-CL_LUT_COMPONENT_SCALE)) - 1;
+        v = 2*v + (1<<(9-CL_LUT_COMPONENT_SCALE)) - 1;
+        c = 2*(ybin<<CL_TABLE_Y_SHIFT) + (1<<CL_TABLE_Y_SHIFT) - 1;
+
+        u = ((longlong)u<<CL_LUT_ENTRY_SCALE)/c;
+        v = ((longlong)v<<CL_LUT_ENTRY_SCALE)/c;
+
+        runtimeSig = &m_runtimeSigs[sig-1];
+        if (runtimeSig->m_uMin<u && u<runtimeSig->m_uMax && runtimeSig->m_vMin<v && v<runtimeSig->m_vMax)
+            m_table[(ybin<<(CL_LUT_COMPONENT_SCALE*2)) | bin] = sig;
+    }
+}
+
+// generateLUT() for one signature: the cube walk only tests that signature
+// and divides with clDivide(), exact for these inputs.  Each bin then gets
+// the lowest signature that matches in it, as generateLUT() does, and the
+// table is only regenerated where the bin changed or uses this signature.
+int ColorLUT::updateLUT(uint8_t signum)
+{
+    int32_t r, g, b, u, v, y, bin, sig, mask;
+    const RuntimeSignature *runtimeSig;
+
+    if (signum<1 || signum>CL_NUM_SIGNATURES)
+        return -1;
+
+    updateSignature(signum);
+    runtimeSig = &m_runtimeSigs[signum-1];
+    mask = 1<<(signum-1);
+
+    for (bin=0; bin<CL_LUT_SIZE; bin++)
+        m_binSigs[bin] &= ~mask;
+
+    if (m_signatures[signum-1].m_uMin!=0 || m_signatures[signum-1].m_uMax!=0)
+    {
+        for (r=0; r<1<<8; r+=1<<(8-CL_LUT_COMPONENT_SCALE))
+        {
+            for (g=0; g<1<<8; g+=1<<(8-CL_LUT_COMPONENT_SCALE))
+            {
+                for (b=0; b<1<<8; b+=1<<(8-CL_LUT_COMPONENT_SCALE))
+                {
+                    y = r+g+b;
+
+                    if (y<(int32_t)m_miny)
+                        continue;
+                    u = clDivide(r-g, y);
+                    if (u<=runtimeSig->m_uMin || u>=runtimeSig->m_uMax)
+                        continue;
+                    v = clDivide(b-g, y);
+                    if (v<=runtimeSig->m_vMin || v>=runtimeSig->m_vMax)
+                        continue;
+
+                    u = ((r-g)>>(9-CL_LUT_COMPONENT_SCALE))&((1<<CL_LUT_COMPONENT_SCALE)-1);
+                    v = ((b-g)>>(9-CL_LUT_COMPONENT_SCALE))&((1<<CL_LUT_COMPONENT_SCALE)-1);
+                    m_binSigs[(u<<CL_LUT_COMPONENT_SCALE)+v] |= mask;
+                }
+            }
+        }
+    }
+
+    for (bin=0; bin<CL_LUT_SIZE; bin++)
+    {
+        for (sig=1; sig<=CL_NUM_SIGNATURES && !(m_binSigs[bin]&(1<<(sig-1))); sig++);
+        if (sig>CL_NUM_SIGNATURES)
+            sig = 0;
+        if (sig==m_lut[bin] && sig!=signum)
+            continue;
+        m_lut[bin] = sig;
+        if (m_table)
+            generateTableBin(bin);
+    }
+
+    return 0;
+}
+#endif
+
 
 void ColorLUT::clearLUT(uint8_t signum)
 {
@@ -477,6 +809,9 @@ float ColorLUT::testRegion(const RectA &region, const Frame8 &frame, UVPixel *me
 {
     UVPixel subMean;
     float distance;
+#ifndef PIXY
+    uint32_t decoded;
+#endif
     RectA subRegion(0, 0, CL_GROW_INC, CL_GROW_INC);
     subRegion.m_xOffset = region.m_xOffset;
     subRegion.m_yOffset = region.m_yOffset;
@@ -485,7 +820,11 @@ float ColorLUT::testRegion(const RectA &region, const Frame8 &frame, UVPixel *me
 
     for (i=0, test=0; i<endpoint; i+=CL_GROW_INC)
     {
+#ifdef PIXY
         getMean(subRegion, frame, &subMean);
+#else
+        decoded = decodeMean(subRegion, frame, &subMean);
+#endif
         distance = sqrt((float)((mean->m_u-subMean.m_u)*(mean->m_u-subMean.m_u) + (mean->m_v-subMean.m_v)*(mean->m_v-subMean.m_v)));
         if ((uint32_t)distance<m_maxDist)
         {
@@ -494,6 +833,9 @@ float ColorLUT::testRegion(const RectA &region, const Frame8 &frame, UVPixel *me
             mean->m_v = ((longlong)mean->m_v*n + subMean.m_v)/(n+1);
             if (points->push_back(Point16(subRegion.m_xOffset, subRegion.m_yOffset))<0)
                 break;
+#ifndef PIXY
+            m_uvSize += decoded; // keep the pixels of the point
+#endif
             //DBG("add %d %d %d", subRegion.m_xOffset, subRegion.m_yOffset, points->size());
             test++;
         }
@@ -515,6 +857,9 @@ void ColorLUT::growRegion(const Frame8 &frame, const Point16 &seed, Points *poin
     RectA region, newRegion;
     UVPixel mean;
     float ratio;
+#ifndef PIXY
+    bool empty = points->size()==0;
+#endif
 
     done = 0;
 
@@ -538,7 +883,15 @@ void ColorLUT::growRegion(const Frame8 &frame, const Point16 &seed, Points *poin
     else
         points->push_back(seed);
 
+#ifdef PIXY
     getMean(region, frame, &mean);
+#else
+    // The pixels of the seed region are those of its 4 points, unless it
+    // is against the edge of the frame.  If so, iterate() decodes them.
+    m_uvSize = 0;
+    m_uvGrown = empty && points->size()==4;
+    m_uvSize = decodeMean(region, frame, &mean);
+#endif
 
     while(done!=0x0f)
     {
@@ -596,6 +949,40 @@ void ColorLUT::getMean(const RectA &region ,const Frame8 &frame, UVPixel *mean)
     mean->m_v = vsum/n;
 }
 
+#ifndef PIXY
+uint32_t ColorLUT::decodeMean(const RectA &region, const Frame8 &frame, UVPixel *mean)
+{
+    const uint8_t *row = frame.m_pixels + (region.m_yOffset | 1)*frame.m_width + (region.m_xOffset | 1);
+    int32_t x, y, *us, *vs;
+    uint32_t i, n = 0;
+    longlong usum=0, vsum=0;
+
+    if (!reserveUV(m_uvSize + ((region.m_width+1)/2)*((region.m_height+1)/2)))
+    {
+        m_uvGrown = false; // iterate() has to decode
+        getMean(region, frame, mean);
+        return 0;
+    }
+    us = m_us + m_uvSize;
+    vs = m_vs + m_uvSize;
+    for (y=0; y<region.m_height; y+=2, row+=frame.m_width*2)
+    {
+        for (x=0; x<region.m_width; x+=2)
+            n += decodeCell(row + x, frame.m_width, us + n, vs + n);
+    }
+    for (i=0; i<n; i++)
+    {
+        usum += us[i];
+        vsum += vs[i];
+    }
+
+    // the firmware's divide by zero gives 0, where the host's traps
+    mean->m_u = n ? usum/n : 0;
+    mean->m_v = n ? vsum/n : 0;
+    return n;
+}
+#endif
+
 void ColorLUT::setSigRange(uint8_t signum, float range)
 {
 	if (signum<1 || signum>CL_NUM_SIGNATURES)
@@ -17,24 +17,29 @@
 #include "../inc/qqueue.h" // need the relative path because Qt has the same file!
 #ifdef PIXY
 #include <pixyvals.h>
+#else
+#include <boost/thread.hpp>
+
+// polls before a blocked side sleeps, the other side is usually close behind
+#define QQ_SPIN       256
+
+struct QqueueWait
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    uint32_t waiters;
+};
 #endif
 
+#ifdef PIXY
 Qqueue::Qqueue()
 {
-#ifdef PIXY
     m_fields = (QqueueFields *)QQ_LOC;
-#else
-    m_fields = (QqueueFields *)(new uint8_t[QQ_SIZE]);
-#endif
     memset((void *)m_fields, 0, sizeof(QqueueFields));
 }
 
 Qqueue::~Qqueue()
 {
-#ifdef PIXY
-#else
-    delete [] m_fields;
-#endif
 }
 
 uint32_t Qqueue::dequeue(Qval *val)
@@ -51,25 +56,6 @@ uint32_t Qqueue::dequeue(Qval *val)
     return 0;
 }
 
-#ifndef PIXY
-int Qqueue::enqueue(Qval *val)
-{
-    uint16_t len = m_fields->produced - m_fields->consumed;
-    uint16_t freeLen = 	QQ_MEM_SIZE-len;
-    if (freeLen>0)
-    {
-        m_fields->data[m_fields->writeIndex++] = *val;
-        m_fields->produced++;
-        if (m_fields->writeIndex==QQ_MEM_SIZE)
-            m_fields->writeIndex = 0;
-        return 1;
-    }
-    return 0;
-
-}
-
-#endif
-
 uint32_t Qqueue::readAll(Qval *mem, uint32_t size)
 {
     uint16_t len = m_fields->produced - m_fields->consumed;
@@ -100,4 +86,200 @@ void Qqueue::flush()
         m_fields->readIndex -= QQ_MEM_SIZE;
 }
 
+#else
+
+Qqueue::Qqueue()
+{
+    m_memory = new uint8_t[QQ_SIZE+QQ_CACHE_LINE];
+    m_fields = (QqueueFields *)(((uintptr_t)m_memory + QQ_CACHE_LINE-1) & ~(uintptr_t)(QQ_CACHE_LINE-1));
+    m_wait = NULL;
+    memset((void *)m_fields, 0, sizeof(QqueueFields));
+}
+
+Qqueue::~Qqueue()
+{
+    delete m_wait;
+    delete [] m_memory;
+}
+
+int Qqueue::setBlocking(bool blocking)
+{
+    delete m_wait;
+    m_wait = NULL;
+    if (blocking)
+    {
+        try
+        {
+            m_wait = new QqueueWait;
+        }
+        catch (...)
+        {
+            return -1;
+        }
+        m_wait->waiters = 0;
+    }
+    return 0;
+}
+
+uint32_t Qqueue::queued()
+{
+    uint32_t consumed = __atomic_load_n(&m_fields->consumed, __ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&m_fields->produced, __ATOMIC_ACQUIRE) - consumed;
+}
+
+// Consumer side: Qvals that can be read, reading the producer's count
+// only if the last one seen gives fewer than 'want'
+uint32_t Qqueue::readable(uint32_t want)
+{
+    uint32_t len = m_fields->producedSeen - m_fields->consumed;
+
+    if (len<want)
+    {
+        m_fields->producedSeen = __atomic_load_n(&m_fields->produced, __ATOMIC_ACQUIRE);
+        len = m_fields->producedSeen - m_fields->consumed;
+    }
+    return len;
+}
+
+// Producer side: free Qvals, same idea
+uint32_t Qqueue::writable(uint32_t want)
+{
+    uint32_t len = QQ_MEM_SIZE - (m_fields->produced - m_fields->consumedSeen);
+
+    if (len<want)
+    {
+        m_fields->consumedSeen = __atomic_load_n(&m_fields->consumed, __ATOMIC_ACQUIRE);
+        len = QQ_MEM_SIZE - (m_fields->produced - m_fields->consumedSeen);
+    }
+    return len;
+}
+
+// Blocking only: waits until the producer has room or the consumer has a
+// Qval.  The waiter counts itself before it checks, and the other side
+// checks the count after it publishes, with a full fence on both sides,
+// so a wakeup can't fall in between.
+uint32_t Qqueue::wait(bool producer)
+{
+    uint32_t i, len;
 
+    for (i=0; i<QQ_SPIN; i++)
+    {
+        if ((len = producer ? writable(1) : readable(1)))
+            return len;
+    }
+
+    boost::unique_lock<boost::mutex> lock(m_wait->mutex);
+    __atomic_add_fetch(&m_wait->waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while ((len = producer ? writable(1) : readable(1))==0)
+        m_wait->cond.wait(lock);
+    __atomic_sub_fetch(&m_wait->waiters, 1, __ATOMIC_SEQ_CST);
+    return len;
+}
+
+void Qqueue::wake()
+{
+    if (m_wait==NULL)
+        return;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m_wait->waiters, __ATOMIC_RELAXED))
+    {
+        boost::lock_guard<boost::mutex> lock(m_wait->mutex);
+        m_wait->cond.notify_all();
+    }
+}
+
+void Qqueue::consume(uint32_t n)
+{
+    m_fields->readIndex += n;
+    if (m_fields->readIndex>=QQ_MEM_SIZE)
+        m_fields->readIndex -= QQ_MEM_SIZE;
+    __atomic_store_n(&m_fields->consumed, m_fields->consumed + n, __ATOMIC_RELEASE);
+    wake();
+}
+
+uint32_t Qqueue::dequeue(Qval *val)
+{
+    return dequeue(val, 1);
+}
+
+uint32_t Qqueue::dequeue(Qval *vals, uint32_t n)
+{
+    uint32_t len, first;
+
+    len = readable(n);
+    if (len==0 && m_wait)
+        len = wait(false);
+    if (len>n)
+        len = n;
+
+    first = QQ_MEM_SIZE - m_fields->readIndex;
+    if (first>len)
+        first = len;
+    memcpy(vals, m_fields->data + m_fields->readIndex, first*sizeof(Qval));
+    memcpy(vals + first, m_fields->data, (len - first)*sizeof(Qval));
+    consume(len);
+
+    return len;
+}
+
+int Qqueue::enqueue(Qval *val)
+{
+    return enqueue(val, 1);
+}
+
+uint32_t Qqueue::enqueue(const Qval *vals, uint32_t n)
+{
+    uint32_t done, len, first;
+
+    for (done=0; done<n; done+=len)
+    {
+        len = writable(n - done);
+        if (len==0)
+        {
+            if (m_wait==NULL)
+                break;
+            len = wait(true);
+        }
+        if (len>n - done)
+            len = n - done;
+
+        first = QQ_MEM_SIZE - m_fields->writeIndex;
+        if (first>len)
+            first = len;
+        memcpy(m_fields->data + m_fields->writeIndex, vals + done, first*sizeof(Qval));
+        memcpy(m_fields->data, vals + done + first, (len - first)*sizeof(Qval));
+        m_fields->writeIndex += len;
+        if (m_fields->writeIndex>=QQ_MEM_SIZE)
+            m_fields->writeIndex -= QQ_MEM_SIZE;
+        __atomic_store_n(&m_fields->produced, m_fields->produced + len, __ATOMIC_RELEASE);
+        wake();
+    }
+
+    return done;
+}
+
+uint32_t Qqueue::readAll(Qval *mem, uint32_t size)
+{
+    uint32_t len = readable(QQ_MEM_SIZE);
+    uint32_t i, j;
+
+    for (i=0, j=m_fields->readIndex; i<len && i<size; i++)
+    {
+        mem[i] = m_fields->data[j++];
+        if (j==QQ_MEM_SIZE)
+            j = 0;
+    }
+    // flush the rest
+    consume(len);
+
+    return i;
+}
+
+void Qqueue::flush()
+{
+    consume(readable(QQ_MEM_SIZE));
+}
+
+#endif
@@ -0,0 +1,266 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <string.h>
+#include "rowkernel.h"
+#include "colorlut.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// LUT bin of a cell, see ColorLUT::generateLUT()
+#define RK_BIN(u, v)    (((((u)>>(9-CL_LUT_COMPONENT_SCALE))&((1<<CL_LUT_COMPONENT_SCALE)-1))<<CL_LUT_COMPONENT_SCALE) | \
+                         (((v)>>(9-CL_LUT_COMPONENT_SCALE))&((1<<CL_LUT_COMPONENT_SCALE)-1)))
+
+// Blobs::runlengthAnalysis() divides (u<<CL_LUT_ENTRY_SCALE) by y with integers.
+// |u<<CL_LUT_ENTRY_SCALE| < 2^23 and y <= 765, so a correctly rounded float
+// quotient is never rounded across an integer and truncates to the same value.
+// The scalar cells use clDivide() for the same result.
+
+#ifdef __SSE2__
+// LUT entries of the 4 bins in 16-bit lanes i to i+3, packed in a 32-bit word
+#define RK_GATHER4(bins, i) (m_lut[_mm_extract_epi16(bins, i)] | m_lut[_mm_extract_epi16(bins, i+1)]<<8 | \
+                             m_lut[_mm_extract_epi16(bins, i+2)]<<16 | m_lut[_mm_extract_epi16(bins, i+3)]<<24)
+
+// table entries of the 4 indexes i to i+3, packed in a 32-bit word
+#define RK_TABLE4(entries, i) (m_clut->m_table[entries[i]] | m_clut->m_table[entries[i+1]]<<8 | \
+                               m_clut->m_table[entries[i+2]]<<16 | m_clut->m_table[entries[i+3]]<<24)
+
+namespace
+{
+// Runtime bounds of one signature, broadcast to 16-bit lanes
+struct SigBounds
+{
+    __m128i m_signum;
+    __m128i m_uMin;
+    __m128i m_uMax;
+    __m128i m_vMin;
+    __m128i m_vMax;
+};
+
+// Bounds that compare the same with 16-bit saturated quotients
+inline bool inRange16(int32_t bound)
+{
+    return bound>=-32768 && bound<=32767;
+}
+
+// ColorLUT::m_table indexes of 8 cells
+inline void tableEntries(__m128i bins, __m128i y, uint32_t *entries)
+{
+    y = _mm_srli_epi16(y, CL_TABLE_Y_SHIFT);
+    _mm_storeu_si128((__m128i *)entries, _mm_or_si128(_mm_unpacklo_epi16(bins, _mm_setzero_si128()),
+                                                      _mm_slli_epi32(_mm_unpacklo_epi16(y, _mm_setzero_si128()), CL_LUT_COMPONENT_SCALE*2)));
+    _mm_storeu_si128((__m128i *)(entries + 4), _mm_or_si128(_mm_unpackhi_epi16(bins, _mm_setzero_si128()),
+                                                            _mm_slli_epi32(_mm_unpackhi_epi16(y, _mm_setzero_si128()), CL_LUT_COMPONENT_SCALE*2)));
+}
+
+// (x<<CL_LUT_ENTRY_SCALE)/c of 8 cells, truncated and saturated to 16 bits
+inline __m128i quotient(__m128i x, __m128 c0, __m128 c1)
+{
+    __m128i q0, q1;
+
+    // unpacking under zeros gives x<<16
+    q0 = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), x), 16-CL_LUT_ENTRY_SCALE);
+    q1 = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), x), 16-CL_LUT_ENTRY_SCALE);
+    q0 = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(q0), c0));
+    q1 = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(q1), c1));
+    return _mm_packs_epi32(q0, q1);
+}
+
+// Bounds check of 8 cells against every signature in the LUT.  Each cell only
+// passes the bounds of its own signature.
+inline uint32_t passCells(const uint8_t *sig8, const int16_t *u16, const int16_t *v16, const uint16_t *y16,
+                          const SigBounds *bounds, uint32_t numBounds, __m128i miny)
+{
+    __m128i sig, y, u, v, pass, in;
+    __m128 c0, c1;
+    uint32_t i;
+
+    sig = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)sig8), _mm_setzero_si128());
+    y = _mm_loadu_si128((const __m128i *)y16);
+    y = _mm_sub_epi16(y, _mm_cmpeq_epi16(y, _mm_setzero_si128())); // c==0 becomes 1
+    c0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(y, _mm_setzero_si128()));
+    c1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(y, _mm_setzero_si128()));
+
+    u = quotient(_mm_loadu_si128((const __m128i *)u16), c0, c1);
+    v = quotient(_mm_loadu_si128((const __m128i *)v16), c0, c1);
+
+    pass = _mm_setzero_si128();
+    for (i=0; i<numBounds; i++)
+    {
+        in = _mm_and_si128(_mm_cmpgt_epi16(u, bounds[i].m_uMin), _mm_cmplt_epi16(u, bounds[i].m_uMax));
+        in = _mm_and_si128(in, _mm_cmpgt_epi16(v, bounds[i].m_vMin));
+        in = _mm_and_si128(in, _mm_cmplt_epi16(v, bounds[i].m_vMax));
+        pass = _mm_or_si128(pass, _mm_and_si128(in, _mm_cmpeq_epi16(sig, bounds[i].m_signum)));
+    }
+    pass = _mm_and_si128(pass, _mm_cmpgt_epi16(y, miny));
+
+    return _mm_movemask_epi8(_mm_packs_epi16(pass, pass))&0xff;
+}
+}
+#endif
+
+RowKernel::RowKernel(const uint8_t *lut, const ColorLUT *clut)
+{
+    m_lut = lut;
+    m_clut = clut;
+    memset(m_mask, 0, sizeof(m_mask));
+    memset(m_pass, 0, sizeof(m_pass));
+}
+
+uint16_t RowKernel::classify(const uint8_t *line, uint16_t width)
+{
+    uint16_t cell, cells;
+
+    cells = width/2;
+    if (cells>RK_MAX_CELLS)
+        cells = RK_MAX_CELLS;
+
+    memset(m_mask, 0, ((cells+31)/32)*sizeof(uint32_t));
+    memset(m_pass, 0, ((cells+31)/32)*sizeof(uint32_t));
+    cell = 0;
+
+#ifdef __SSE2__
+    // 16 cells (32 pixels of each line) at a time.  Loaded as 16-bit lanes,
+    // the red line is g|r<<8 and the blue line b|g<<8.
+    const __m128i low = _mm_set1_epi16(0x00ff);
+    const __m128i component = _mm_set1_epi16((1<<CL_LUT_COMPONENT_SCALE)-1);
+    const __m128i miny = _mm_set1_epi16((int32_t)m_clut->m_miny-1);
+    const uint8_t *prev = line - width;
+    __m128i red0, red1, blue0, blue1, r, g, b, u0, v0, u1, v1, bin0, bin1, sigs;
+    SigBounds bounds[CL_NUM_SIGNATURES];
+    uint32_t entries[16];
+    uint32_t i, hits, pass, numBounds;
+    uint16_t vectorCells = cells;
+
+    // signatures that ColorLUT::generateLUT() put in the LUT
+    for (i=0, numBounds=0; i<CL_NUM_SIGNATURES; i++)
+    {
+        const ColorSignature &sig = m_clut->m_signatures[i];
+        const RuntimeSignature &runtimeSig = m_clut->m_runtimeSigs[i];
+
+        if (sig.m_uMin==0 && sig.m_uMax==0)
+            continue;
+        // quotients are saturated to 16 bits, wider bounds need the scalar check
+        if (m_clut->m_table==NULL &&
+                (!inRange16(runtimeSig.m_uMin) || !inRange16(runtimeSig.m_uMax) || !inRange16(runtimeSig.m_vMin) || !inRange16(runtimeSig.m_vMax)))
+            vectorCells = 0;
+        bounds[numBounds].m_signum = _mm_set1_epi16(i+1);
+        bounds[numBounds].m_uMin = _mm_set1_epi16(runtimeSig.m_uMin);
+        bounds[numBounds].m_uMax = _mm_set1_epi16(runtimeSig.m_uMax);
+        bounds[numBounds].m_vMin = _mm_set1_epi16(runtimeSig.m_vMin);
+        bounds[numBounds].m_vMax = _mm_set1_epi16(runtimeSig.m_vMax);
+        numBounds++;
+    }
+
+    for (; cell+16<=vectorCells; cell+=16)
+    {
+        red0 = _mm_loadu_si128((const __m128i *)(line + cell*2));
+        red1 = _mm_loadu_si128((const __m128i *)(line + cell*2 + 16));
+        blue0 = _mm_loadu_si128((const __m128i *)(prev + cell*2));
+        blue1 = _mm_loadu_si128((const __m128i *)(prev + cell*2 + 16));
+
+        r = _mm_srli_epi16(red0, 8);
+        g = _mm_and_si128(red0, low);
+        b = _mm_and_si128(blue0, low);
+        u0 = _mm_sub_epi16(r, g);
+        v0 = _mm_sub_epi16(b, _mm_srli_epi16(blue0, 8));
+        _mm_storeu_si128((__m128i *)(m_y + cell), _mm_add_epi16(_mm_add_epi16(r, g), b));
+
+        r = _mm_srli_epi16(red1, 8);
+        g = _mm_and_si128(red1, low);
+        b = _mm_and_si128(blue1, low);
+        u1 = _mm_sub_epi16(r, g);
+        v1 = _mm_sub_epi16(b, _mm_srli_epi16(blue1, 8));
+        _mm_storeu_si128((__m128i *)(m_y + cell + 8), _mm_add_epi16(_mm_add_epi16(r, g), b));
+
+        _mm_storeu_si128((__m128i *)(m_u + cell), u0);
+        _mm_storeu_si128((__m128i *)(m_u + cell + 8), u1);
+        _mm_storeu_si128((__m128i *)(m_v + cell), v0);
+        _mm_storeu_si128((__m128i *)(m_v + cell + 8), v1);
+
+        // the LUT itself is a gather, one byte per cell
+        bin0 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(_mm_srai_epi16(u0, 9-CL_LUT_COMPONENT_SCALE), component), CL_LUT_COMPONENT_SCALE),
+                            _mm_and_si128(_mm_srai_epi16(v0, 9-CL_LUT_COMPONENT_SCALE), component));
+        bin1 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(_mm_srai_epi16(u1, 9-CL_LUT_COMPONENT_SCALE), component), CL_LUT_COMPONENT_SCALE),
+                            _mm_and_si128(_mm_srai_epi16(v1, 9-CL_LUT_COMPONENT_SCALE), component));
+        sigs = _mm_set_epi32(RK_GATHER4(bin1, 4), RK_GATHER4(bin1, 0), RK_GATHER4(bin0, 4), RK_GATHER4(bin0, 0));
+        _mm_storeu_si128((__m128i *)(m_sig + cell), sigs);
+
+        hits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(sigs, _mm_setzero_si128())) & 0xffff;
+        if (hits==0)
+            continue;
+
+        m_mask[cell>>5] |= hits<<(cell&31);
+        if (m_clut->m_table)
+        {
+            // table entries don't fit 16 bits, gather with 32-bit indexes
+            tableEntries(bin0, _mm_loadu_si128((const __m128i *)(m_y + cell)), entries);
+            tableEntries(bin1, _mm_loadu_si128((const __m128i *)(m_y + cell + 8)), entries + 8);
+            sigs = _mm_set_epi32(RK_TABLE4(entries, 12), RK_TABLE4(entries, 8), RK_TABLE4(entries, 4), RK_TABLE4(entries, 0));
+            pass = ~_mm_movemask_epi8(_mm_cmpeq_epi8(sigs, _mm_setzero_si128())) & hits &
+                    _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpgt_epi16(_mm_loadu_si128((const __m128i *)(m_y + cell)), miny),
+                                                      _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i *)(m_y + cell + 8)), miny)));
+        }
+        else
+            pass = (passCells(m_sig + cell, m_u + cell, m_v + cell, m_y + cell, bounds, numBounds, miny) |
+                    passCells(m_sig + cell + 8, m_u + cell + 8, m_v + cell + 8, m_y + cell + 8, bounds, numBounds, miny)<<8)&hits;
+        m_pass[cell>>5] |= pass<<(cell&31);
+    }
+#endif
+
+    classifyCells(line, width, cell, cells);
+
+    return cells;
+}
+
+void RowKernel::classifyCells(const uint8_t *line, uint16_t width, uint16_t cell, uint16_t end)
+{
+    int32_t r, g1, g2, b, u, v, c, bin;
+    const uint8_t *pixels;
+    const RuntimeSignature *runtimeSig;
+
+    for (pixels=line+cell*2+1; cell<end; cell++, pixels+=2)
+    {
+        r = pixels[0];
+        g1 = pixels[-1];
+        g2 = pixels[-width];
+        b = pixels[-width-1];
+
+        u = r-g1;
+        v = b-g2;
+        bin = RK_BIN(u, v);
+        m_sig[cell] = m_lut[bin];
+        if (m_sig[cell]==0)
+            continue;
+        m_mask[cell>>5] |= 1<<(cell&31);
+
+        c = r+g1+b;
+        if (m_clut->m_table)
+        {
+            if (m_clut->m_table[(c>>CL_TABLE_Y_SHIFT)<<(CL_LUT_COMPONENT_SCALE*2) | bin] && c>=(int32_t)m_clut->m_miny)
+                m_pass[cell>>5] |= 1<<(cell&31);
+            continue;
+        }
+        if (c==0)
+            c = 1;
+        u = clDivide(u, c);
+        v = clDivide(v, c);
+
+        runtimeSig = &m_clut->m_runtimeSigs[m_sig[cell]-1];
+        if (runtimeSig->m_uMin<u && u<runtimeSig->m_uMax && runtimeSig->m_vMin<v && v<runtimeSig->m_vMax && c>=(int32_t)m_clut->m_miny)
+            m_pass[cell>>5] |= 1<<(cell&31);
+    }
+}
@@ -0,0 +1,450 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Chirp serialization and parsing on the messages libpixyusb handles:
+// a small command, a CCB2 block message with 14 blocks and a 64 KB BA81
+// frame. Times Chirp::serialize(), over vserialize(), deserializeParse(),
+// getArgList(), loadArgs() and calcCrc() on each, then whole messages
+// assembled by one Chirp and received by another through a memory link.
+// Each runs for at least BENCH_MIN_NS, doubling its iterations, and
+// reports the time and heap allocations per call. The results also go
+// as JSON to the file named by the first argument, to compare Chirp
+// changes with a baseline.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <vector>
+#include "chirp.hpp"
+#include "pixytypes.h"
+
+#define BENCH_MIN_NS        200000000ULL
+#define BENCH_BLOBS_A       12
+#define BENCH_BLOBS_B       2
+#define BENCH_FRAME_WIDTH   320
+#define BENCH_FRAME_HEIGHT  200
+
+namespace
+{
+  uint64_t allocations = 0;
+  volatile uint32_t sink = 0;
+
+  uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  }
+
+  // Message contents //
+
+  BlobA                blobs_a[BENCH_BLOBS_A];
+  BlobB                blobs_b[BENCH_BLOBS_B];
+  std::vector<uint8_t> frame(BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT);
+
+  enum Message
+  {
+    MESSAGE_COMMAND,
+    MESSAGE_CCB2,
+    MESSAGE_BA81,
+    MESSAGE_COUNT
+  };
+
+  const char * message_names[MESSAGE_COUNT] = { "command", "ccb2_14", "ba81_64k" };
+
+  // A serialized message and its parsed arguments //
+  struct Payload
+  {
+    std::vector<uint8_t> buf;
+    uint32_t             len;
+    void *               args[CRP_MAX_ARGS + 1];
+  };
+
+  Payload payloads[MESSAGE_COUNT];
+
+  int serialize(uint8_t * buf, uint32_t size, Message message) {
+    switch (message) {
+    case MESSAGE_COMMAND:
+      // rcs_setPos, as pixy_rcs_set_position() sends it //
+      return Chirp::serialize(0, buf, size, UINT8(1), INT16(500), END);
+    case MESSAGE_CCB2:
+      return Chirp::serialize(0, buf, size, HTYPE(FOURCC('C', 'C', 'B', '2')), HINT8(0), HINT16(BENCH_FRAME_WIDTH), HINT16(BENCH_FRAME_HEIGHT),
+                              UINTS16(BENCH_BLOBS_A * sizeof(BlobA) / sizeof(uint16_t), blobs_a),
+                              UINTS16(BENCH_BLOBS_B * sizeof(BlobB) / sizeof(uint16_t), blobs_b), END);
+    default:
+      return Chirp::serialize(0, buf, size, HTYPE(FOURCC('B', 'A', '8', '1')), HINT8(0x21), HINT16(BENCH_FRAME_WIDTH), HINT16(BENCH_FRAME_HEIGHT),
+                              UINTS8(frame.size(), &frame[0]), END);
+    }
+  }
+
+  int load_args(void * recv_args[], ...) {
+    va_list args;
+    int     res;
+
+    va_start(args, recv_args);
+    res = Chirp::loadArgs(&args, recv_args);
+    va_end(args);
+
+    return res;
+  }
+
+  int load(Message message) {
+    void *    *args = payloads[message].args;
+    uint32_t  fourcc;
+    uint8_t   flags;
+    uint16_t  width;
+    uint16_t  height;
+    uint32_t  count_a;
+    uint16_t *data_a;
+    uint32_t  count_b;
+    uint16_t *data_b;
+    uint8_t   channel;
+    uint16_t  position;
+
+    switch (message) {
+    case MESSAGE_COMMAND:
+      return load_args(args, &channel, &position, END_IN_ARGS);
+    case MESSAGE_CCB2:
+      return load_args(args, &fourcc, &flags, &width, &height, &count_a, &data_a, &count_b, &data_b, END_IN_ARGS);
+    default:
+      return load_args(args, &fourcc, &flags, &width, &height, &count_a, &data_a, END_IN_ARGS);
+    }
+  }
+
+  // Bytes in one direction between two Chirps. Nothing is allocated //
+  // once it has grown to the largest message.                       //
+  struct Queue
+  {
+    std::vector<uint8_t> data;
+    size_t               offset;
+
+    Queue() {
+      offset = 0;
+    }
+
+    void clear() {
+      data.clear();
+      offset = 0;
+    }
+  };
+
+  class MemoryLink : public Link
+  {
+  public:
+    MemoryLink(Queue * in, Queue * out) {
+      m_flags = LINK_FLAG_ERROR_CORRECTED;
+      m_blockSize = 64;
+      in_ = in;
+      out_ = out;
+    }
+
+    virtual int send(const uint8_t *data, uint32_t len, uint16_t timeoutMs) {
+      out_->data.insert(out_->data.end(), data, data + len);
+      return len;
+    }
+
+    // Times out at once when empty, there is no other thread to wait for //
+    virtual int receive(uint8_t *data, uint32_t len, uint16_t timeoutMs) {
+      if (in_->offset == in_->data.size()) {
+        return LINK_RESULT_ERROR_RECV_TIMEOUT;
+      }
+      if (len > in_->data.size() - in_->offset) {
+        len = in_->data.size() - in_->offset;
+      }
+      memcpy(data, &in_->data[in_->offset], len);
+      in_->offset += len;
+      if (in_->offset == in_->data.size()) {
+        in_->clear();
+      }
+      return len;
+    }
+
+    virtual void setTimer() {
+    }
+
+    virtual uint32_t getTimer() {
+      return 0;
+    }
+
+  private:
+    Queue * in_;
+    Queue * out_;
+  };
+
+  // Device end //
+  class Sender : public Chirp
+  {
+  public:
+    Sender(Link * link) : Chirp(false, false, link) {
+    }
+
+    int send(Message message) {
+      switch (message) {
+      case MESSAGE_CCB2:
+        return assemble(0, HTYPE(FOURCC('C', 'C', 'B', '2')), HINT8(0), HINT16(BENCH_FRAME_WIDTH), HINT16(BENCH_FRAME_HEIGHT),
+                        UINTS16(BENCH_BLOBS_A * sizeof(BlobA) / sizeof(uint16_t), blobs_a),
+                        UINTS16(BENCH_BLOBS_B * sizeof(BlobB) / sizeof(uint16_t), blobs_b), END);
+      default:
+        return assemble(0, HTYPE(FOURCC('B', 'A', '8', '1')), HINT8(0x21), HINT16(BENCH_FRAME_WIDTH), HINT16(BENCH_FRAME_HEIGHT),
+                        UINTS8(frame.size(), &frame[0]), END);
+      }
+    }
+  };
+
+  // Host end: counts the messages it parses. Its handshake times //
+  // out, but leaves the init call for the device end to answer.   //
+  class Receiver : public Chirp
+  {
+  public:
+    Receiver(Link * link) : Chirp(true, true, link) {
+      received = 0;
+    }
+
+    uint32_t received;
+
+  protected:
+    virtual void handleXdata(const void * data[]) {
+      ++received;
+    }
+  };
+
+  Queue      to_device;
+  Queue      to_host;
+  MemoryLink device_link(&to_device, &to_host);
+  MemoryLink host_link(&to_host, &to_device);
+  Sender *   sender;
+  Receiver * receiver;
+
+  // Benchmarks, each run once per call on message 'message' //
+
+  void bench_serialize(Message message) {
+    Payload & payload = payloads[message];
+
+    sink += serialize(&payload.buf[0], payload.buf.size(), message);
+  }
+
+  void bench_parse(Message message) {
+    Payload & payload = payloads[message];
+
+    sink += Chirp::deserializeParse(&payload.buf[0], payload.len, payload.args);
+  }
+
+  void bench_arg_list(Message message) {
+    Payload & payload = payloads[message];
+    uint8_t   arg_list[CRP_MAX_ARGS + 1];
+
+    sink += Chirp::getArgList(&payload.buf[0], payload.len, arg_list);
+  }
+
+  void bench_load(Message message) {
+    sink += load(message);
+  }
+
+  void bench_crc(Message message) {
+    Payload & payload = payloads[message];
+
+    sink += Chirp::calcCrc(&payload.buf[0], payload.len);
+  }
+
+  void bench_message(Message message) {
+    sender->send(message);
+    receiver->service(false);
+  }
+
+  struct Bench
+  {
+    const char * name;
+    void (*run)(Message message);
+    Message      message;
+  };
+
+  const Bench benches[] = {
+    { "serialize",        bench_serialize, MESSAGE_COMMAND },
+    { "serialize",        bench_serialize, MESSAGE_CCB2 },
+    { "serialize",        bench_serialize, MESSAGE_BA81 },
+    { "deserializeParse", bench_parse,     MESSAGE_COMMAND },
+    { "deserializeParse", bench_parse,     MESSAGE_CCB2 },
+    { "deserializeParse", bench_parse,     MESSAGE_BA81 },
+    { "getArgList",       bench_arg_list,  MESSAGE_COMMAND },
+    { "getArgList",       bench_arg_list,  MESSAGE_CCB2 },
+    { "getArgList",       bench_arg_list,  MESSAGE_BA81 },
+    { "loadArgs",         bench_load,      MESSAGE_COMMAND },
+    { "loadArgs",         bench_load,      MESSAGE_CCB2 },
+    { "loadArgs",         bench_load,      MESSAGE_BA81 },
+    { "calcCrc",          bench_crc,       MESSAGE_COMMAND },
+    { "calcCrc",          bench_crc,       MESSAGE_CCB2 },
+    { "calcCrc",          bench_crc,       MESSAGE_BA81 },
+    { "message",          bench_message,   MESSAGE_CCB2 },
+    { "message",          bench_message,   MESSAGE_BA81 },
+  };
+
+  struct Result
+  {
+    char     name[64];
+    uint64_t iterations;
+    double   ns_per_op;
+    double   mb_per_s;
+    double   allocs_per_op;
+  };
+
+  Result run(const Bench & bench) {
+    Result   result;
+    uint64_t iterations;
+    uint64_t index;
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+    uint64_t start_allocations;
+
+    // Warm up, so that buffers have grown //
+    bench.run(bench.message);
+
+    for (iterations = 1; true; iterations *= 2) {
+      start_allocations = allocations;
+      start_ns = now_ns();
+      for (index = 0; index < iterations; ++index) {
+        bench.run(bench.message);
+      }
+      elapsed_ns = now_ns() - start_ns;
+      if (elapsed_ns >= BENCH_MIN_NS) {
+        break;
+      }
+    }
+
+    snprintf(result.name, sizeof(result.name), "%s/%s", bench.name, message_names[bench.message]);
+    result.iterations = iterations;
+    result.ns_per_op = (double)elapsed_ns / iterations;
+    result.mb_per_s = payloads[bench.message].len * 1000.0 / result.ns_per_op;
+    result.allocs_per_op = (double)(allocations - start_allocations) / iterations;
+
+    return result;
+  }
+}
+
+// Count every heap allocation of the process, the library's included //
+
+void * operator new(size_t size) {
+  void * memory;
+
+  ++allocations;
+  memory = malloc(size ? size : 1);
+  if (memory == 0) {
+    throw std::bad_alloc();
+  }
+
+  return memory;
+}
+
+void * operator new(size_t size, const std::nothrow_t &) throw() {
+  ++allocations;
+  return malloc(size ? size : 1);
+}
+
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t & nothrow) throw() {
+  return operator new(size, nothrow);
+}
+
+void operator delete(void * memory) throw() {
+  free(memory);
+}
+
+void operator delete(void * memory, const std::nothrow_t &) throw() {
+  free(memory);
+}
+
+void operator delete[](void * memory) throw() {
+  free(memory);
+}
+
+void operator delete[](void * memory, const std::nothrow_t &) throw() {
+  free(memory);
+}
+
+int main(int argc, char * argv[]) {
+  std::vector<Result> results;
+  FILE *              json;
+  size_t              index;
+  int                 message;
+  int                 res;
+
+  for (index = 0; index < BENCH_BLOBS_A; ++index) {
+    blobs_a[index] = BlobA(1 + index % 7, 10 * index, 10 * index + 20, 5 * index, 5 * index + 15);
+  }
+  for (index = 0; index < BENCH_BLOBS_B; ++index) {
+    blobs_b[index] = BlobB(012 + index, 30 * index, 30 * index + 40, 20, 60, 45);
+  }
+  for (index = 0; index < frame.size(); ++index) {
+    frame[index] = (uint8_t)(index * 7);
+  }
+
+  for (message = 0; message < MESSAGE_COUNT; ++message) {
+    Payload & payload = payloads[message];
+
+    payload.buf.resize(frame.size() + 256);
+    res = serialize(&payload.buf[0], payload.buf.size(), (Message)message);
+    if (res < 0 || Chirp::deserializeParse(&payload.buf[0], res, payload.args) < 0 || load((Message)message) < 0) {
+      fprintf(stderr, "cannot serialize and parse the %s message\n", message_names[message]);
+      return EXIT_FAILURE;
+    }
+    payload.len = res;
+  }
+
+  receiver = new Receiver(&host_link);
+  sender = new Sender(&device_link);
+  sender->service(false);
+  to_host.clear();
+  if (!sender->connected()) {
+    fprintf(stderr, "the device end did not get the init call\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-28s %12s %12s %10s %10s\n", "Benchmark", "Time (ns)", "Iterations", "MB/s", "Allocs/op");
+  for (index = 0; index < sizeof(benches) / sizeof(benches[0]); ++index) {
+    Result result = run(benches[index]);
+
+    printf("%-28s %12.1f %12llu %10.1f %10.2f\n", result.name, result.ns_per_op, (unsigned long long)result.iterations, result.mb_per_s, result.allocs_per_op);
+    results.push_back(result);
+  }
+
+  if (receiver->received == 0) {
+    fprintf(stderr, "no message went through the memory link\n");
+    return EXIT_FAILURE;
+  }
+
+  if (argc > 1) {
+    json = fopen(argv[1], "w");
+    if (json == 0) {
+      fprintf(stderr, "cannot write %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+    fprintf(json, "{\n  \"library\": \"libpixyusb\",\n  \"version\": \"%s\",\n  \"results\": [\n", __LIBPIXY_VERSION__);
+    for (index = 0; index < results.size(); ++index) {
+      fprintf(json, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"mb_per_s\": %.1f, \"allocs_per_op\": %.3f}%s\n",
+              results[index].name, (unsigned long long)results[index].iterations, results[index].ns_per_op,
+              results[index].mb_per_s, results[index].allocs_per_op, index + 1 < results.size() ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+    fclose(json);
+  }
+
+  delete receiver;
+  delete sender;
+
+  return EXIT_SUCCESS;
+}
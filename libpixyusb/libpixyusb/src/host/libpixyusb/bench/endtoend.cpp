@@ -0,0 +1,357 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// End to end benchmarks of libpixyusb without hardware, from 1 to 16
+// cameras. Simulated Pixys stream blocks at 50 frames/s while a reader
+// thread per camera polls pixy_get_blocks(), and commands go round the
+// cameras: reports blocks and frames per second per camera, the latency
+// from the receipt of a block message to the return of pixy_get_blocks()
+// and the command round trip time. Recordings of the same streams are
+// then replayed, which costs nothing on the device side: at their pace
+// for the CPU time per camera, and as fast as possible for the ceiling
+// of the host. The results also go as JSON to the file named by the
+// first argument, to compare library versions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include "pixy.h"
+#include "utils/timer.hpp"
+
+#define BENCH_SECONDS            2
+#define BENCH_FRAME_RATE         50
+#define BENCH_BLOCKS             10
+#define BENCH_COLOR_CODE_BLOCKS  2
+#define BENCH_MAX_CAMERAS        16
+#define BENCH_UID                0x42000000
+#define BENCH_COMMAND_PERIOD_US  10000
+
+namespace
+{
+  const int camera_counts[] = { 1, 2, 4, 8, 16 };
+
+  struct Percentiles
+  {
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+  };
+
+  struct Result
+  {
+    const char *     mode;
+    int              cameras;
+    double           frames_per_s;         // per camera
+    double           blocks_per_s;         // per camera
+    double           cpu_percent;          // per camera, replays only
+    double           cpu_us_per_frame;     // replays only
+    struct Percentiles      latency;       // simulated only
+    struct PixyLatencyStats command_rtt;   // simulated only
+  };
+
+  struct Reader
+  {
+    uint32_t              uid;
+    boost::atomic<bool>   stop;
+    std::vector<uint32_t> latencies_us;
+  };
+
+  uint64_t cpu_us() {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+  }
+
+  void recording_path(int camera, char * path, size_t size) {
+    const char * directory = getenv("TMPDIR");
+
+    snprintf(path, size, "%s/pixyusb_bench_%d.pxr", directory ? directory : "/tmp", camera);
+  }
+
+  // Enumerates 'cameras' simulated Pixys, USB ones left out //
+
+  int open_simulations(int cameras, uint32_t * uids) {
+    struct PixySimulation simulation;
+    uint32_t              found[BENCH_MAX_CAMERAS * 2];
+    int                   count;
+    int                   index;
+    int                   opened;
+
+    pixy_sim_clear();
+    for (index = 0; index < cameras; ++index) {
+      memset(&simulation, 0, sizeof(simulation));
+      simulation.uid = BENCH_UID + index;
+      simulation.blocks = BENCH_BLOCKS;
+      simulation.color_code_blocks = BENCH_COLOR_CODE_BLOCKS;
+      simulation.frame_rate = BENCH_FRAME_RATE;
+      simulation.jitter_us = 200;
+      simulation.seed = index + 1;
+      pixy_sim_add(&simulation);
+    }
+
+    count = pixy_enumerate(BENCH_MAX_CAMERAS * 2, found);
+    for (index = 0, opened = 0; index < count; ++index) {
+      if (found[index] >= BENCH_UID && found[index] < BENCH_UID + (uint32_t)cameras) {
+        uids[opened++] = found[index];
+      }
+    }
+
+    return opened;
+  }
+
+  // Polls a camera, timing each block message from its receipt to the //
+  // return of pixy_get_blocks()                                        //
+
+  void read_blocks(Reader * reader) {
+    struct Block blocks[BENCH_BLOCKS + BENCH_COLOR_CODE_BLOCKS];
+    uint64_t     timestamp_us;
+    uint64_t     now_us;
+    uint32_t     sequence;
+    uint32_t     sequence_after;
+
+    while (!reader->stop) {
+      if (!pixy_blocks_are_new(reader->uid)) {
+        boost::this_thread::yield();
+        continue;
+      }
+
+      pixy_get_blocks_timestamp(reader->uid, &timestamp_us, &sequence);
+      pixy_get_blocks(reader->uid, BENCH_BLOCKS + BENCH_COLOR_CODE_BLOCKS, blocks);
+      now_us = util::timestamp_us();
+
+      // A newer message may have come in between: no sample then //
+      pixy_get_blocks_timestamp(reader->uid, 0, &sequence_after);
+      if (sequence_after == sequence) {
+        reader->latencies_us.push_back((uint32_t)(now_us - timestamp_us));
+      }
+    }
+  }
+
+  struct Percentiles percentiles(std::vector<uint32_t> & samples) {
+    struct Percentiles result = { 0, 0, 0 };
+    size_t             last;
+
+    if (samples.empty()) {
+      return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    last = samples.size() - 1;
+    result.p50_us = samples[last * 50 / 100];
+    result.p99_us = samples[last * 99 / 100];
+    result.p999_us = samples[last * 999 / 1000];
+
+    return result;
+  }
+
+  bool run_simulated(int cameras, bool record, Result * result) {
+    uint32_t              uids[BENCH_MAX_CAMERAS];
+    Reader                readers[BENCH_MAX_CAMERAS];
+    boost::thread         threads[BENCH_MAX_CAMERAS];
+    std::vector<uint32_t> latencies_us;
+    struct PixyStats      stats;
+    char                  path[256];
+    uint64_t              end_us;
+    int                   index;
+
+    if (open_simulations(cameras, uids) != cameras) {
+      return false;
+    }
+
+    for (index = 0; index < cameras; ++index) {
+      if (record) {
+        recording_path(index, path, sizeof(path));
+        if (pixy_record_start(uids[index], path) < 0) {
+          return false;
+        }
+      }
+      pixy_reset_stats(uids[index]);
+
+      readers[index].uid = uids[index];
+      readers[index].stop = false;
+      readers[index].latencies_us.reserve(BENCH_SECONDS * BENCH_FRAME_RATE * 2);
+      threads[index] = boost::thread(read_blocks, &readers[index]);
+    }
+
+    // Commands go round the cameras while they stream //
+
+    end_us = util::timestamp_us() + BENCH_SECONDS * 1000000;
+    for (index = 0; util::timestamp_us() < end_us; index = (index + 1) % cameras) {
+      pixy_rcs_get_position(uids[index], 0);
+      boost::this_thread::sleep_for(boost::chrono::microseconds(BENCH_COMMAND_PERIOD_US));
+    }
+
+    for (index = 0; index < cameras; ++index) {
+      readers[index].stop = true;
+      threads[index].join();
+      latencies_us.insert(latencies_us.end(), readers[index].latencies_us.begin(), readers[index].latencies_us.end());
+      if (record) {
+        pixy_record_stop(uids[index]);
+      }
+    }
+
+    pixy_get_total_stats(&stats);
+    pixy_close();
+    pixy_sim_clear();
+
+    result->mode = "simulated";
+    result->cameras = cameras;
+    result->frames_per_s = (double)stats.frames / BENCH_SECONDS / cameras;
+    result->blocks_per_s = (double)stats.blocks / BENCH_SECONDS / cameras;
+    result->cpu_percent = 0.0;
+    result->cpu_us_per_frame = 0.0;
+    result->latency = percentiles(latencies_us);
+    result->command_rtt = stats.command_rtt;
+
+    return true;
+  }
+
+  bool run_replay(int cameras, bool max_speed, Result * result) {
+    struct PixyStats stats;
+    char             path[256];
+    uint32_t         uid;
+    uint64_t         start_cpu_us;
+    uint64_t         cpu_used_us;
+    int              index;
+
+    for (index = 0; index < cameras; ++index) {
+      recording_path(index, path, sizeof(path));
+      if (pixy_replay_open(path, PIXY_REPLAY_LOOP | (max_speed ? PIXY_REPLAY_MAX_SPEED : 0), &uid) < 0) {
+        pixy_close();
+        return false;
+      }
+      pixy_reset_stats(uid);
+    }
+
+    start_cpu_us = cpu_us();
+    boost::this_thread::sleep_for(boost::chrono::seconds(BENCH_SECONDS));
+    cpu_used_us = cpu_us() - start_cpu_us;
+
+    pixy_get_total_stats(&stats);
+    pixy_close();
+
+    memset(result, 0, sizeof(*result));
+    result->mode = (max_speed ? "replay_max_speed" : "replay");
+    result->cameras = cameras;
+    result->frames_per_s = (double)stats.frames / BENCH_SECONDS / cameras;
+    result->blocks_per_s = (double)stats.blocks / BENCH_SECONDS / cameras;
+    result->cpu_percent = cpu_used_us / 10000.0 / BENCH_SECONDS / cameras;
+    result->cpu_us_per_frame = (stats.frames ? (double)cpu_used_us / stats.frames : 0.0);
+
+    return true;
+  }
+
+  void print_result(const Result & result) {
+    printf("%-17s %2d  %8.1f %9.1f", result.mode, result.cameras, result.frames_per_s, result.blocks_per_s);
+    if (strcmp(result.mode, "simulated") == 0) {
+      printf("  %6u %6u %6u  %6u %6u %6u\n", result.latency.p50_us, result.latency.p99_us, result.latency.p999_us,
+             result.command_rtt.p50_us, result.command_rtt.p99_us, result.command_rtt.p999_us);
+    }
+    else {
+      printf("  %39s  %5.1f%% %8.1f\n", "", result.cpu_percent, result.cpu_us_per_frame);
+    }
+  }
+
+  void write_json(FILE * file, const std::vector<Result> & results) {
+    size_t index;
+
+    fprintf(file, "{\n  \"library\": \"libpixyusb\",\n  \"version\": \"%s\",\n", __LIBPIXY_VERSION__);
+    fprintf(file, "  \"seconds\": %d,\n  \"frame_rate\": %d,\n  \"blocks_per_frame\": %d,\n", BENCH_SECONDS, BENCH_FRAME_RATE, BENCH_BLOCKS + BENCH_COLOR_CODE_BLOCKS);
+    fprintf(file, "  \"cores\": %u,\n  \"results\": [\n", boost::thread::hardware_concurrency());
+
+    for (index = 0; index < results.size(); ++index) {
+      const Result & result = results[index];
+
+      fprintf(file, "    {\"mode\": \"%s\", \"cameras\": %d, \"frames_per_s\": %.1f, \"blocks_per_s\": %.1f",
+              result.mode, result.cameras, result.frames_per_s, result.blocks_per_s);
+      if (strcmp(result.mode, "simulated") == 0) {
+        fprintf(file, ", \"latency_us\": {\"p50\": %u, \"p99\": %u, \"p999\": %u}", result.latency.p50_us, result.latency.p99_us, result.latency.p999_us);
+        fprintf(file, ", \"command_rtt_us\": {\"count\": %llu, \"p50\": %u, \"p99\": %u, \"p999\": %u}", (unsigned long long)result.command_rtt.count,
+                result.command_rtt.p50_us, result.command_rtt.p99_us, result.command_rtt.p999_us);
+      }
+      else {
+        fprintf(file, ", \"cpu_percent\": %.2f, \"cpu_us_per_frame\": %.2f", result.cpu_percent, result.cpu_us_per_frame);
+      }
+      fprintf(file, "}%s\n", index + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+  }
+}
+
+int main(int argc, char * argv[]) {
+  std::vector<Result> results;
+  Result              result;
+  FILE *              json;
+  char                path[256];
+  size_t              count;
+  size_t              index;
+  int                 camera;
+
+  count = sizeof(camera_counts) / sizeof(camera_counts[0]);
+  pixy_enable_stats(1);
+
+  // Record the streams the replays play back //
+
+  if (!run_simulated(BENCH_MAX_CAMERAS, true, &result)) {
+    fprintf(stderr, "cannot record %d simulated Pixys\n", BENCH_MAX_CAMERAS);
+    return EXIT_FAILURE;
+  }
+
+  printf("%d blocks per frame at %d frames/s, %d s per run, %u cores\n", BENCH_BLOCKS + BENCH_COLOR_CODE_BLOCKS, BENCH_FRAME_RATE, BENCH_SECONDS, boost::thread::hardware_concurrency());
+  printf("                        per camera        latency (us)         command (us)        replay CPU\n");
+  printf("mode          cameras frames/s  blocks/s     p50    p99   p999     p50    p99   p999   camera us/frame\n");
+
+  for (index = 0; index < count; ++index) {
+    if (!run_simulated(camera_counts[index], false, &result)) {
+      fprintf(stderr, "cannot open %d simulated Pixys\n", camera_counts[index]);
+      return EXIT_FAILURE;
+    }
+    print_result(result);
+    results.push_back(result);
+  }
+
+  for (index = 0; index < count * 2; ++index) {
+    if (!run_replay(camera_counts[index % count], index >= count, &result)) {
+      fprintf(stderr, "cannot replay %d recordings\n", camera_counts[index % count]);
+      return EXIT_FAILURE;
+    }
+    print_result(result);
+    results.push_back(result);
+  }
+
+  for (camera = 0; camera < BENCH_MAX_CAMERAS; ++camera) {
+    recording_path(camera, path, sizeof(path));
+    remove(path);
+  }
+
+  if (argc > 1) {
+    json = fopen(argv[1], "w");
+    if (json == 0) {
+      fprintf(stderr, "cannot write %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+    write_json(json, results);
+    fclose(json);
+  }
+
+  return EXIT_SUCCESS;
+}
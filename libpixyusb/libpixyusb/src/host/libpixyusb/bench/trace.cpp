@@ -0,0 +1,133 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Cost of a trace point, disabled and enabled, and of exporting full
+// rings. An enabled trace point must stay under BENCH_BUDGET_NS; the
+// bench fails when it does not. Each case runs for at least
+// BENCH_MIN_NS, doubling its iterations. The results also go as JSON to
+// the file named by the first argument.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "trace.hpp"
+
+#define BENCH_MIN_NS        200000000ULL
+#define BENCH_BUDGET_NS     50.0
+#define BENCH_EXPORT_PATH   "pixyusb_bench_trace.json"
+
+namespace
+{
+  uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  }
+
+  struct Result
+  {
+    const char * name;
+    uint64_t     iterations;
+    double       ns_per_op;
+  };
+
+  void record_events(uint64_t iterations) {
+    uint64_t index;
+
+    for (index = 0; index < iterations; ++index) {
+      trace::record(trace::PHASE_BEGIN, trace::INTERPRET_CCB2, 0x12345678, 0);
+      trace::record(trace::PHASE_END, trace::INTERPRET_CCB2, 0x12345678, (int32_t)index);
+    }
+  }
+
+  Result run(const char * name, bool enabled) {
+    Result   result;
+    uint64_t iterations;
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+
+    trace::set_enabled(enabled);
+    record_events(1000);
+
+    for (iterations = 1000; ; iterations *= 2) {
+      start_ns = now_ns();
+      record_events(iterations);
+      elapsed_ns = now_ns() - start_ns;
+      if (elapsed_ns >= BENCH_MIN_NS) {
+        break;
+      }
+    }
+
+    trace::set_enabled(false);
+
+    result.name = name;
+    result.iterations = 2 * iterations;
+    result.ns_per_op = (double)elapsed_ns / result.iterations;
+    return result;
+  }
+}
+
+int main(int argc, char * argv[]) {
+  std::vector<Result> results;
+  Result              result;
+  FILE *              json;
+  size_t              index;
+  uint64_t            start_ns;
+  int                 count;
+
+  results.push_back(run("record/disabled", false));
+  results.push_back(run("record/enabled", true));
+
+  start_ns = now_ns();
+  count = trace::export_chrome(BENCH_EXPORT_PATH);
+  if (count < 0) {
+    fprintf(stderr, "cannot write %s\n", BENCH_EXPORT_PATH);
+    return EXIT_FAILURE;
+  }
+  result.name = "export/chrome";
+  result.iterations = count;
+  result.ns_per_op = count ? (double)(now_ns() - start_ns) / count : 0;
+  results.push_back(result);
+  remove(BENCH_EXPORT_PATH);
+
+  printf("%-28s %12s %12s\n", "Benchmark", "Time (ns)", "Iterations");
+  for (index = 0; index < results.size(); ++index) {
+    printf("%-28s %12.1f %12llu\n", results[index].name, results[index].ns_per_op, (unsigned long long)results[index].iterations);
+  }
+
+  if (argc > 1) {
+    json = fopen(argv[1], "w");
+    if (json == 0) {
+      fprintf(stderr, "cannot write %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+    fprintf(json, "{\n  \"library\": \"libpixyusb\",\n  \"version\": \"%s\",\n  \"results\": [\n", __LIBPIXY_VERSION__);
+    for (index = 0; index < results.size(); ++index) {
+      fprintf(json, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f}%s\n",
+              results[index].name, (unsigned long long)results[index].iterations, results[index].ns_per_op,
+              index + 1 < results.size() ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+    fclose(json);
+  }
+
+  if (results[1].ns_per_op > BENCH_BUDGET_NS) {
+    fprintf(stderr, "an enabled trace point takes %.1f ns, over the %.0f ns budget\n", results[1].ns_per_op, BENCH_BUDGET_NS);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
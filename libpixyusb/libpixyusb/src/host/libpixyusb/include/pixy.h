@@ -29,6 +29,9 @@ extern "C"
 
   #define PIXY_MAX_SIGNATURE          7
 
+  // Default number of blocks buffered per Pixy
+  #define PIXY_BLOCK_CAPACITY         250
+
   // Pixy x-y position values
   #define PIXY_MIN_X                  0
   #define PIXY_MAX_X                  319
@@ -44,6 +47,26 @@ extern "C"
   #define PIXY_BLOCKTYPE_NORMAL       0
   #define PIXY_BLOCKTYPE_COLOR_CODE   1
 
+  // Block query type mask bits
+  #define PIXY_QUERY_TYPE_NORMAL      (1 << PIXY_BLOCKTYPE_NORMAL)
+  #define PIXY_QUERY_TYPE_COLOR_CODE  (1 << PIXY_BLOCKTYPE_COLOR_CODE)
+
+  // Block query sort orders
+  #define PIXY_SORT_NONE              0  // Order received from Pixy
+  #define PIXY_SORT_AREA              1  // Largest area first
+  #define PIXY_SORT_CENTER_DISTANCE   2  // Closest to frame center first
+
+  // Replay flags, see pixy_replay_open()
+  #define PIXY_REPLAY_MAX_SPEED       0x01  // Don't wait for the recorded times
+  #define PIXY_REPLAY_LOOP            0x02  // Start over at the end
+
+  // Frame archive file, see pixy_capture_start()
+  #define PIXY_ARCHIVE_MAGIC          0x46584950  // "PIXF"
+  #define PIXY_ARCHIVE_RECORD_MAGIC   0x44584950  // "PIXD"
+  #define PIXY_ARCHIVE_VERSION        1
+  #define PIXY_ARCHIVE_ALIGNMENT      4096        // The header and every record take a multiple of this
+  #define PIXY_ARCHIVE_WRITING        (~(uint64_t)0)  // Sequence of a record being written
+
   struct Block
   {
     void print(char *buf)
@@ -78,9 +101,271 @@ extern "C"
     int16_t  angle;
   };
 
+  /**
+    @brief  Color signature, as stored by Pixy in its "signature1" to
+            "signature7" parameters. Same layout as 'struct VisionSignature'
+            in pixyvision.h.
+  */
+  struct Signature
+  {
+    int32_t  u_min;
+    int32_t  u_max;
+    int32_t  u_mean;
+    int32_t  v_min;
+    int32_t  v_max;
+    int32_t  v_mean;
+    uint32_t rgb;
+    uint32_t type;
+  };
+
+  struct BlockQuery
+  {
+    uint16_t type_mask;       // PIXY_QUERY_TYPE_* bits, 0 matches every type
+    uint16_t signature_mask;  // Bit n matches normal signature n, 0 matches every signature
+    uint16_t color_code;      // Color code signature to match, 0 matches every color code
+  };
+
+  struct TrackedBlock
+  {
+    uint32_t     id;      // Track identifier, stable across frames
+    struct Block block;   // Latest block, coasted when the track missed a frame
+    float        vx;      // Velocity in pixels per second
+    float        vy;
+    uint16_t     age;     // Number of frames since the track started
+    uint16_t     missed;  // Consecutive frames without a matching block
+  };
+
+  struct PixyLatencyStats
+  {
+    uint64_t count;     // Number of samples
+    uint32_t mean_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+    uint32_t max_us;
+  };
+
+  struct PixyStats
+  {
+    uint64_t frames;                           // CCB1/CCB2 block messages received
+    uint64_t blocks;                           // Blocks received
+    uint64_t blocks_dropped;                   // Blocks overwritten in a full block buffer
+    uint64_t commands;                         // Commands sent with pixy_command()
+    uint64_t command_errors;                   // Commands that returned an error
+    uint64_t chirp_resyncs;                    // Packets discarded while searching for a start code
+    uint64_t chirp_nacks_sent;
+    uint64_t chirp_nacks_received;
+    uint64_t chirp_crc_errors;
+    uint64_t usb_bytes_sent;
+    uint64_t usb_bytes_received;
+    uint64_t usb_timeouts;                     // Bulk transfers that timed out, including idle polls
+    uint64_t usb_errors;                       // Bulk transfers that failed otherwise
+    struct PixyLatencyStats frame_interval;    // Time between block messages
+    struct PixyLatencyStats command_rtt;       // Command round trip time
+    struct PixyLatencyStats blocks_lock_wait;  // Time block readers waited for the block buffer
+  };
+
+  /**
+    @brief  Pixy simulated in-process, see pixy_sim_add().
+  */
+  struct PixySimulation
+  {
+    uint32_t uid;                 // Returned by pixy_enumerate()
+    uint16_t blocks;              // Normal blocks per block message
+    uint16_t color_code_blocks;   // Color code blocks per block message
+    uint16_t frame_rate;          // Block messages per second, 0 sends none
+    uint16_t jitter_us;           // Each block message is up to this late, at random
+    float    packet_loss;         // Probability that a transfer of a block message is lost
+    float    corruption;          // Probability that a transfer of a block message has a bit flipped
+    uint32_t seed;                // Seed of the losses, corruption and jitter
+  };
+
+  /**
+    @brief  Start of a frame archive, padded to PIXY_ARCHIVE_ALIGNMENT
+            bytes. A ring of 'records' slots of 'record_size' bytes
+            follows, each a PixyArchiveRecord and its frame. Frame 'n'
+            goes to slot 'n' % 'records', overwriting the oldest one.
+  */
+  struct PixyArchiveHeader
+  {
+    uint32_t magic;           // PIXY_ARCHIVE_MAGIC
+    uint16_t version;         // PIXY_ARCHIVE_VERSION
+    uint16_t reserved;
+    uint32_t uid;             // of the captured Pixy
+    uint32_t records;         // Slots in the ring
+    uint32_t record_size;     // Bytes per slot
+    uint32_t reserved2;
+    uint64_t start_us;        // pixy_get_time_us() when the capture started
+    uint64_t next_sequence;   // Frames written so far
+  };
+
+  /**
+    @brief  Start of a frame archive slot, followed by 'length' bytes of
+            Bayer (BA81) pixels. A reader copying a frame while the capture
+            runs checks that 'sequence' is the same, and not
+            PIXY_ARCHIVE_WRITING, before and after its copy.
+  */
+  struct PixyArchiveRecord
+  {
+    uint32_t magic;           // PIXY_ARCHIVE_RECORD_MAGIC
+    uint32_t uid;
+    uint64_t sequence;        // Frame number since the capture started
+    uint64_t timestamp_us;    // Receive time, as pixy_get_time_us()
+    uint16_t width;
+    uint16_t height;
+    uint32_t length;
+  };
+
+  /**
+    @brief  Block log opened for reading, see pixy_block_log_open().
+  */
+  struct PixyBlockLog;
+
   int pixy_enumerate(int max_pixy_count, uint32_t *uids);
   void pixy_close();
 
+  /**
+    @brief      Adds a simulated Pixy that the following calls to
+                pixy_enumerate() find after the USB ones. It answers the
+                commands of this API and sends synthetic blocks, without
+                any hardware.
+    @param[in]  simulation  Simulated Pixy. Its uid must be new.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_sim_add(const struct PixySimulation * simulation);
+
+  /**
+    @brief      Removes every simulated Pixy. Those already enumerated keep
+                running until pixy_close() or pixy_enumerate().
+  */
+  void pixy_sim_clear();
+
+  /**
+    @brief      Writes every USB transfer of a Pixy, with its time, to a
+                file that pixy_replay_open() can play back without the
+                camera. Replaces the recording in progress, if any.
+    @param[in]  path  File to create.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_record_start(uint32_t uid, const char * path);
+
+  /**
+    @brief      Ends the recording started by pixy_record_start().
+    @return  0  Success
+  */
+  int pixy_record_stop(uint32_t uid);
+
+  /**
+    @brief      Opens a recording as if it were the recorded Pixy, without
+                USB. Blocks and stats come from the recording, at the
+                recorded pace or as fast as they can be interpreted.
+                Commands to a replayed Pixy fail. pixy_enumerate() and
+                pixy_close() close replays too.
+    @param[in]  path   File written by pixy_record_start().
+    @param[in]  flags  PIXY_REPLAY_* flags, or 0.
+    @param[out] uid    uid of the recorded Pixy, used as the uid of the replay.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Not a recording, or a Pixy with
+                                           the same uid is already open
+  */
+  int pixy_replay_open(const char * path, uint8_t flags, uint32_t * uid);
+
+  /**
+    @brief      Indicates when a replay has returned its whole recording.
+    @return  1  Done:     Every recorded message has been received.
+    @return  0  Not done, looping or not a replay.
+  */
+  int pixy_replay_is_done(uint32_t uid);
+
+  /**
+    @brief      Writes the blocks of every following block message of a Pixy
+                to a compact binary log, each frame delta encoded against
+                the previous one, with its receive time. Replaces the block
+                log in progress, if any.
+    @param[in]  path  File to create.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_block_log_start(uint32_t uid, const char * path);
+
+  /**
+    @brief      Ends the block log started by pixy_block_log_start(),
+                writing its time index. pixy_close() ends it too.
+    @return  0   Success
+    @return  -1  Invalid uid, or a write failed and the log may be cut short
+  */
+  int pixy_block_log_stop(uint32_t uid);
+
+  /**
+    @brief      Opens a block log for reading. Logs that were not stopped
+                can be read up to their last second or so.
+    @param[in]  path  File written by pixy_block_log_start().
+    @return     Block log to pass to pixy_block_log_read(), or NULL when
+                'path' is not a block log.
+  */
+  struct PixyBlockLog * pixy_block_log_open(const char * path);
+
+  void pixy_block_log_close(struct PixyBlockLog * block_log);
+
+  /**
+    @brief      Gets the Pixy and the time span of a block log.
+    @param[out] uid       uid of the logged Pixy. May be NULL.
+    @param[out] first_us  Receive time of the first frame. May be NULL.
+    @param[out] last_us   Receive time of the last frame. May be NULL.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_block_log_info(const struct PixyBlockLog * block_log, uint32_t * uid, uint64_t * first_us, uint64_t * last_us);
+
+  /**
+    @brief      Makes the next pixy_block_log_read() return the first frame
+                received at or after 'timestamp_us', without decoding the
+                log from its start.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_block_log_seek(struct PixyBlockLog * block_log, uint64_t timestamp_us);
+
+  /**
+    @brief      Reads the next frame of a block log.
+    @param[out] timestamp_us  Receive time of the frame. May be NULL.
+    @param[in]  max_blocks    Maximum number of blocks to copy.
+    @param[out] blocks        Address of an array large enough to hold 'max_blocks' blocks.
+    @return  Non-negative                  Success: Number of blocks copied
+    @return  -1                            End of the log
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_block_log_read(struct PixyBlockLog * block_log, uint64_t * timestamp_us, uint16_t max_blocks, struct Block * blocks);
+
+  /**
+    @brief      Captures raw frames of a Pixy to a memory-mapped ring file,
+                preallocated for 'frames' frames. Frames are copied from the
+                USB receive buffer straight to the file, and the library
+                requests the next frame as soon as one arrives, so the
+                capture runs at the rate of the camera. Once the ring is
+                full, each frame overwrites the oldest. While capturing,
+                pixy_cam_update_frame() returns -202 and pixy_cam_get_frame()
+                still returns the latest frame. Replaces the capture in
+                progress, if any.
+    @param[in]  path    File to create. See PixyArchiveHeader for its layout.
+    @param[in]  frames  Number of frames the ring holds. Must be non-zero.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified, or
+                                           the file could not be created
+  */
+  int pixy_capture_start(uint32_t uid, const char * path, uint32_t frames);
+
+  /**
+    @brief      Ends the capture started by pixy_capture_start(), flushing
+                the file. pixy_close() ends it too.
+    @return  0   Success
+    @return  -1  Invalid uid, or the file could not be flushed
+  */
+  int pixy_capture_stop(uint32_t uid);
+
   /**
     @brief      Indicates when new block data from Pixy is received.
 
@@ -107,6 +392,167 @@ extern "C"
   */
   int pixy_get_blocks(uint32_t uid, uint16_t max_blocks, struct Block * blocks);
 
+  /**
+    @brief      Copies up to 'max_blocks' number of blocks into separate arrays,
+                one per block field (structure of arrays). Any array pointer may
+                be NULL to skip that field.
+    @param[in]  max_blocks Maximum number of blocks to copy. Each non-NULL array
+                           must be large enough to hold 'max_blocks' values.
+    @param[out] signature  Block signatures.
+    @param[out] x          Block center x positions.
+    @param[out] y          Block center y positions.
+    @param[out] width      Block widths.
+    @param[out] height     Block heights.
+    @return  Non-negative                  Success: Number of blocks copied
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_get_blocks_soa(uint32_t uid, uint16_t max_blocks, uint16_t * signature, uint16_t * x, uint16_t * y, uint16_t * width, uint16_t * height);
+
+  /**
+    @brief      Sets the number of blocks buffered for a Pixy. The default is
+                PIXY_BLOCK_CAPACITY. When the buffer is full the oldest block
+                is overwritten by the newest one.
+    @param[in]  capacity  Number of blocks to buffer. Must be non-zero.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_set_block_capacity(uint32_t uid, uint16_t capacity);
+
+  /**
+    @brief      Selects blocks from the latest block data without copying the
+                whole block buffer. Blocks are filtered by 'query' and the best
+                'k' blocks according to 'sort' are copied to 'blocks', best
+                first. Like pixy_get_blocks(), the block data is marked as read.
+    @param[in]  query   Filter to apply. NULL matches every block.
+    @param[in]  sort    PIXY_SORT_NONE, PIXY_SORT_AREA or PIXY_SORT_CENTER_DISTANCE.
+                        PIXY_SORT_NONE returns the first 'k' matches in the order
+                        received.
+    @param[in]  k       Maximum number of blocks to copy.
+    @param[out] blocks  Address of an array large enough to hold 'k' Blocks.
+    @return  Non-negative                  Success: Number of blocks copied
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_query_blocks(uint32_t uid, const struct BlockQuery * query, uint8_t sort, uint16_t k, struct Block * blocks);
+
+  /**
+    @brief      Gets the time the latest block data was received.
+    @param[out] timestamp_us  Monotonic receive time in microseconds. May be NULL.
+    @param[out] sequence      Number of block messages received so far. May be NULL.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_get_blocks_timestamp(uint32_t uid, uint64_t * timestamp_us, uint32_t * sequence);
+
+  /**
+    @brief      Enables or disables block tracking. While enabled, blocks
+                are associated across frames and given persistent track
+                identifiers. Disabling tracking drops every track.
+    @param[in]  enable  Non-zero to enable tracking.
+    @return  0  Success
+  */
+  int pixy_enable_tracking(uint32_t uid, int enable);
+
+  /**
+    @brief      Copies up to 'max_tracks' tracked blocks to 'tracks', oldest
+                track first. Tracks survive a few frames without a matching
+                block before they are dropped.
+    @param[in]  max_tracks  Maximum number of tracks to copy.
+    @param[out] tracks      Address of an array large enough to hold 'max_tracks'
+                            TrackedBlocks.
+    @return  Non-negative                  Success: Number of tracks copied
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_get_tracked_blocks(uint32_t uid, uint16_t max_tracks, struct TrackedBlock * tracks);
+
+  /**
+    @brief      Copies up to 'max_tracks' tracked blocks to 'tracks' with
+                their positions extrapolated to 'timestamp_us'. Each track
+                keeps an alpha-beta filtered position and velocity, so this
+                compensates for the latency between the camera and the caller.
+                Tracking must be enabled with pixy_enable_tracking().
+    @param[in]  timestamp_us  Monotonic time to predict for, on the clock of
+                              pixy_get_time_us().
+    @param[in]  max_tracks    Maximum number of tracks to copy.
+    @param[out] tracks        Address of an array large enough to hold
+                              'max_tracks' TrackedBlocks.
+    @return  Non-negative                  Success: Number of tracks copied
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_predict_blocks(uint32_t uid, uint64_t timestamp_us, uint16_t max_tracks, struct TrackedBlock * tracks);
+
+  /**
+    @brief   Returns the monotonic time in microseconds used for block
+             receive timestamps.
+  */
+  uint64_t pixy_get_time_us();
+
+  /**
+    @brief      Enables or disables statistics collection for every Pixy.
+                Collection is disabled by default and costs almost nothing
+                while disabled.
+    @param[in]  enable  Non-zero to enable collection.
+  */
+  void pixy_enable_stats(int enable);
+
+  /**
+    @brief      Gets the statistics collected for a Pixy.
+    @param[out] stats  Statistics.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_get_stats(uint32_t uid, struct PixyStats * stats);
+
+  /**
+    @brief      Gets the statistics of every enumerated Pixy combined.
+    @param[out] stats  Statistics.
+    @return  0                             Success
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_get_total_stats(struct PixyStats * stats);
+
+  /**
+    @brief      Clears the statistics collected for a Pixy.
+    @return  0  Success
+  */
+  int pixy_reset_stats(uint32_t uid);
+
+  /**
+    @brief      Writes a text description of 'stats' to 'buffer', one
+                "name value" line per counter.
+    @param[in]  stats   Statistics from pixy_get_stats() or pixy_get_total_stats().
+    @param[out] buffer  Text buffer. May be NULL when 'size' is 0.
+    @param[in]  size    Size of 'buffer' in bytes.
+    @return  Non-negative  Length of the full text, excluding the terminating null.
+                           The text was truncated if this is 'size' or more.
+    @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+  */
+  int pixy_format_stats(const struct PixyStats * stats, char * buffer, uint32_t size);
+
+  /**
+    @brief      Enables or disables tracing of USB transfers, Chirp lock
+                handoffs, commands and block messages. Tracing is disabled
+                by default, and only available when libpixyusb is built
+                with PIXY_TRACE defined (the LIBPIXYUSB_TRACE option).
+    @param[in]  enable  Non-zero to enable tracing.
+  */
+  void pixy_trace_enable(int enable);
+
+  /**
+    @brief      Writes the latest trace records of every thread to a file in
+                the Chrome trace event format, which Perfetto and
+                chrome://tracing open. Each Pixy is a process named after
+                its uid.
+    @param[in]  path  File to write.
+    @return  Non-negative                  Number of records written
+    @return  PIXY_ERROR_INVALID_PARAMETER  The file could not be written
+  */
+  int pixy_trace_export(const char * path);
+
+  /**
+    @brief      Discards every trace record. Call with tracing disabled.
+  */
+  void pixy_trace_clear();
+
   int pixy_cam_update_frame(uint32_t uid);
   int pixy_cam_get_frame(uint32_t uid, uint8_t *frame);
   int pixy_cam_reset_frame_wait(uint32_t uid);
@@ -234,6 +680,18 @@ extern "C"
   */
   int pixy_cam_get_brightness(uint32_t uid);
 
+  /**
+    @brief     Set a color signature, as PixyMon does when a signature is
+               taught. Signatures can be trained on the host from frames
+               returned by pixy_cam_get_frame(), see pixyvision_train_region().
+    @param[in] signum     Signature number. Range: [1, PIXY_MAX_SIGNATURE]
+    @param[in] signature  Signature to send.
+    @return      0                             Success
+    @return      PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+    @return      Negative                      Error
+  */
+  int pixy_cam_set_signature(uint32_t uid, uint8_t signum, const struct Signature * signature);
+
   /**
     @brief     Get pixy servo axis position.
     @param     channel  Channel value. Range: [0, 1]
@@ -0,0 +1,459 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "blocklog.hpp"
+#include "utils/timer.hpp"
+#include "debuglog.h"
+
+namespace
+{
+	const Block zero_block = Block();
+
+	void put_varint(std::vector<uint8_t> & out, uint64_t value) {
+		while (value >= 0x80) {
+			out.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((uint8_t)value);
+	}
+
+	bool get_varint(const uint8_t * data, size_t end, size_t & next, uint64_t & value) {
+		uint32_t shift;
+
+		value = 0;
+		for (shift = 0; next < end && shift < 64; shift += 7) {
+			value |= (uint64_t)(data[next] & 0x7f) << shift;
+			if ((data[next++] & 0x80) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Differences wrap around 16 bits, so every one takes 3 bytes at most //
+
+	void put_field(std::vector<uint8_t> & out, uint16_t value, uint16_t base) {
+		uint16_t difference = value - base;
+		put_varint(out, (uint16_t)((difference << 1) ^ -(difference >> 15)));
+	}
+
+	bool get_field(const uint8_t * data, size_t end, size_t & next, uint16_t & value) {
+		uint64_t zigzag;
+
+		if (!get_varint(data, end, next, zigzag) || zigzag > 0xffff) {
+			return false;
+		}
+		value += (uint16_t)((zigzag >> 1) ^ -(zigzag & 1));
+		return true;
+	}
+}
+
+BlockLogWriter::BlockLogWriter() {
+	file_ = NULL;
+	failed_ = false;
+	offset_ = 0;
+	memset(&chunk_, 0, sizeof(chunk_));
+	previous_us_ = 0;
+}
+
+BlockLogWriter::~BlockLogWriter() {
+	close();
+}
+
+int BlockLogWriter::open(const char * path, uint32_t uid) {
+	BlockLogHeader header;
+
+	close();
+
+	file_ = fopen(path, "wb");
+	if (!file_) {
+		log("pixydebug: BlockLogWriter::open(): cannot create %s\n", path);
+		return -1;
+	}
+
+	header.magic = BLOCKLOG_MAGIC;
+	header.version = BLOCKLOG_VERSION;
+	header.reserved = 0;
+	header.uid = uid;
+	header.chunk_us = BLOCKLOG_CHUNK_US;
+	header.start_us = util::timestamp_us();
+
+	failed_ = fwrite(&header, sizeof(header), 1, file_) != 1;
+	offset_ = sizeof(header);
+	memset(&chunk_, 0, sizeof(chunk_));
+	frames_.clear();
+	previous_.clear();
+	index_.clear();
+
+	return 0;
+}
+
+int BlockLogWriter::close() {
+	BlockLogTrailer trailer;
+	int             result;
+
+	if (!file_) {
+		return 0;
+	}
+
+	if (chunk_.frames) {
+		write_chunk();
+	}
+
+	trailer.index_offset = offset_;
+	trailer.entries = index_.size();
+	trailer.magic = BLOCKLOG_INDEX_MAGIC;
+	if (!index_.empty() && fwrite(&index_[0], sizeof(BlockLogIndexEntry), index_.size(), file_) != index_.size()) {
+		failed_ = true;
+	}
+	if (fwrite(&trailer, sizeof(trailer), 1, file_) != 1) {
+		failed_ = true;
+	}
+	if (fclose(file_) != 0) {
+		failed_ = true;
+	}
+	file_ = NULL;
+
+	result = failed_ ? -1 : 0;
+	failed_ = false;
+	index_.clear();
+	return result;
+}
+
+bool BlockLogWriter::is_open() const {
+	return file_ != NULL;
+}
+
+void BlockLogWriter::write(const Block * blocks, uint32_t count, uint64_t timestamp_us) {
+	const Block * base;
+	uint32_t      index;
+	uint8_t       fields;
+
+	if (!file_) {
+		return;
+	}
+
+	if (chunk_.frames && timestamp_us - chunk_.first_us >= BLOCKLOG_CHUNK_US) {
+		write_chunk();
+	}
+
+	// Every chunk starts from a zero block, as a key frame //
+	if (chunk_.frames == 0) {
+		chunk_.first_us = timestamp_us;
+		previous_us_ = timestamp_us;
+		previous_.clear();
+	}
+
+	put_varint(frames_, timestamp_us > previous_us_ ? timestamp_us - previous_us_ : 0);
+	put_varint(frames_, count);
+
+	for (index = 0; index < count; ++index) {
+		const Block & block = blocks[index];
+
+		base = index < previous_.size() ? &previous_[index] : &zero_block;
+		fields = (block.type != base->type ? BLOCKLOG_FIELD_TYPE : 0) |
+		         (block.signature != base->signature ? BLOCKLOG_FIELD_SIGNATURE : 0) |
+		         (block.x != base->x ? BLOCKLOG_FIELD_X : 0) |
+		         (block.y != base->y ? BLOCKLOG_FIELD_Y : 0) |
+		         (block.width != base->width ? BLOCKLOG_FIELD_WIDTH : 0) |
+		         (block.height != base->height ? BLOCKLOG_FIELD_HEIGHT : 0) |
+		         (block.angle != base->angle ? BLOCKLOG_FIELD_ANGLE : 0);
+
+		frames_.push_back(fields);
+		if (fields & BLOCKLOG_FIELD_TYPE)      put_field(frames_, block.type, base->type);
+		if (fields & BLOCKLOG_FIELD_SIGNATURE) put_field(frames_, block.signature, base->signature);
+		if (fields & BLOCKLOG_FIELD_X)         put_field(frames_, block.x, base->x);
+		if (fields & BLOCKLOG_FIELD_Y)         put_field(frames_, block.y, base->y);
+		if (fields & BLOCKLOG_FIELD_WIDTH)     put_field(frames_, block.width, base->width);
+		if (fields & BLOCKLOG_FIELD_HEIGHT)    put_field(frames_, block.height, base->height);
+		if (fields & BLOCKLOG_FIELD_ANGLE)     put_field(frames_, block.angle, base->angle);
+	}
+
+	previous_.assign(blocks, blocks + count);
+	previous_us_ = timestamp_us;
+	chunk_.last_us = timestamp_us;
+	++chunk_.frames;
+}
+
+void BlockLogWriter::write_chunk() {
+	BlockLogIndexEntry entry;
+
+	chunk_.magic = BLOCKLOG_CHUNK_MAGIC;
+	chunk_.length = frames_.size();
+	entry.first_us = chunk_.first_us;
+	entry.offset = offset_;
+
+	// A chunk is flushed whole, so a log cut short ends at its last one //
+	if (fwrite(&chunk_, sizeof(chunk_), 1, file_) != 1 ||
+	    (!frames_.empty() && fwrite(&frames_[0], frames_.size(), 1, file_) != 1) ||
+	    fflush(file_) != 0) {
+		failed_ = true;
+	}
+	else {
+		index_.push_back(entry);
+	}
+
+	offset_ += sizeof(chunk_) + frames_.size();
+	frames_.clear();
+	memset(&chunk_, 0, sizeof(chunk_));
+}
+
+BlockLogReader::BlockLogReader() {
+	data_ = NULL;
+	size_ = 0;
+	memset(&header_, 0, sizeof(header_));
+	last_us_ = 0;
+	next_chunk_ = 0;
+	next_ = 0;
+	end_ = 0;
+	frames_left_ = 0;
+	time_us_ = 0;
+	pending_ = false;
+}
+
+BlockLogReader::~BlockLogReader() {
+	close();
+}
+
+int BlockLogReader::open(const char * path) {
+	BlockLogTrailer    trailer;
+	BlockLogChunk      chunk;
+	struct stat        status;
+	void *             data;
+	int                fd;
+	uint32_t           index;
+
+	close();
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		log("pixydebug: BlockLogReader::open(): cannot open %s\n", path);
+		return -1;
+	}
+	if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(header_)) {
+		::close(fd);
+		return -1;
+	}
+
+	data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return -1;
+	}
+
+	data_ = static_cast<const uint8_t *>(data);
+	size_ = status.st_size;
+
+	memcpy(&header_, data_, sizeof(header_));
+	if (header_.magic != BLOCKLOG_MAGIC || header_.version != BLOCKLOG_VERSION) {
+		log("pixydebug: BlockLogReader::open(): %s is not a block log\n", path);
+		close();
+		return -1;
+	}
+
+	// Use the index of a closed log, else find the chunks //
+	if (size_ >= sizeof(header_) + sizeof(trailer)) {
+		memcpy(&trailer, data_ + size_ - sizeof(trailer), sizeof(trailer));
+	}
+	else {
+		trailer.magic = 0;
+	}
+	if (trailer.magic == BLOCKLOG_INDEX_MAGIC && trailer.index_offset >= sizeof(header_) &&
+	    trailer.index_offset + (uint64_t)trailer.entries * sizeof(BlockLogIndexEntry) + sizeof(trailer) == size_) {
+		index_.resize(trailer.entries);
+		if (trailer.entries) {
+			memcpy(&index_[0], data_ + trailer.index_offset, trailer.entries * sizeof(BlockLogIndexEntry));
+		}
+		for (index = 0; index < index_.size(); ++index) {
+			if (index_[index].offset + sizeof(chunk) > trailer.index_offset) {
+				index_.resize(index);
+				break;
+			}
+		}
+	}
+	else {
+		index_chunks();
+	}
+
+	if (!index_.empty()) {
+		memcpy(&chunk, data_ + index_.back().offset, sizeof(chunk));
+		last_us_ = chunk.last_us;
+	}
+
+	seek(0);
+	return 0;
+}
+
+void BlockLogReader::close() {
+	if (data_) {
+		munmap(const_cast<uint8_t *>(data_), size_);
+	}
+	data_ = NULL;
+	size_ = 0;
+	index_.clear();
+	last_us_ = 0;
+	next_chunk_ = 0;
+	frames_left_ = 0;
+	pending_ = false;
+}
+
+uint32_t BlockLogReader::uid() const {
+	return header_.uid;
+}
+
+uint64_t BlockLogReader::first_us() const {
+	return index_.empty() ? 0 : index_[0].first_us;
+}
+
+uint64_t BlockLogReader::last_us() const {
+	return last_us_;
+}
+
+void BlockLogReader::seek(uint64_t timestamp_us) {
+	uint32_t low;
+	uint32_t high;
+	uint32_t middle;
+
+	// Last chunk starting at or before 'timestamp_us' //
+	low = 0;
+	high = index_.size();
+	while (high - low > 1) {
+		middle = (low + high) / 2;
+		if (index_[middle].first_us <= timestamp_us) {
+			low = middle;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	next_chunk_ = low;
+	frames_left_ = 0;
+	pending_ = false;
+
+	while (decode_frame()) {
+		if (time_us_ >= timestamp_us) {
+			pending_ = true;
+			break;
+		}
+	}
+}
+
+int BlockLogReader::read(uint64_t * timestamp_us, uint16_t max_blocks, Block * blocks) {
+	uint32_t count;
+
+	if (!pending_ && !decode_frame()) {
+		return -1;
+	}
+	pending_ = false;
+
+	count = frame_.size() < max_blocks ? frame_.size() : max_blocks;
+	if (count) {
+		memcpy(blocks, &frame_[0], count * sizeof(Block));
+	}
+	if (timestamp_us) {
+		*timestamp_us = time_us_;
+	}
+
+	return count;
+}
+
+void BlockLogReader::index_chunks() {
+	BlockLogChunk      chunk;
+	BlockLogIndexEntry entry;
+	size_t             offset;
+
+	// Chunk headers chain through their lengths //
+	offset = sizeof(header_);
+	while (offset + sizeof(chunk) <= size_) {
+		memcpy(&chunk, data_ + offset, sizeof(chunk));
+		if (chunk.magic != BLOCKLOG_CHUNK_MAGIC || chunk.length > size_ - offset - sizeof(chunk)) {
+			break;
+		}
+		entry.first_us = chunk.first_us;
+		entry.offset = offset;
+		index_.push_back(entry);
+		offset += sizeof(chunk) + chunk.length;
+	}
+}
+
+bool BlockLogReader::start_chunk(uint32_t chunk_index) {
+	BlockLogChunk chunk;
+	size_t        offset;
+
+	offset = index_[chunk_index].offset;
+	memcpy(&chunk, data_ + offset, sizeof(chunk));
+	if (chunk.magic != BLOCKLOG_CHUNK_MAGIC || chunk.length > size_ - offset - sizeof(chunk)) {
+		return false;
+	}
+
+	next_ = offset + sizeof(chunk);
+	end_ = next_ + chunk.length;
+	frames_left_ = chunk.frames;
+	time_us_ = chunk.first_us;
+	frame_.clear();
+	return true;
+}
+
+bool BlockLogReader::decode_frame() {
+	uint64_t delta_us;
+	uint64_t count;
+	uint32_t index;
+	uint8_t  fields;
+	bool     valid;
+
+	for (;;) {
+		while (frames_left_ == 0) {
+			if (next_chunk_ >= index_.size()) {
+				return false;
+			}
+			start_chunk(next_chunk_++);
+		}
+		--frames_left_;
+
+		// Each block takes a byte at least //
+		valid = get_varint(data_, end_, next_, delta_us) && get_varint(data_, end_, next_, count) && count <= end_ - next_;
+		if (valid) {
+			frame_.resize(count, zero_block);
+		}
+
+		for (index = 0; valid && index < count; ++index) {
+			Block & block = frame_[index];
+
+			fields = data_[next_++];
+			valid = (!(fields & BLOCKLOG_FIELD_TYPE) || get_field(data_, end_, next_, block.type)) &&
+			        (!(fields & BLOCKLOG_FIELD_SIGNATURE) || get_field(data_, end_, next_, block.signature)) &&
+			        (!(fields & BLOCKLOG_FIELD_X) || get_field(data_, end_, next_, block.x)) &&
+			        (!(fields & BLOCKLOG_FIELD_Y) || get_field(data_, end_, next_, block.y)) &&
+			        (!(fields & BLOCKLOG_FIELD_WIDTH) || get_field(data_, end_, next_, block.width)) &&
+			        (!(fields & BLOCKLOG_FIELD_HEIGHT) || get_field(data_, end_, next_, block.height)) &&
+			        (!(fields & BLOCKLOG_FIELD_ANGLE) || get_field(data_, end_, next_, *reinterpret_cast<uint16_t *>(&block.angle))) &&
+			        (index + 1 == count || next_ < end_);
+		}
+
+		if (valid) {
+			time_us_ += delta_us;
+			return true;
+		}
+
+		// Skip the rest of a damaged chunk //
+		frames_left_ = 0;
+	}
+}
@@ -0,0 +1,188 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __BLOCKLOG_HPP__
+#define __BLOCKLOG_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "pixy.h"
+
+// Block log file: a BlockLogHeader, then chunks of frames, each a          //
+// BlockLogChunk followed by 'length' bytes of encoded frames. Closing the  //
+// log appends one BlockLogIndexEntry per chunk and a BlockLogTrailer, so a //
+// reader finds any time with a binary search. A log cut short has no index //
+// and ends at its last whole chunk; readers then skip from chunk header to //
+// chunk header instead. Structures may be unaligned in the file.           //
+//                                                                          //
+// A frame is its time in microseconds after the previous frame of the      //
+// chunk (after 'first_us' for the first one), its number of blocks, then   //
+// each block as a byte of BLOCKLOG_FIELD_* bits and the zigzag difference  //
+// of every field flagged in it. Differences are taken with the block at    //
+// the same index in the previous frame, or with a zero block at the start  //
+// of a chunk, which is how a reader can start decoding at any chunk.       //
+// Numbers are LEB128 varints, structures are in host byte order.           //
+
+#define BLOCKLOG_MAGIC              0x42584950  // "PIXB"
+#define BLOCKLOG_CHUNK_MAGIC        0x43584950  // "PIXC"
+#define BLOCKLOG_INDEX_MAGIC        0x49584950  // "PIXI"
+#define BLOCKLOG_VERSION            1
+
+// Time covered by one chunk, the most a reader decodes to seek //
+#define BLOCKLOG_CHUNK_US           1000000
+
+#define BLOCKLOG_FIELD_TYPE         0x01
+#define BLOCKLOG_FIELD_SIGNATURE    0x02
+#define BLOCKLOG_FIELD_X            0x04
+#define BLOCKLOG_FIELD_Y            0x08
+#define BLOCKLOG_FIELD_WIDTH        0x10
+#define BLOCKLOG_FIELD_HEIGHT       0x20
+#define BLOCKLOG_FIELD_ANGLE        0x40
+
+struct BlockLogHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t uid;           // of the logged Pixy
+    uint32_t chunk_us;
+    uint64_t start_us;      // util::timestamp_us() when logging started
+};
+
+struct BlockLogChunk
+{
+    uint32_t magic;
+    uint32_t length;        // bytes of encoded frames that follow
+    uint32_t frames;
+    uint32_t reserved;
+    uint64_t first_us;      // time of the first frame
+    uint64_t last_us;       // time of the last frame
+};
+
+struct BlockLogIndexEntry
+{
+    uint64_t first_us;
+    uint64_t offset;        // of the BlockLogChunk in the file
+};
+
+struct BlockLogTrailer
+{
+    uint64_t index_offset;  // of the first BlockLogIndexEntry
+    uint32_t entries;
+    uint32_t magic;
+};
+
+/**
+  @brief  Streams the block frames of a Pixy to a block log. Frames are
+          encoded into the current chunk, which is written out whole when
+          it covers BLOCKLOG_CHUNK_US, so writing costs about a
+          microsecond per frame and one fwrite() per second.
+*/
+class BlockLogWriter
+{
+  public:
+
+    BlockLogWriter();
+    ~BlockLogWriter();
+
+    /**
+      @return  0   Success
+      @return  -1  The file could not be created
+    */
+    int open(const char * path, uint32_t uid);
+
+    /**
+      @brief  Writes the last chunk and the index, then closes the file.
+      @return 0   Success
+      @return -1  A write failed, the log may be cut short
+    */
+    int close();
+
+    bool is_open() const;
+
+    void write(const Block * blocks, uint32_t count, uint64_t timestamp_us);
+
+  private:
+
+    void write_chunk();
+
+    FILE *                          file_;
+    bool                            failed_;
+    uint64_t                        offset_;
+    BlockLogChunk                   chunk_;
+    std::vector<uint8_t>            frames_;
+    std::vector<Block>              previous_;
+    uint64_t                        previous_us_;
+    std::vector<BlockLogIndexEntry> index_;
+};
+
+/**
+  @brief  Reads a block log through a read-only memory mapping.
+*/
+class BlockLogReader
+{
+  public:
+
+    BlockLogReader();
+    ~BlockLogReader();
+
+    /**
+      @return  0   Success
+      @return  -1  The file could not be mapped or is not a block log
+    */
+    int open(const char * path);
+    void close();
+
+    uint32_t uid() const;
+    uint64_t first_us() const;
+    uint64_t last_us() const;
+
+    /**
+      @brief  Makes the next read() return the first frame at or after
+              'timestamp_us'. Decodes at most one chunk.
+    */
+    void seek(uint64_t timestamp_us);
+
+    /**
+      @brief  Reads the next frame, copying up to 'max_blocks' blocks.
+      @return Non-negative  Number of blocks copied
+      @return -1            End of the log
+    */
+    int read(uint64_t * timestamp_us, uint16_t max_blocks, Block * blocks);
+
+  private:
+
+    void index_chunks();
+    bool start_chunk(uint32_t chunk);
+    bool decode_frame();
+
+    const uint8_t *                 data_;
+    size_t                          size_;
+    BlockLogHeader                  header_;
+    std::vector<BlockLogIndexEntry> index_;
+    uint64_t                        last_us_;
+
+    // Decoding position //
+    uint32_t                        next_chunk_;
+    size_t                          next_;
+    size_t                          end_;
+    uint32_t                        frames_left_;
+    uint64_t                        time_us_;
+    std::vector<Block>              frame_;
+    bool                            pending_;
+};
+
+#endif
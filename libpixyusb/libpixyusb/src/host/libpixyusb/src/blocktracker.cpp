@@ -0,0 +1,340 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <algorithm>
+#include "blocktracker.hpp"
+
+namespace
+{
+	uint16_t clamp_coordinate(float value, uint16_t max)
+	{
+		if (value < 0.0f) {
+			return 0;
+		}
+		if (value > max) {
+			return max;
+		}
+		return (uint16_t)(value + 0.5f);
+	}
+}
+
+bool BlockTracker::Candidate::operator<(const Candidate & other) const {
+	// Break ties on index so assignment does not depend on sort stability //
+	if (cost != other.cost) {
+		return cost < other.cost;
+	}
+	if (track != other.track) {
+		return track < other.track;
+	}
+	return block < other.block;
+}
+
+bool BlockTracker::GateOrder::operator()(uint16_t a, uint16_t b) const {
+	if (tracker->tracks_[a].key != tracker->tracks_[b].key) {
+		return tracker->tracks_[a].key < tracker->tracks_[b].key;
+	}
+	return tracker->predicted_x_[a] - tracker->gate_[a] < tracker->predicted_x_[b] - tracker->gate_[b];
+}
+
+bool BlockTracker::BlockOrder::operator()(uint16_t a, uint16_t b) const {
+	if (key(blocks[a]) != key(blocks[b])) {
+		return key(blocks[a]) < key(blocks[b]);
+	}
+	return blocks[a].x < blocks[b].x;
+}
+
+BlockTracker::BlockTracker() {
+	next_id_ = 1;
+
+	tracks_.reserve(PIXY_BLOCK_CAPACITY);
+	candidates_.reserve(PIXY_BLOCK_CAPACITY);
+}
+
+void BlockTracker::reset() {
+	tracks_.clear();
+}
+
+uint32_t BlockTracker::key(const Block & block) {
+	return ((uint32_t)block.type << 16) | block.signature;
+}
+
+void BlockTracker::update(const Block * blocks, uint16_t count, uint64_t timestamp_us) {
+	uint32_t index;
+	uint16_t alive;
+
+	// Blocks come largest first, the rest would only add candidates //
+	if (count > PIXY_BLOCK_CAPACITY) {
+		count = PIXY_BLOCK_CAPACITY;
+	}
+
+	predict(timestamp_us);
+	gather_candidates(blocks, count);
+
+	// Greedy assignment, cheapest pair first //
+
+	track_matched_.assign(tracks_.size(), 0);
+	block_matched_.assign(count, 0);
+
+	std::sort(candidates_.begin(), candidates_.end());
+
+	for (index = 0; index != candidates_.size(); ++index) {
+		const Candidate & candidate = candidates_[index];
+
+		if (track_matched_[candidate.track] || block_matched_[candidate.block]) {
+			continue;
+		}
+
+		track_matched_[candidate.track] = 1;
+		block_matched_[candidate.block] = 1;
+		correct(tracks_[candidate.track], blocks[candidate.block], timestamp_us);
+	}
+
+	// Coast unmatched tracks and drop the ones that missed too many frames //
+
+	for (index = 0, alive = 0; index != tracks_.size(); ++index) {
+		Track & track = tracks_[index];
+
+		if (!track_matched_[index]) {
+			if (++track.missed > TRACK_MAX_MISSED) {
+				continue;
+			}
+			track.block.x = clamp_coordinate(predicted_x_[index], PIXY_MAX_X);
+			track.block.y = clamp_coordinate(predicted_y_[index], PIXY_MAX_Y);
+			++track.age;
+		}
+
+		if (alive != index) {
+			tracks_[alive] = track;
+		}
+		++alive;
+	}
+	tracks_.resize(alive);
+
+	// Start tracks for unmatched blocks //
+
+	for (index = 0; index != count && tracks_.size() < PIXY_BLOCK_CAPACITY; ++index) {
+		if (block_matched_[index]) {
+			continue;
+		}
+
+		Track track;
+
+		track.id           = next_id_++;
+		track.key          = key(blocks[index]);
+		track.block        = blocks[index];
+		track.x            = blocks[index].x;
+		track.y            = blocks[index].y;
+		track.vx           = 0.0f;
+		track.vy           = 0.0f;
+		track.timestamp_us = timestamp_us;
+		track.age          = 1;
+		track.missed       = 0;
+
+		if (next_id_ == 0) {
+			next_id_ = 1;
+		}
+
+		tracks_.push_back(track);
+	}
+}
+
+uint16_t BlockTracker::get_tracks(uint16_t max_tracks, TrackedBlock * tracks) const {
+	uint16_t index;
+
+	for (index = 0; index != max_tracks && index != tracks_.size(); ++index) {
+		const Track & track = tracks_[index];
+
+		tracks[index].id     = track.id;
+		tracks[index].block  = track.block;
+		tracks[index].vx     = track.vx;
+		tracks[index].vy     = track.vy;
+		tracks[index].age    = track.age;
+		tracks[index].missed = track.missed;
+	}
+
+	return index;
+}
+
+uint16_t BlockTracker::predict_tracks(uint64_t timestamp_us, uint16_t max_tracks, TrackedBlock * tracks) const {
+	uint16_t index;
+	float    dt;
+
+	index = get_tracks(max_tracks, tracks);
+
+	for (uint16_t track_index = 0; track_index != index; ++track_index) {
+		const Track & track = tracks_[track_index];
+
+		// The requested time may precede the latest block //
+		dt = (int64_t)(timestamp_us - track.timestamp_us) * 1e-6f;
+
+		tracks[track_index].block.x = clamp_coordinate(track.x + track.vx * dt, PIXY_MAX_X);
+		tracks[track_index].block.y = clamp_coordinate(track.y + track.vy * dt, PIXY_MAX_Y);
+	}
+
+	return index;
+}
+
+void BlockTracker::predict(uint64_t timestamp_us) {
+	uint16_t index;
+	float    dt;
+
+	predicted_x_.resize(tracks_.size());
+	predicted_y_.resize(tracks_.size());
+
+	for (index = 0; index != tracks_.size(); ++index) {
+		const Track & track = tracks_[index];
+
+		dt = (timestamp_us - track.timestamp_us) * 1e-6f;
+		predicted_x_[index] = track.x + track.vx * dt;
+		predicted_y_[index] = track.y + track.vy * dt;
+	}
+}
+
+void BlockTracker::gather_candidates(const Block * blocks, uint16_t count) {
+	uint16_t   index;
+	uint16_t   track_index;
+	uint16_t   next_track;
+	uint16_t   active;
+	uint32_t   block_key;
+	float      gate;
+	float      dx;
+	float      dy;
+	float      dw;
+	float      dh;
+	float      distance;
+	GateOrder  gate_order = { this };
+	BlockOrder block_order = { blocks };
+	Candidate  candidate;
+
+	candidates_.clear();
+
+	// Sweep the blocks of each signature from left to right over the   //
+	// gates of the tracks, sorted by their left edge. The active tracks //
+	// are the ones whose gate spans the x of the block, so each block   //
+	// only visits tracks it may match, whatever the size of the others. //
+
+	gate_.resize(tracks_.size());
+	order_.resize(tracks_.size());
+
+	for (index = 0; index != tracks_.size(); ++index) {
+		order_[index] = index;
+		gate_[index] = TRACK_MIN_GATE + std::max(tracks_[index].block.width, tracks_[index].block.height);
+	}
+
+	std::sort(order_.begin(), order_.end(), gate_order);
+
+	block_order_.resize(count);
+	for (index = 0; index != count; ++index) {
+		block_order_[index] = index;
+	}
+
+	std::sort(block_order_.begin(), block_order_.end(), block_order);
+
+	active_.clear();
+	next_track = 0;
+
+	for (index = 0; index != count; ++index) {
+		const Block & block = blocks[block_order_[index]];
+
+		block_key = key(block);
+		if (index != 0 && block_key != key(blocks[block_order_[index - 1]])) {
+			active_.clear();
+		}
+
+		// Open the gates that start at or before this block //
+
+		for (; next_track != order_.size(); ++next_track) {
+			track_index = order_[next_track];
+
+			if (tracks_[track_index].key > block_key ||
+			    (tracks_[track_index].key == block_key && predicted_x_[track_index] - gate_[track_index] > block.x)) {
+				break;
+			}
+			if (tracks_[track_index].key == block_key) {
+				active_.push_back(track_index);
+			}
+		}
+
+		for (active = 0; active != active_.size();) {
+			track_index = active_[active];
+			const Track & track = tracks_[track_index];
+
+			// Gates that end before this block end before the next ones too //
+			if (predicted_x_[track_index] + gate_[track_index] < block.x) {
+				active_[active] = active_.back();
+				active_.pop_back();
+				continue;
+			}
+			++active;
+
+			gate = gate_[track_index];
+			dx = block.x - predicted_x_[track_index];
+			dy = block.y - predicted_y_[track_index];
+			distance = dx * dx + dy * dy;
+
+			if (distance > gate * gate) {
+				continue;
+			}
+
+			dw = (float)block.width - track.block.width;
+			dh = (float)block.height - track.block.height;
+
+			candidate.cost  = (uint32_t)(distance + (dw * dw + dh * dh) * 0.25f);
+			candidate.track = track_index;
+			candidate.block = block_order_[index];
+			candidates_.push_back(candidate);
+		}
+	}
+}
+
+void BlockTracker::correct(Track & track, const Block & block, uint64_t timestamp_us) {
+	float dt;
+	float rx;
+	float ry;
+
+	dt = (timestamp_us - track.timestamp_us) * 1e-6f;
+
+	if (dt <= 0.0f) {
+		// Same receive time, nothing to filter //
+		track.x = block.x;
+		track.y = block.y;
+	}
+	else if (track.age == 1) {
+		// Second measurement initializes the velocity //
+		track.vx = (block.x - track.x) / dt;
+		track.vy = (block.y - track.y) / dt;
+		track.x  = block.x;
+		track.y  = block.y;
+	}
+	else {
+		// Alpha-beta filter: correct the constant velocity //
+		// prediction with the measurement residual.        //
+		track.x += track.vx * dt;
+		track.y += track.vy * dt;
+
+		rx = block.x - track.x;
+		ry = block.y - track.y;
+
+		track.x  += TRACK_ALPHA * rx;
+		track.y  += TRACK_ALPHA * ry;
+		track.vx += TRACK_BETA * rx / dt;
+		track.vy += TRACK_BETA * ry / dt;
+	}
+
+	track.block        = block;
+	track.timestamp_us = timestamp_us;
+	track.missed       = 0;
+	++track.age;
+}
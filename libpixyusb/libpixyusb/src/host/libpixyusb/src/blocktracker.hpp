@@ -0,0 +1,129 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __BLOCKTRACKER_HPP__
+#define __BLOCKTRACKER_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "pixy.h"
+
+// Minimum association distance in pixels. The block size is added to this. //
+#define TRACK_MIN_GATE      16
+// Number of frames a track survives without a matching block //
+#define TRACK_MAX_MISSED    5
+// Alpha-beta filter gains for position and velocity //
+#define TRACK_ALPHA         0.85f
+#define TRACK_BETA          0.3f
+
+class BlockTracker
+{
+  public:
+
+    BlockTracker();
+
+    /**
+      @brief  Drops every track. Track identifiers are not reused.
+    */
+    void reset();
+
+    /**
+      @brief      Associates the blocks of a new frame with the existing
+                  tracks. Blocks are only matched to tracks with the same
+                  type and signature. Candidate pairs are gated on distance
+                  and assigned greedily, cheapest first, so each frame costs
+                  O(n log n) for well separated blocks. Only the first
+                  PIXY_BLOCK_CAPACITY blocks, the largest ones, are tracked.
+      @param[in]  blocks        Blocks of the frame.
+      @param[in]  count         Size of the 'blocks' array.
+      @param[in]  timestamp_us  Monotonic time the frame was received.
+    */
+    void update(const Block * blocks, uint16_t count, uint64_t timestamp_us);
+
+    /**
+      @brief      Copies up to 'max_tracks' tracks, oldest track first.
+                  Tracks that missed the latest frame report their
+                  position coasted to that frame.
+      @return     Number of tracks copied.
+    */
+    uint16_t get_tracks(uint16_t max_tracks, TrackedBlock * tracks) const;
+
+    /**
+      @brief      Copies up to 'max_tracks' tracks with their position
+                  extrapolated to 'timestamp_us' at constant velocity.
+      @return     Number of tracks copied.
+    */
+    uint16_t predict_tracks(uint64_t timestamp_us, uint16_t max_tracks, TrackedBlock * tracks) const;
+
+  private:
+
+    struct Track
+    {
+      uint32_t id;
+      uint32_t key;           // (type << 16) | signature
+      Block    block;         // Latest reported block
+      float    x;             // Filtered position at 'timestamp_us'
+      float    y;
+      float    vx;            // Velocity in pixels per second
+      float    vy;
+      uint64_t timestamp_us;  // Time of the latest matching block
+      uint16_t age;
+      uint16_t missed;
+    };
+
+    struct Candidate
+    {
+      uint32_t cost;
+      uint16_t track;
+      uint16_t block;
+
+      bool operator<(const Candidate & other) const;
+    };
+
+    struct GateOrder
+    {
+      const BlockTracker * tracker;
+
+      bool operator()(uint16_t a, uint16_t b) const;
+    };
+
+    struct BlockOrder
+    {
+      const Block * blocks;
+
+      bool operator()(uint16_t a, uint16_t b) const;
+    };
+
+    std::vector<Track>     tracks_;
+    std::vector<float>     predicted_x_;
+    std::vector<float>     predicted_y_;
+    std::vector<float>     gate_;
+    std::vector<uint16_t>  order_;
+    std::vector<uint16_t>  block_order_;
+    std::vector<uint16_t>  active_;
+    std::vector<Candidate> candidates_;
+    std::vector<uint8_t>   track_matched_;
+    std::vector<uint8_t>   block_matched_;
+    uint32_t               next_id_;
+
+    static uint32_t key(const Block & block);
+
+    void predict(uint64_t timestamp_us);
+    void gather_candidates(const Block * blocks, uint16_t count);
+    void correct(Track & track, const Block & block, uint64_t timestamp_us);
+};
+
+#endif
@@ -15,11 +15,12 @@
 
 #include "chirpreceiver.hpp"
 
-ChirpReceiver::ChirpReceiver(USBLink * link, Interpreter * interpreter)
+ChirpReceiver::ChirpReceiver(Link * link, Interpreter * interpreter, metrics::Registry * metrics)
 {
   m_hinterested = true;
   m_client      = true;
   interpreter_  = interpreter;
+  metrics_      = metrics;
 
   setLink(link);
 }
@@ -36,3 +37,24 @@ void ChirpReceiver::handleXdata(const void * data[])
   // Interpret (Chirp) messages from Pixy //
   if (interpreter_) interpreter_->interpret_data(data);
 }
+
+void ChirpReceiver::handleEvent(uint8_t event)
+{
+  if (!metrics_) return;
+
+  switch (event)
+  {
+    case CRP_EVENT_RESYNC:
+      metrics_->chirp_resyncs.add();
+      break;
+    case CRP_EVENT_NACK_SENT:
+      metrics_->chirp_nacks_sent.add();
+      break;
+    case CRP_EVENT_NACK_RECEIVED:
+      metrics_->chirp_nacks_received.add();
+      break;
+    case CRP_EVENT_CRC_ERROR:
+      metrics_->chirp_crc_errors.add();
+      break;
+  }
+}
@@ -17,14 +17,15 @@
 #define __CHIRPRECEIVER_HPP__
 
 #include "chirp.hpp"
-#include "usblink.h"
+#include "link.h"
 #include "interpreter.hpp"
+#include "metrics.hpp"
 
 class ChirpReceiver : public Chirp
 {
   public:
 
-    ChirpReceiver(USBLink * link, Interpreter * interpreter);
+    ChirpReceiver(Link * link, Interpreter * interpreter, metrics::Registry * metrics = NULL);
     ~ChirpReceiver();
 
 	/**
@@ -35,9 +36,18 @@ class ChirpReceiver : public Chirp
 	*/
 	void handleXdata(const void * data[]);
 
+	/**
+	@brief Called by Chirp when a protocol event
+	such as a CRC error occurs.
+
+	@param[in] event  CRP_EVENT_* identifier.
+	*/
+	void handleEvent(uint8_t event);
+
   private:
 
-    Interpreter * interpreter_;
+    Interpreter *       interpreter_;
+    metrics::Registry * metrics_;
 };
 
 #endif
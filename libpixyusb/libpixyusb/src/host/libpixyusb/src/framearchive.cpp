@@ -0,0 +1,160 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <boost/atomic.hpp>
+#include "framearchive.hpp"
+#include "utils/timer.hpp"
+#include "debuglog.h"
+
+namespace
+{
+	size_t align(size_t size) {
+		return (size + PIXY_ARCHIVE_ALIGNMENT - 1) / PIXY_ARCHIVE_ALIGNMENT * PIXY_ARCHIVE_ALIGNMENT;
+	}
+}
+
+FrameArchive::FrameArchive() {
+	data_ = NULL;
+	size_ = 0;
+	header_ = NULL;
+	uid_ = 0;
+	records_ = 0;
+	record_size_ = 0;
+	sequence_ = 0;
+}
+
+FrameArchive::~FrameArchive() {
+	close();
+}
+
+int FrameArchive::open(const char * path, uint32_t uid, uint32_t frames, uint32_t frame_size) {
+	void * data;
+	size_t record_size;
+	size_t size;
+	int    flags;
+	int    fd;
+
+	close();
+
+	record_size = align(sizeof(PixyArchiveRecord) + frame_size);
+	if (frames == 0 || (uint32_t)record_size != record_size || ((size_t)-1 - PIXY_ARCHIVE_ALIGNMENT) / record_size < frames) {
+		return -1;
+	}
+	size = PIXY_ARCHIVE_ALIGNMENT + frames * record_size;
+
+	fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		log("pixydebug: FrameArchive::open(): cannot create %s\n", path);
+		return -1;
+	}
+
+	// Reserve the blocks now rather than on the first write of each page //
+#ifdef __LINUX__
+	if (posix_fallocate(fd, 0, size) != 0) {
+#else
+	if (ftruncate(fd, size) != 0) {
+#endif
+		log("pixydebug: FrameArchive::open(): cannot allocate %lu bytes\n", (unsigned long)size);
+		::close(fd);
+		unlink(path);
+		return -1;
+	}
+
+	flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+	flags |= MAP_POPULATE;
+#endif
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		unlink(path);
+		return -1;
+	}
+
+	data_ = static_cast<uint8_t *>(data);
+	size_ = size;
+	uid_ = uid;
+	records_ = frames;
+	record_size_ = record_size;
+	sequence_ = 0;
+
+	header_ = reinterpret_cast<PixyArchiveHeader *>(data_);
+	header_->magic = PIXY_ARCHIVE_MAGIC;
+	header_->version = PIXY_ARCHIVE_VERSION;
+	header_->reserved = 0;
+	header_->uid = uid;
+	header_->records = frames;
+	header_->record_size = record_size;
+	header_->reserved2 = 0;
+	header_->start_us = util::timestamp_us();
+	header_->next_sequence = 0;
+
+	return 0;
+}
+
+int FrameArchive::close() {
+	int result;
+
+	if (!data_) {
+		return 0;
+	}
+
+	result = msync(data_, size_, MS_SYNC) == 0 ? 0 : -1;
+	munmap(data_, size_);
+
+	data_ = NULL;
+	size_ = 0;
+	header_ = NULL;
+	return result;
+}
+
+bool FrameArchive::is_open() const {
+	return data_ != NULL;
+}
+
+void FrameArchive::write(const uint8_t * frame, uint32_t length, uint16_t width, uint16_t height, uint64_t timestamp_us) {
+	PixyArchiveRecord * record;
+
+	if (!data_) {
+		return;
+	}
+
+	if (length > record_size_ - sizeof(PixyArchiveRecord)) {
+		length = record_size_ - sizeof(PixyArchiveRecord);
+	}
+
+	record = reinterpret_cast<PixyArchiveRecord *>(data_ + PIXY_ARCHIVE_ALIGNMENT + (size_t)(sequence_ % records_) * record_size_);
+
+	// Readers of the mapping see the record as being written until the //
+	// frame and its header are in place, as with a sequence lock.       //
+	record->sequence = PIXY_ARCHIVE_WRITING;
+	boost::atomic_thread_fence(boost::memory_order_release);
+
+	memcpy(record + 1, frame, length);
+	record->magic = PIXY_ARCHIVE_RECORD_MAGIC;
+	record->uid = uid_;
+	record->timestamp_us = timestamp_us;
+	record->width = width;
+	record->height = height;
+	record->length = length;
+
+	boost::atomic_thread_fence(boost::memory_order_release);
+	record->sequence = sequence_;
+	header_->next_sequence = ++sequence_;
+}
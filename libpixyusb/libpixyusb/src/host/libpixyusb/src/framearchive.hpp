@@ -0,0 +1,72 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __FRAMEARCHIVE_HPP__
+#define __FRAMEARCHIVE_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "pixy.h"
+
+/**
+  @brief  Writes frames of a Pixy to a ring of fixed-size records in a
+          memory-mapped file, laid out as PixyArchiveHeader describes.
+          The file is preallocated and mapped up front, so a frame costs
+          one copy into the page cache and memory use stays bounded.
+*/
+class FrameArchive
+{
+  public:
+
+    FrameArchive();
+    ~FrameArchive();
+
+    /**
+      @brief      Creates and maps the archive.
+      @param[in]  frames      Number of records in the ring.
+      @param[in]  frame_size  Largest frame in bytes.
+      @return  0   Success
+      @return  -1  The file could not be created, preallocated or mapped
+    */
+    int open(const char * path, uint32_t uid, uint32_t frames, uint32_t frame_size);
+
+    /**
+      @brief  Flushes and unmaps the archive.
+      @return 0   Success
+      @return -1  The file could not be flushed
+    */
+    int close();
+
+    bool is_open() const;
+
+    /**
+      @brief  Writes a frame over the oldest record. Frames longer than
+              the records are cut short.
+    */
+    void write(const uint8_t * frame, uint32_t length, uint16_t width, uint16_t height, uint64_t timestamp_us);
+
+  private:
+
+    uint8_t *           data_;
+    size_t              size_;
+    PixyArchiveHeader * header_;
+    uint32_t            uid_;
+    uint32_t            records_;
+    uint32_t            record_size_;
+    uint64_t            sequence_;
+};
+
+#endif
@@ -0,0 +1,146 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include "hostlink.h"
+#include "utils/timer.hpp"
+#include "debuglog.h"
+#include "libusb.h"
+
+HostLink::HostLink()
+{
+	metrics_ = NULL;
+	traceUid_ = 0;
+	recording_ = NULL;
+	recordTime_us_ = 0;
+}
+
+HostLink::~HostLink()
+{
+	stopRecording();
+}
+
+void HostLink::start()
+{
+}
+
+bool HostLink::atEnd()
+{
+	return false;
+}
+
+void HostLink::setMetrics(metrics::Registry *metrics)
+{
+	metrics_ = metrics;
+}
+
+void HostLink::setTraceUid(uint32_t uid)
+{
+	traceUid_ = uid;
+}
+
+int HostLink::startRecording(const char *path, uint32_t uid)
+{
+	LinkRecordingHeader header;
+
+	stopRecording();
+
+	recording_ = fopen(path, "wb");
+	if (!recording_)
+	{
+		log("pixydebug: HostLink::startRecording(): cannot create %s\n", path);
+		return LINK_RESULT_ERROR;
+	}
+
+	recordTime_us_ = util::timestamp_us();
+
+	header.magic = LINK_RECORDING_MAGIC;
+	header.version = LINK_RECORDING_VERSION;
+	header.blockSize = m_blockSize;
+	header.uid = uid;
+	header.reserved = 0;
+	header.start_us = recordTime_us_;
+
+	if (fwrite(&header, sizeof(header), 1, recording_) != 1)
+	{
+		stopRecording();
+		return LINK_RESULT_ERROR;
+	}
+
+	return 0;
+}
+
+void HostLink::stopRecording()
+{
+	if (recording_)
+	{
+		fclose(recording_);
+		recording_ = NULL;
+	}
+}
+
+void HostLink::countTransfer(uint8_t direction, int res, const uint8_t *data, int transferred)
+{
+	int8_t result = (res < 0 ? res : 0);
+
+	if (transferred < 0)
+		transferred = 0;
+
+	if (recording_)
+	{
+		// Split long transfers into several records. Only the last //
+		// one carries the error of the transfer.                    //
+		int remaining = transferred;
+
+		do
+		{
+			uint16_t length = (remaining > LINK_RECORD_MAX_LENGTH ? LINK_RECORD_MAX_LENGTH : remaining);
+
+			record(direction, remaining > length ? 0 : result, data, length);
+			data += length;
+			remaining -= length;
+		} while (remaining > 0 && recording_);
+	}
+
+	if (!metrics_)
+		return;
+
+	if (res == LIBUSB_ERROR_TIMEOUT)
+		metrics_->usb_timeouts.add();
+	else if (res < 0)
+		metrics_->usb_errors.add();
+
+	// A timed out transfer may still have moved some data //
+	if (transferred > 0)
+		(direction == LINK_RECORD_SEND ? metrics_->usb_bytes_sent : metrics_->usb_bytes_received).add(transferred);
+}
+
+void HostLink::record(uint8_t direction, int8_t result, const uint8_t *data, uint16_t length)
+{
+	LinkRecord record;
+	uint64_t now_us = util::timestamp_us();
+
+	record.delta_us = (uint32_t)(now_us - recordTime_us_);
+	record.length = length;
+	record.direction = direction;
+	record.result = result;
+	recordTime_us_ = now_us;
+
+	if (fwrite(&record, sizeof(record), 1, recording_) != 1 ||
+		(length && fwrite(data, length, 1, recording_) != 1))
+	{
+		log("pixydebug: HostLink::record(): write failed, recording stopped\n");
+		stopRecording();
+	}
+}
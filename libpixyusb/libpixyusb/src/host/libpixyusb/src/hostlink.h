@@ -0,0 +1,111 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __HOSTLINK_H__
+#define __HOSTLINK_H__
+
+#include <stdio.h>
+#include "link.h"
+#include "metrics.hpp"
+
+// Link recording file: a LinkRecordingHeader, then one LinkRecord per  //
+// transfer followed by the 'length' bytes it moved. Records are only  //
+// ever appended, so a recording cut short ends at its last whole one. //
+
+#define LINK_RECORDING_MAGIC        0x52584950  // "PIXR"
+#define LINK_RECORDING_VERSION      1
+
+#define LINK_RECORD_RECEIVE         0
+#define LINK_RECORD_SEND            1
+
+// Longest transfer held by one record, longer ones take several //
+#define LINK_RECORD_MAX_LENGTH      0xffff
+
+struct LinkRecordingHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t blockSize;
+    uint32_t uid;           // of the recorded Pixy
+    uint32_t reserved;
+    uint64_t start_us;      // util::timestamp_us() when recording started
+};
+
+struct LinkRecord
+{
+    uint32_t delta_us;      // since the previous record
+    uint16_t length;        // bytes transferred
+    uint8_t  direction;     // LINK_RECORD_RECEIVE or LINK_RECORD_SEND
+    int8_t   result;        // 0, or the libusb error of the transfer
+};
+
+/**
+  @brief  Link to a Pixy on the host side: USB, or a replayed recording.
+          Counts its transfers in a metrics registry and can record them.
+          Like the rest of the link, recording must only be started and
+          stopped while the Chirp using the link is idle.
+*/
+class HostLink : public Link
+{
+public:
+    HostLink();
+    virtual ~HostLink();
+
+    virtual void close() = 0;
+
+    /**
+      @brief  Called once the Chirp handshake over the link is done.
+    */
+    virtual void start();
+
+    /**
+      @brief  True when the link has nothing more to receive, as a
+              recording that has been replayed to its end.
+    */
+    virtual bool atEnd();
+
+    void setMetrics(metrics::Registry *metrics);
+
+    /**
+      @brief  Sets the Pixy uid of the trace records of the link.
+    */
+    void setTraceUid(uint32_t uid);
+
+    /**
+      @brief  Writes every following transfer to a new recording file.
+      @return 0                   Success
+      @return LINK_RESULT_ERROR   The file could not be created
+    */
+    int startRecording(const char *path, uint32_t uid);
+    void stopRecording();
+
+protected:
+    /**
+      @brief  Counts and records a transfer that returned 'res' after
+              moving 'transferred' bytes of 'data'.
+    */
+    void countTransfer(uint8_t direction, int res, const uint8_t *data, int transferred);
+
+    metrics::Registry *metrics_;
+    uint32_t traceUid_;
+
+private:
+    void record(uint8_t direction, int8_t result, const uint8_t *data, uint16_t length);
+
+    FILE *recording_;
+    uint64_t recordTime_us_;
+};
+
+#endif
@@ -0,0 +1,277 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <string.h>
+#include "metrics.hpp"
+#include "utils/timer.hpp"
+
+namespace
+{
+	boost::atomic<bool> metrics_enabled(false);
+
+	uint32_t most_significant_bit(uint32_t value)
+	{
+#ifdef __GNUC__
+		return 31 - __builtin_clz(value);
+#else
+		uint32_t bit = 0;
+		while (value >>= 1) {
+			++bit;
+		}
+		return bit;
+#endif
+	}
+}
+
+bool metrics::enabled() {
+	return metrics_enabled.load(boost::memory_order_relaxed);
+}
+
+void metrics::set_enabled(bool enable) {
+	metrics_enabled.store(enable, boost::memory_order_relaxed);
+}
+
+uint64_t metrics::start() {
+	if (!enabled()) {
+		return 0;
+	}
+	return util::timestamp_us();
+}
+
+metrics::Counter::Counter() : value_(0) {
+}
+
+uint64_t metrics::Counter::get() const {
+	return value_.load(boost::memory_order_relaxed);
+}
+
+void metrics::Counter::reset() {
+	value_.store(0, boost::memory_order_relaxed);
+}
+
+metrics::Histogram::Histogram() {
+	reset();
+}
+
+uint32_t metrics::Histogram::bucket(uint64_t value_us) {
+	uint32_t value;
+	uint32_t msb;
+
+	// Values beyond 32 bits (over an hour) share the last bucket //
+	value = (value_us > 0xffffffff ? 0xffffffff : (uint32_t)value_us);
+
+	if (value < METRICS_SUB_BUCKETS) {
+		return value;
+	}
+
+	msb = most_significant_bit(value);
+
+	return METRICS_SUB_BUCKETS * (msb - METRICS_SUB_BUCKET_BITS + 1) + ((value >> (msb - METRICS_SUB_BUCKET_BITS)) & (METRICS_SUB_BUCKETS - 1));
+}
+
+uint64_t metrics::Histogram::bucket_upper_bound(uint32_t bucket) {
+	uint32_t shift;
+	uint32_t sub_bucket;
+
+	if (bucket < METRICS_SUB_BUCKETS) {
+		return bucket;
+	}
+
+	shift = bucket / METRICS_SUB_BUCKETS - 1;
+	sub_bucket = bucket % METRICS_SUB_BUCKETS;
+
+	return ((uint64_t)(METRICS_SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+}
+
+void metrics::Histogram::record(uint64_t value_us) {
+	uint64_t max_us;
+
+	if (!enabled()) {
+		return;
+	}
+
+	counts_[bucket(value_us)].fetch_add(1, boost::memory_order_relaxed);
+	sum_us_.fetch_add(value_us, boost::memory_order_relaxed);
+
+	max_us = max_us_.load(boost::memory_order_relaxed);
+	while (value_us > max_us && !max_us_.compare_exchange_weak(max_us, value_us, boost::memory_order_relaxed)) {
+	}
+}
+
+void metrics::Histogram::stop(uint64_t start_us) {
+	if (start_us) {
+		record(util::timestamp_us() - start_us);
+	}
+}
+
+uint64_t metrics::Histogram::accumulate(uint64_t * counts, uint64_t * sum_us) const {
+	uint32_t index;
+
+	for (index = 0; index != METRICS_BUCKETS; ++index) {
+		counts[index] += counts_[index].load(boost::memory_order_relaxed);
+	}
+	*sum_us += sum_us_.load(boost::memory_order_relaxed);
+
+	return max_us_.load(boost::memory_order_relaxed);
+}
+
+void metrics::Histogram::reset() {
+	uint32_t index;
+
+	for (index = 0; index != METRICS_BUCKETS; ++index) {
+		counts_[index].store(0, boost::memory_order_relaxed);
+	}
+	sum_us_.store(0, boost::memory_order_relaxed);
+	max_us_.store(0, boost::memory_order_relaxed);
+}
+
+void metrics::Histogram::summarize(const uint64_t * counts, uint64_t sum_us, uint64_t max_us, PixyLatencyStats * stats) {
+	static const uint32_t PERMILLE[] = { 500, 900, 990, 999 };
+	uint32_t * const percentiles[] = { &stats->p50_us, &stats->p90_us, &stats->p99_us, &stats->p999_us };
+
+	uint64_t count;
+	uint64_t seen;
+	uint32_t index;
+	uint32_t bucket;
+
+	count = 0;
+	for (bucket = 0; bucket != METRICS_BUCKETS; ++bucket) {
+		count += counts[bucket];
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	stats->count = count;
+	if (count == 0) {
+		return;
+	}
+
+	stats->mean_us = (uint32_t)(sum_us / count);
+	stats->max_us = (uint32_t)max_us;
+
+	// Report the upper bound of the bucket holding each percentile, //
+	// but never more than the largest recorded value.               //
+
+	for (index = 0, bucket = 0, seen = counts[0]; index != 4; ++index) {
+		while (seen * 1000 < count * PERMILLE[index] && bucket + 1 != METRICS_BUCKETS) {
+			seen += counts[++bucket];
+		}
+		*percentiles[index] = (uint32_t)(bucket_upper_bound(bucket) < max_us ? bucket_upper_bound(bucket) : max_us);
+	}
+}
+
+void metrics::Registry::reset() {
+	frames.reset();
+	blocks.reset();
+	blocks_dropped.reset();
+	commands.reset();
+	command_errors.reset();
+	chirp_resyncs.reset();
+	chirp_nacks_sent.reset();
+	chirp_nacks_received.reset();
+	chirp_crc_errors.reset();
+	usb_bytes_sent.reset();
+	usb_bytes_received.reset();
+	usb_timeouts.reset();
+	usb_errors.reset();
+	frame_interval.reset();
+	command_rtt.reset();
+	blocks_lock_wait.reset();
+}
+
+void metrics::Registry::accumulate(PixyStats * stats, uint64_t counts[3][METRICS_BUCKETS], uint64_t sums[3], uint64_t maxes[3]) const {
+	const Histogram * histograms[] = { &frame_interval, &command_rtt, &blocks_lock_wait };
+	uint32_t index;
+	uint64_t max_us;
+
+	stats->frames               += frames.get();
+	stats->blocks               += blocks.get();
+	stats->blocks_dropped       += blocks_dropped.get();
+	stats->commands             += commands.get();
+	stats->command_errors       += command_errors.get();
+	stats->chirp_resyncs        += chirp_resyncs.get();
+	stats->chirp_nacks_sent     += chirp_nacks_sent.get();
+	stats->chirp_nacks_received += chirp_nacks_received.get();
+	stats->chirp_crc_errors     += chirp_crc_errors.get();
+	stats->usb_bytes_sent       += usb_bytes_sent.get();
+	stats->usb_bytes_received   += usb_bytes_received.get();
+	stats->usb_timeouts         += usb_timeouts.get();
+	stats->usb_errors           += usb_errors.get();
+
+	for (index = 0; index != 3; ++index) {
+		max_us = histograms[index]->accumulate(counts[index], &sums[index]);
+		if (max_us > maxes[index]) {
+			maxes[index] = max_us;
+		}
+	}
+}
+
+void metrics::collect(const Registry * const * first, const Registry * const * last, PixyStats * stats) {
+	uint64_t counts[3][METRICS_BUCKETS];
+	uint64_t sums[3];
+	uint64_t maxes[3];
+
+	memset(stats, 0, sizeof(*stats));
+	memset(counts, 0, sizeof(counts));
+	memset(sums, 0, sizeof(sums));
+	memset(maxes, 0, sizeof(maxes));
+
+	for (; first != last; ++first) {
+		(*first)->accumulate(stats, counts, sums, maxes);
+	}
+
+	Histogram::summarize(counts[0], sums[0], maxes[0], &stats->frame_interval);
+	Histogram::summarize(counts[1], sums[1], maxes[1], &stats->command_rtt);
+	Histogram::summarize(counts[2], sums[2], maxes[2], &stats->blocks_lock_wait);
+}
+
+int metrics::format(const PixyStats * stats, char * buffer, uint32_t size) {
+	const struct {
+		const char *             name;
+		const PixyLatencyStats * latency;
+	} histograms[] = {
+		{ "frame_interval",   &stats->frame_interval },
+		{ "command_rtt",      &stats->command_rtt },
+		{ "blocks_lock_wait", &stats->blocks_lock_wait },
+	};
+
+	int      length;
+	int      return_value;
+	uint32_t index;
+
+	length = snprintf(buffer, size,
+	                  "frames %llu\nblocks %llu\nblocks_dropped %llu\n"
+	                  "commands %llu\ncommand_errors %llu\n"
+	                  "chirp_resyncs %llu\nchirp_nacks_sent %llu\nchirp_nacks_received %llu\nchirp_crc_errors %llu\n"
+	                  "usb_bytes_sent %llu\nusb_bytes_received %llu\nusb_timeouts %llu\nusb_errors %llu\n",
+	                  (unsigned long long)stats->frames, (unsigned long long)stats->blocks, (unsigned long long)stats->blocks_dropped,
+	                  (unsigned long long)stats->commands, (unsigned long long)stats->command_errors,
+	                  (unsigned long long)stats->chirp_resyncs, (unsigned long long)stats->chirp_nacks_sent,
+	                  (unsigned long long)stats->chirp_nacks_received, (unsigned long long)stats->chirp_crc_errors,
+	                  (unsigned long long)stats->usb_bytes_sent, (unsigned long long)stats->usb_bytes_received,
+	                  (unsigned long long)stats->usb_timeouts, (unsigned long long)stats->usb_errors);
+
+	for (index = 0; index != 3 && length >= 0; ++index) {
+		const PixyLatencyStats * latency = histograms[index].latency;
+
+		return_value = snprintf(buffer ? buffer + (length < (int)size ? length : size) : 0,
+		                        (length < (int)size ? size - length : 0),
+		                        "%s_us count %llu mean %u p50 %u p90 %u p99 %u p999 %u max %u\n",
+		                        histograms[index].name, (unsigned long long)latency->count, latency->mean_us,
+		                        latency->p50_us, latency->p90_us, latency->p99_us, latency->p999_us, latency->max_us);
+		length = (return_value < 0 ? return_value : length + return_value);
+	}
+
+	return length;
+}
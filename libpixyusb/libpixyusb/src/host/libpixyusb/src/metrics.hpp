@@ -0,0 +1,177 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __METRICS_HPP__
+#define __METRICS_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include "pixy.h"
+
+// Histogram resolution: each power of two is split into 2^METRICS_SUB_BUCKET_BITS buckets //
+#define METRICS_SUB_BUCKET_BITS   4
+#define METRICS_SUB_BUCKETS       (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_BUCKETS           (METRICS_SUB_BUCKETS * (33 - METRICS_SUB_BUCKET_BITS))
+
+namespace metrics
+{
+  /**
+    @brief  Returns true when metrics collection is enabled. Collection is
+            disabled by default; disabled counters and histograms cost one
+            relaxed load per update.
+  */
+  bool enabled();
+  void set_enabled(bool enable);
+
+  /**
+    @brief  Returns a timestamp in microseconds for latency measurement,
+            or 0 when metrics are disabled.
+  */
+  uint64_t start();
+
+  class Counter
+  {
+    public:
+
+      Counter();
+
+      void add(uint64_t amount = 1)
+      {
+        if (enabled()) {
+          value_.fetch_add(amount, boost::memory_order_relaxed);
+        }
+      }
+
+      uint64_t get() const;
+      void     reset();
+
+    private:
+
+      boost::atomic<uint64_t> value_;
+  };
+
+  /**
+    @brief  Lock-free log-linear latency histogram in microseconds.
+            Values below METRICS_SUB_BUCKETS are exact, larger values
+            are kept with METRICS_SUB_BUCKET_BITS bits of precision.
+  */
+  class Histogram
+  {
+    public:
+
+      Histogram();
+
+      void record(uint64_t value_us);
+
+      /**
+        @brief  Records the time elapsed since 'start_us', as returned by
+                metrics::start(). Does nothing when 'start_us' is 0.
+      */
+      void stop(uint64_t start_us);
+
+      /**
+        @brief  Adds the bucket counts to 'counts' (METRICS_BUCKETS entries)
+                and returns the largest recorded value.
+      */
+      uint64_t accumulate(uint64_t * counts, uint64_t * sum_us) const;
+
+      void reset();
+
+      static uint32_t bucket(uint64_t value_us);
+      static uint64_t bucket_upper_bound(uint32_t bucket);
+
+      /**
+        @brief  Summarizes accumulated bucket counts.
+      */
+      static void summarize(const uint64_t * counts, uint64_t sum_us, uint64_t max_us, PixyLatencyStats * stats);
+
+    private:
+
+      boost::atomic<uint32_t> counts_[METRICS_BUCKETS];
+      boost::atomic<uint64_t> sum_us_;
+      boost::atomic<uint64_t> max_us_;
+  };
+
+  /**
+    @brief  Scoped mutex lock that records how long the lock took to acquire.
+  */
+  class TimedLock
+  {
+    public:
+
+      TimedLock(boost::mutex & mutex, Histogram & wait) : mutex_(mutex)
+      {
+        uint64_t start_us = start();
+        mutex_.lock();
+        wait.stop(start_us);
+      }
+
+      ~TimedLock()
+      {
+        mutex_.unlock();
+      }
+
+    private:
+
+      boost::mutex & mutex_;
+  };
+
+  /**
+    @brief  Counters and histograms of one Pixy. Updated by the
+            PixyInterpreter, its ChirpReceiver and its USBLink.
+  */
+  struct Registry
+  {
+    Counter   frames;
+    Counter   blocks;
+    Counter   blocks_dropped;
+    Counter   commands;
+    Counter   command_errors;
+    Counter   chirp_resyncs;
+    Counter   chirp_nacks_sent;
+    Counter   chirp_nacks_received;
+    Counter   chirp_crc_errors;
+    Counter   usb_bytes_sent;
+    Counter   usb_bytes_received;
+    Counter   usb_timeouts;
+    Counter   usb_errors;
+    Histogram frame_interval;
+    Histogram command_rtt;
+    Histogram blocks_lock_wait;
+
+    void reset();
+
+    /**
+      @brief  Adds the counters of this registry to 'stats' and the
+              histogram buckets to the accumulators.
+    */
+    void accumulate(PixyStats * stats, uint64_t counts[3][METRICS_BUCKETS], uint64_t sums[3], uint64_t maxes[3]) const;
+  };
+
+  /**
+    @brief  Fills 'stats' from the registries in [first, last).
+  */
+  void collect(const Registry * const * first, const Registry * const * last, PixyStats * stats);
+
+  /**
+    @brief  Writes a text description of 'stats' to 'buffer'.
+    @return Number of characters that would have been written, as snprintf().
+  */
+  int format(const PixyStats * stats, char * buffer, uint32_t size);
+}
+
+#endif
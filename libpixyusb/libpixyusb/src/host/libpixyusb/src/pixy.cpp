@@ -1,15 +1,27 @@
 #include <boost/thread/shared_mutex.hpp>
 #include <map>
+#include <vector>
 #include <stdio.h>
 #include "pixy.h"
 #include "pixyinterpreter.hpp"
+#include "replaylink.h"
+#include "simulatedpixylink.h"
+#include "trace.hpp"
+#include "usblink.h"
 #include "debuglog.h"
+#include "utils/timer.hpp"
 #include "libusb.h"
 
 #define LIBUSB_CONTEXT NULL
 
 boost::shared_mutex pixy_map_mutex;
 std::map<uint32_t, PixyInterpreter *> interpreters;
+std::vector<PixySimulation> simulations;
+
+struct PixyBlockLog
+{
+  BlockLogReader reader;
+};
 
 /**
 
@@ -103,13 +115,14 @@ extern "C"
 		libusb_device_descriptor descriptor;
 		libusb_device_handle *handle;
 		USBLink *link;
+		SimulatedPixyLink *simulated_link;
 		PixyInterpreter *interpreter;
 		uint32_t device_uid;
 
 		return_value = libusb_init(LIBUSB_CONTEXT);
 		log("pixydebug:  libusb_init() = %d\n", return_value);
 		if (return_value) {
-			goto pixy_enumerate_return;
+			goto pixy_enumerate_usb_error;
 		}
 
 		//libusb_set_debug(LIBUSB_CONTEXT, LIBUSB_LOG_LEVEL_INFO);
@@ -117,7 +130,7 @@ extern "C"
 		return_value = libusb_get_device_list(LIBUSB_CONTEXT, &device_list);
 		log("pixydebug:  libusb_get_device_list() = %d\n", return_value);
 		if (return_value < 0) {
-			goto pixy_enumerate_return;
+			goto pixy_enumerate_usb_error;
 		}
 		device_count = return_value;
 
@@ -188,6 +201,7 @@ extern "C"
 				goto pixy_enumerate_close_interpreter;
 			}
 
+			interpreter->set_uid(device_uid);
 			interpreters[device_uid] = interpreter;
 			uids[pixy_count++] = device_uid;
 			continue;
@@ -209,6 +223,38 @@ extern "C"
 		}
 
 		libusb_free_device_list(device_list, 1);
+		goto pixy_enumerate_simulations;
+
+	pixy_enumerate_usb_error:
+		// Simulated Pixys don't need USB //
+		if (simulations.empty()) {
+			goto pixy_enumerate_return;
+		}
+		pixy_count = 0;
+
+	pixy_enumerate_simulations:
+		for (i = 0; i < (int)simulations.size() && pixy_count < max_pixy_count; i++) {
+			simulated_link = new SimulatedPixyLink();
+			if (simulated_link->open(simulations[i]) < 0) {
+				delete simulated_link;
+				continue;
+			}
+
+			interpreter = new PixyInterpreter();
+			interpreter->init(simulated_link);
+
+			return_value = interpreter->send_command("getUID", END_OUT_ARGS, &device_uid, END_IN_ARGS);
+			log("pixydebug:  simulation %d: send_command() = %d: device_uid = 0x%08X\n", i, return_value, device_uid);
+			if (return_value || interpreters.find(device_uid) != interpreters.end()) {
+				interpreter->close();
+				delete interpreter;
+				continue;
+			}
+
+			interpreter->set_uid(device_uid);
+			interpreters[device_uid] = interpreter;
+			uids[pixy_count++] = device_uid;
+		}
 		return_value = pixy_count;
 
 	pixy_enumerate_return:
@@ -236,6 +282,210 @@ extern "C"
 		log("pixydebug: pixy_close() returned\n");
 	}
 
+	int pixy_sim_add(const struct PixySimulation * simulation) {
+		boost::lock_guard<boost::shared_mutex> exclusive_lock(pixy_map_mutex);
+
+		std::vector<PixySimulation>::iterator search;
+
+		if (simulation == 0 ||
+		    !(simulation->packet_loss >= 0.0f && simulation->packet_loss <= 1.0f) ||
+		    !(simulation->corruption >= 0.0f && simulation->corruption <= 1.0f)) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		for (search = simulations.begin(); search != simulations.end(); ++search) {
+			if (search->uid == simulation->uid) {
+				return PIXY_ERROR_INVALID_PARAMETER;
+			}
+		}
+
+		simulations.push_back(*simulation);
+
+		return 0;
+	}
+
+	void pixy_sim_clear() {
+		boost::lock_guard<boost::shared_mutex> exclusive_lock(pixy_map_mutex);
+
+		simulations.clear();
+	}
+
+	int pixy_record_start(uint32_t uid, const char * path) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		return search->second->start_recording(path, uid);
+	}
+
+	int pixy_record_stop(uint32_t uid) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+
+		search->second->stop_recording();
+
+		return 0;
+	}
+
+	int pixy_replay_open(const char * path, uint8_t flags, uint32_t * uid) {
+		boost::lock_guard<boost::shared_mutex> exclusive_lock(pixy_map_mutex);
+
+		ReplayLink *link;
+		PixyInterpreter *interpreter;
+
+		log("pixydebug: pixy_replay_open()\n");
+
+		if (path == 0 || uid == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		link = new ReplayLink();
+		if (link->open(path, flags) < 0 || interpreters.find(link->uid()) != interpreters.end()) {
+			delete link;
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+		*uid = link->uid();
+
+		interpreter = new PixyInterpreter();
+		interpreter->init(link);
+		interpreter->set_uid(*uid);
+		interpreters[*uid] = interpreter;
+
+		log("pixydebug: pixy_replay_open(): uid = 0x%08X\n", *uid);
+		return 0;
+	}
+
+	int pixy_replay_is_done(uint32_t uid) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return 0;
+		}
+
+		return search->second->link_at_end() ? 1 : 0;
+	}
+
+	int pixy_block_log_start(uint32_t uid, const char * path) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		return search->second->start_block_log(path, uid);
+	}
+
+	int pixy_block_log_stop(uint32_t uid) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+
+		return search->second->stop_block_log();
+	}
+
+	int pixy_capture_start(uint32_t uid, const char * path, uint32_t frames) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end() || frames == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		return search->second->start_capture(path, uid, frames);
+	}
+
+	int pixy_capture_stop(uint32_t uid) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+
+		return search->second->stop_capture();
+	}
+
+	struct PixyBlockLog * pixy_block_log_open(const char * path) {
+		PixyBlockLog * block_log;
+
+		if (path == 0) {
+			return 0;
+		}
+
+		block_log = new PixyBlockLog();
+		if (block_log->reader.open(path) < 0) {
+			delete block_log;
+			return 0;
+		}
+
+		return block_log;
+	}
+
+	void pixy_block_log_close(struct PixyBlockLog * block_log) {
+		delete block_log;
+	}
+
+	int pixy_block_log_info(const struct PixyBlockLog * block_log, uint32_t * uid, uint64_t * first_us, uint64_t * last_us) {
+		if (block_log == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		if (uid) {
+			*uid = block_log->reader.uid();
+		}
+		if (first_us) {
+			*first_us = block_log->reader.first_us();
+		}
+		if (last_us) {
+			*last_us = block_log->reader.last_us();
+		}
+
+		return 0;
+	}
+
+	int pixy_block_log_seek(struct PixyBlockLog * block_log, uint64_t timestamp_us) {
+		if (block_log == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		block_log->reader.seek(timestamp_us);
+		return 0;
+	}
+
+	int pixy_block_log_read(struct PixyBlockLog * block_log, uint64_t * timestamp_us, uint16_t max_blocks, struct Block * blocks) {
+		if (block_log == 0 || (blocks == 0 && max_blocks != 0)) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		return block_log->reader.read(timestamp_us, max_blocks, blocks);
+	}
+
 	int pixy_get_blocks(uint32_t uid, uint16_t max_blocks, struct Block * blocks) {
 		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
 
@@ -251,6 +501,201 @@ extern "C"
 		return interpreter->get_blocks(max_blocks, blocks);
 	}
 
+	int pixy_get_blocks_soa(uint32_t uid, uint16_t max_blocks, uint16_t * signature, uint16_t * x, uint16_t * y, uint16_t * width, uint16_t * height) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		PixyInterpreter *interpreter;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+		interpreter = search->second;
+
+		return interpreter->get_blocks_soa(max_blocks, signature, x, y, width, height);
+	}
+
+	int pixy_set_block_capacity(uint32_t uid, uint16_t capacity) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		PixyInterpreter *interpreter;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+		interpreter = search->second;
+
+		return interpreter->set_block_capacity(capacity);
+	}
+
+	int pixy_query_blocks(uint32_t uid, const struct BlockQuery * query, uint8_t sort, uint16_t k, struct Block * blocks) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		PixyInterpreter *interpreter;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+		interpreter = search->second;
+
+		return interpreter->query_blocks(query, sort, k, blocks);
+	}
+
+	int pixy_get_blocks_timestamp(uint32_t uid, uint64_t * timestamp_us, uint32_t * sequence) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		PixyInterpreter *interpreter;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+		interpreter = search->second;
+
+		return interpreter->get_blocks_timestamp(timestamp_us, sequence);
+	}
+
+	int pixy_enable_tracking(uint32_t uid, int enable) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		PixyInterpreter *interpreter;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+		interpreter = search->second;
+
+		return interpreter->enable_tracking(enable != 0);
+	}
+
+	int pixy_get_tracked_blocks(uint32_t uid, uint16_t max_tracks, struct TrackedBlock * tracks) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		PixyInterpreter *interpreter;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+		interpreter = search->second;
+
+		return interpreter->get_tracked_blocks(max_tracks, tracks);
+	}
+
+	int pixy_predict_blocks(uint32_t uid, uint64_t timestamp_us, uint16_t max_tracks, struct TrackedBlock * tracks) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		PixyInterpreter *interpreter;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+		interpreter = search->second;
+
+		return interpreter->predict_blocks(timestamp_us, max_tracks, tracks);
+	}
+
+	uint64_t pixy_get_time_us() {
+		return util::timestamp_us();
+	}
+
+	void pixy_enable_stats(int enable) {
+		metrics::set_enabled(enable != 0);
+	}
+
+	void pixy_trace_enable(int enable) {
+		trace::set_enabled(enable != 0);
+	}
+
+	int pixy_trace_export(const char * path) {
+		int return_value;
+
+		if (path == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		return_value = trace::export_chrome(path);
+		return return_value < 0 ? PIXY_ERROR_INVALID_PARAMETER : return_value;
+	}
+
+	void pixy_trace_clear() {
+		trace::clear();
+	}
+
+	int pixy_get_stats(uint32_t uid, struct PixyStats * stats) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+		const metrics::Registry *registry;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+
+		if (stats == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		registry = &search->second->get_metrics();
+		metrics::collect(&registry, &registry + 1, stats);
+
+		return 0;
+	}
+
+	int pixy_get_total_stats(struct PixyStats * stats) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator it;
+		std::vector<const metrics::Registry *> registries;
+
+		if (stats == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		for (it = interpreters.begin(); it != interpreters.end(); ++it) {
+			registries.push_back(&it->second->get_metrics());
+		}
+
+		metrics::collect(registries.empty() ? 0 : &registries[0], registries.empty() ? 0 : &registries[0] + registries.size(), stats);
+
+		return 0;
+	}
+
+	int pixy_reset_stats(uint32_t uid) {
+		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
+
+		std::map<uint32_t, PixyInterpreter *>::iterator search;
+
+		search = interpreters.find(uid);
+		if (search == interpreters.end()) {
+			return -1;
+		}
+
+		search->second->reset_metrics();
+
+		return 0;
+	}
+
+	int pixy_format_stats(const struct PixyStats * stats, char * buffer, uint32_t size) {
+		if (stats == 0 || (buffer == 0 && size != 0)) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		return metrics::format(stats, buffer, size);
+	}
+
 	int pixy_blocks_are_new(uint32_t uid) {
 		boost::shared_lock_guard<boost::shared_mutex> shared_lock(pixy_map_mutex);
 
@@ -580,6 +1025,30 @@ extern "C"
 		}
 	}
 
+	int pixy_cam_set_signature(uint32_t uid, uint8_t signum, const struct Signature * signature) {
+		int  chirp_response;
+		int  return_value;
+		char name[16];
+
+		if (signum < 1 || signum > PIXY_MAX_SIGNATURE || signature == 0) {
+			return PIXY_ERROR_INVALID_PARAMETER;
+		}
+
+		// Pixy keeps each signature as a binary parameter in this layout //
+		sprintf(name, "signature%d", signum);
+
+		return_value = pixy_command(uid, "prm_set", STRING(name), UINTS8(sizeof(struct Signature), signature), END_OUT_ARGS, &chirp_response, END_IN_ARGS);
+
+		if (return_value < 0) {
+			// Error //
+			return return_value;
+		}
+		else {
+			// Success //
+			return chirp_response;
+		}
+	}
+
 	int pixy_rcs_get_position(uint32_t uid, uint8_t channel) {
 		int chirp_response;
 		int return_value;
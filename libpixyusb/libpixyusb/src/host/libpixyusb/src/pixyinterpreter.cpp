@@ -15,21 +15,104 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <algorithm>
 #include "pixyinterpreter.hpp"
 #include "debuglog.h"
+#include "utils/timer.hpp"
+
+namespace
+{
+	// Frame center used by PIXY_SORT_CENTER_DISTANCE //
+	const int32_t FRAME_CENTER_X = (PIXY_MAX_X + 1) / 2;
+	const int32_t FRAME_CENTER_Y = (PIXY_MAX_Y + 1) / 2;
+
+	// A corrupted message can carry fewer arguments than its hint expects //
+	bool has_args(const void * args[], int count)
+	{
+		int index;
+
+		for (index = 0; index < count; ++index) {
+			if (args[index] == 0) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool is_array_of(const void * length, uint8_t type)
+	{
+		return (Chirp::getType(length) & ~CRP_HINT) == type;
+	}
+
+	bool block_matches(const BlockQuery * query, const Block & block)
+	{
+		if (query == 0) {
+			return true;
+		}
+
+		if (query->type_mask && !(query->type_mask & (1 << block.type))) {
+			return false;
+		}
+
+		if (block.type == PIXY_BLOCKTYPE_COLOR_CODE) {
+			return query->color_code == 0 || query->color_code == block.signature;
+		}
+
+		return query->signature_mask == 0 || (block.signature < 16 && (query->signature_mask & (1 << block.signature)));
+	}
+
+	// Orders blocks best first for a given PIXY_SORT_* order. //
+	struct BlockRanking
+	{
+		uint8_t sort;
+
+		BlockRanking(uint8_t sort_order) : sort(sort_order) {}
+
+		static uint32_t area(const Block & block)
+		{
+			return (uint32_t)block.width * block.height;
+		}
+
+		static uint32_t center_distance(const Block & block)
+		{
+			int32_t dx = (int32_t)block.x - FRAME_CENTER_X;
+			int32_t dy = (int32_t)block.y - FRAME_CENTER_Y;
+			return dx * dx + dy * dy;
+		}
+
+		bool operator()(const Block & a, const Block & b) const
+		{
+			if (sort == PIXY_SORT_AREA) {
+				return area(a) > area(b);
+			}
+			return center_distance(a) < center_distance(b);
+		}
+	};
+}
 
 PixyInterpreter::PixyInterpreter() {
 	is_closing_ = false;
 	is_running_ = false;
+	uid_ = 0;
 	link_ = NULL;
 	receiver_ = NULL;
+	blocks_.resize(PIXY_BLOCK_CAPACITY);
+	blocks_head_ = 0;
+	blocks_count_ = 0;
+	blocks_are_new_ = false;
+	blocks_timestamp_us_ = 0;
+	blocks_sequence_ = 0;
+	tracking_enabled_ = false;
+	frame_request_us_ = 0;
+	capturing_ = false;
 }
 
 PixyInterpreter::~PixyInterpreter() {
 	log("pixydebug: PixyInterpreter::~PixyInterpreter()\n");
 }
 
-int PixyInterpreter::init(USBLink *link) {
+int PixyInterpreter::init(HostLink *link) {
 	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
 
 	int return_value;
@@ -37,9 +120,11 @@ int PixyInterpreter::init(USBLink *link) {
 	log("pixydebug: PixyInterpreter::init()\n");
 
 	link_ = link;
+	link_->setMetrics(&metrics_);
 
-	receiver_ = new ChirpReceiver(link_, this);
+	receiver_ = new ChirpReceiver(link_, this, &metrics_);
 	get_frame_proc_ = receiver_->getProc("cam_getFrame", (ProcPtr) &PixyInterpreter::frame_callback);
+	link_->start();
 
 	// Create the interpreter thread //
 
@@ -60,6 +145,9 @@ void PixyInterpreter::close() {
 		thread_.join();
 	}
 
+	stop_block_log();
+	stop_capture();
+
 	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
 
 	if (receiver_) {
@@ -77,10 +165,10 @@ void PixyInterpreter::close() {
 }
 
 int PixyInterpreter::get_blocks(int max_blocks, Block * blocks) {
-	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+	metrics::TimedLock guard(blocks_access_mutex_, metrics_.blocks_lock_wait);
 
 	uint16_t number_of_blocks_to_copy;
-	uint16_t index;
+	uint16_t first_span;
 
 	// Check parameters //
 
@@ -88,23 +176,239 @@ int PixyInterpreter::get_blocks(int max_blocks, Block * blocks) {
 		return PIXY_ERROR_INVALID_PARAMETER;
 	}
 
-	number_of_blocks_to_copy = (max_blocks >= blocks_.size() ? blocks_.size() : max_blocks);
+	number_of_blocks_to_copy = (max_blocks >= blocks_count_ ? blocks_count_ : max_blocks);
 
-	// Copy blocks //
+	// Copy blocks, oldest first. The ring may wrap, so copy in two spans. //
 
-	for (index = 0; index != number_of_blocks_to_copy; ++index) {
-		memcpy(&blocks[index], &blocks_[index], sizeof(Block));
+	first_span = blocks_.size() - blocks_head_;
+	if (first_span > number_of_blocks_to_copy) {
+		first_span = number_of_blocks_to_copy;
 	}
+	memcpy(blocks, &blocks_[blocks_head_], first_span * sizeof(Block));
+	memcpy(blocks + first_span, &blocks_[0], (number_of_blocks_to_copy - first_span) * sizeof(Block));
 
 	blocks_are_new_ = false;
 
 	return number_of_blocks_to_copy;
 }
 
-int PixyInterpreter::update_frame() {
+int PixyInterpreter::get_blocks_soa(int max_blocks, uint16_t * signature, uint16_t * x, uint16_t * y, uint16_t * width, uint16_t * height) {
+	metrics::TimedLock guard(blocks_access_mutex_, metrics_.blocks_lock_wait);
+
+	uint16_t number_of_blocks_to_copy;
+	uint16_t index;
+	uint16_t ring_index;
+	const Block * block;
+
+	// Check parameters //
+
+	if (max_blocks < 0) {
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+
+	number_of_blocks_to_copy = (max_blocks >= blocks_count_ ? blocks_count_ : max_blocks);
+
+	// Scatter each block into the per-field arrays //
+
+	for (index = 0, ring_index = blocks_head_; index != number_of_blocks_to_copy; ++index) {
+		block = &blocks_[ring_index];
+
+		if (signature) signature[index] = block->signature;
+		if (x)         x[index]         = block->x;
+		if (y)         y[index]         = block->y;
+		if (width)     width[index]     = block->width;
+		if (height)    height[index]    = block->height;
+
+		if (++ring_index == blocks_.size()) {
+			ring_index = 0;
+		}
+	}
+
+	blocks_are_new_ = false;
+
+	return number_of_blocks_to_copy;
+}
+
+int PixyInterpreter::set_block_capacity(uint16_t capacity) {
+	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+
+	std::vector<Block> blocks;
+	uint16_t           count;
+	uint16_t           index;
+
+	if (capacity == 0) {
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+
+	// Keep the newest blocks that fit in the new buffer //
+
+	count = (blocks_count_ > capacity ? capacity : blocks_count_);
+	blocks.resize(capacity);
+
+	for (index = 0; index != count; ++index) {
+		blocks[index] = blocks_[(blocks_head_ + blocks_count_ - count + index) % blocks_.size()];
+	}
+
+	blocks_.swap(blocks);
+	blocks_head_ = 0;
+	blocks_count_ = count;
+
+	return 0;
+}
+
+int PixyInterpreter::query_blocks(const BlockQuery * query, uint8_t sort, uint16_t k, Block * blocks) {
+	metrics::TimedLock guard(blocks_access_mutex_, metrics_.blocks_lock_wait);
+
+	uint16_t     index;
+	uint16_t     ring_index;
+	uint16_t     number_of_blocks;
+	BlockRanking better(sort);
+
+	// Check parameters //
+
+	if (blocks == 0 || sort > PIXY_SORT_CENTER_DISTANCE) {
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+
+	// Select blocks. For sorted queries 'blocks' is used as a heap whose //
+	// front is the worst of the best 'k' blocks seen so far.             //
+
+	number_of_blocks = 0;
+
+	for (index = 0, ring_index = blocks_head_; index != blocks_count_ && k != 0; ++index) {
+		const Block & block = blocks_[ring_index];
+
+		if (++ring_index == blocks_.size()) {
+			ring_index = 0;
+		}
+
+		if (!block_matches(query, block)) {
+			continue;
+		}
+
+		if (sort == PIXY_SORT_NONE) {
+			blocks[number_of_blocks++] = block;
+			if (number_of_blocks == k) {
+				break;
+			}
+		}
+		else if (number_of_blocks < k) {
+			blocks[number_of_blocks++] = block;
+			std::push_heap(blocks, blocks + number_of_blocks, better);
+		}
+		else if (better(block, blocks[0])) {
+			std::pop_heap(blocks, blocks + number_of_blocks, better);
+			blocks[number_of_blocks - 1] = block;
+			std::push_heap(blocks, blocks + number_of_blocks, better);
+		}
+	}
+
+	if (sort != PIXY_SORT_NONE) {
+		std::sort_heap(blocks, blocks + number_of_blocks, better);
+	}
+
+	blocks_are_new_ = false;
+
+	return number_of_blocks;
+}
+
+int PixyInterpreter::get_blocks_timestamp(uint64_t * timestamp_us, uint32_t * sequence) {
+	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+
+	if (timestamp_us) *timestamp_us = blocks_timestamp_us_;
+	if (sequence)     *sequence     = blocks_sequence_;
+
+	return 0;
+}
+
+int PixyInterpreter::enable_tracking(bool enable) {
+	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+
+	if (tracking_enabled_ && !enable) {
+		tracker_.reset();
+	}
+	tracking_enabled_ = enable;
+
+	return 0;
+}
+
+int PixyInterpreter::get_tracked_blocks(uint16_t max_tracks, TrackedBlock * tracks) {
+	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+
+	if (tracks == 0) {
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+
+	return tracker_.get_tracks(max_tracks, tracks);
+}
+
+int PixyInterpreter::predict_blocks(uint64_t timestamp_us, uint16_t max_tracks, TrackedBlock * tracks) {
+	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+
+	if (tracks == 0) {
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+
+	return tracker_.predict_tracks(timestamp_us, max_tracks, tracks);
+}
+
+const metrics::Registry & PixyInterpreter::get_metrics() const {
+	return metrics_;
+}
+
+void PixyInterpreter::set_uid(uint32_t uid) {
 	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
 
-	int return_value;
+	uid_.store(uid, boost::memory_order_relaxed);
+	if (link_) {
+		link_->setTraceUid(uid);
+	}
+}
+
+void PixyInterpreter::reset_metrics() {
+	metrics_.reset();
+}
+
+int PixyInterpreter::start_recording(const char * path, uint32_t uid) {
+	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
+
+	if (path == 0 || link_->startRecording(path, uid) < 0) {
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+
+	return 0;
+}
+
+int PixyInterpreter::start_block_log(const char * path, uint32_t uid) {
+	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+
+	if (path == 0 || block_log_.open(path, uid) < 0) {
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+
+	return 0;
+}
+
+int PixyInterpreter::stop_block_log() {
+	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
+
+	return block_log_.close();
+}
+
+void PixyInterpreter::stop_recording() {
+	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
+
+	link_->stopRecording();
+}
+
+bool PixyInterpreter::link_at_end() {
+	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
+
+	return link_->atEnd();
+}
+
+int PixyInterpreter::update_frame() {
+	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
 
 	if (!is_running_) {
 		return -201;
@@ -114,13 +418,39 @@ int PixyInterpreter::update_frame() {
 		return -202;
 	}
 
+	return request_frame();
+}
+
+int PixyInterpreter::request_frame() {
+	int return_value;
+
 	return_value = receiver_->call(ASYNC, get_frame_proc_, UINT8(0x21), UINT16(0), UINT16(0), UINT16(PIXY_FRAME_WIDTH), UINT16(PIXY_FRAME_HEIGHT), END_OUT_ARGS);
 	if (!return_value) {
 		waiting_for_frame_ = true;
+		frame_request_us_ = util::timestamp_us();
 	}
 	return return_value;
 }
 
+int PixyInterpreter::start_capture(const char * path, uint32_t uid, uint32_t frames) {
+	boost::lock_guard<boost::mutex> guard(frame_access_mutex_);
+
+	if (path == 0 || capture_.open(path, uid, frames, PIXY_FRAME_WIDTH * PIXY_FRAME_HEIGHT) < 0) {
+		capturing_ = false;
+		return PIXY_ERROR_INVALID_PARAMETER;
+	}
+	capturing_ = true;
+
+	return 0;
+}
+
+int PixyInterpreter::stop_capture() {
+	boost::lock_guard<boost::mutex> guard(frame_access_mutex_);
+
+	capturing_ = false;
+	return capture_.close();
+}
+
 void PixyInterpreter::get_frame(uint8_t *frame) {
 	boost::lock_guard<boost::mutex> guard(frame_access_mutex_);
 
@@ -149,11 +479,14 @@ int PixyInterpreter::send_command(const char * name, ...) {
 }
 
 int PixyInterpreter::send_command(const char * name, va_list args) {
+	PIXY_TRACE_BEGIN(trace::CHIRP_LOCK_WAIT, uid_.load(boost::memory_order_relaxed), 0);
 	boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
+	PIXY_TRACE_END(trace::CHIRP_LOCK_WAIT, uid_.load(boost::memory_order_relaxed), 0);
 
 	ChirpProc procedure_id;
 	int       return_value;
 	va_list   arguments;
+	uint64_t  command_start_us;
 	std::map<std::string, ChirpProc>::iterator search;
 
 	va_copy(arguments, args);
@@ -182,9 +515,18 @@ int PixyInterpreter::send_command(const char * name, va_list args) {
 	}
 
 	// Execute chirp synchronous remote procedure call //
+	command_start_us = metrics::start();
+	PIXY_TRACE_BEGIN(trace::COMMAND, uid_.load(boost::memory_order_relaxed), procedure_id);
 	return_value = receiver_->call(SYNC, procedure_id, arguments);
+	PIXY_TRACE_END(trace::COMMAND, uid_.load(boost::memory_order_relaxed), return_value);
 	va_end(arguments);
 
+	metrics_.command_rtt.stop(command_start_us);
+	metrics_.commands.add();
+	if (return_value < 0) {
+		metrics_.command_errors.add();
+	}
+
 	return return_value;
 }
 
@@ -193,8 +535,18 @@ void PixyInterpreter::interpreter_thread() {
 	// protocol until we're told to stop.            //
 	while (!is_closing_) {
 		{
+			PIXY_TRACE_BEGIN(trace::CHIRP_LOCK_WAIT, uid_.load(boost::memory_order_relaxed), 0);
 			boost::lock_guard<boost::mutex> guard(chirp_access_mutex_);
+			PIXY_TRACE_END(trace::CHIRP_LOCK_WAIT, uid_.load(boost::memory_order_relaxed), 0);
+
+			// Keep one frame request in flight while capturing //
+			if (capturing_ && (!waiting_for_frame_ || util::timestamp_us() - frame_request_us_ > PIXY_CAPTURE_TIMEOUT_US)) {
+				request_frame();
+			}
+
+			PIXY_TRACE_BEGIN(trace::CHIRP_SERVICE, uid_.load(boost::memory_order_relaxed), 0);
 			receiver_->service(false);
+			PIXY_TRACE_END(trace::CHIRP_SERVICE, uid_.load(boost::memory_order_relaxed), 0);
 		}
 		boost::this_thread::yield();
 	}
@@ -254,19 +606,30 @@ void PixyInterpreter::interpret_data(const void * chirp_data[]) {
 }
 
 void PixyInterpreter::interpret_BA81(const void * BA81_data[]) {
+	if (!has_args(BA81_data, 5) || !is_array_of(BA81_data[3], CRP_INTS8) || *static_cast<const uint32_t *>(BA81_data[3]) < PIXY_FRAME_WIDTH * PIXY_FRAME_HEIGHT) {
+		return;
+	}
+
 	boost::lock_guard<boost::mutex> guard(frame_access_mutex_);
 
 	waiting_for_frame_ = false;
 	//TODO:
 	memcpy(bayer_frame_, BA81_data[4], PIXY_FRAME_WIDTH * PIXY_FRAME_HEIGHT);
+	capture_.write(static_cast<const uint8_t *>(BA81_data[4]), PIXY_FRAME_WIDTH * PIXY_FRAME_HEIGHT, PIXY_FRAME_WIDTH, PIXY_FRAME_HEIGHT, util::timestamp_us());
 }
 
 void PixyInterpreter::interpret_CCB1(const void * CCB1_data[]) {
+	if (!has_args(CCB1_data, 5) || !is_array_of(CCB1_data[3], CRP_INTS16)) {
+		return;
+	}
+
 	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
 
 	uint32_t       number_of_blobs;
 	const BlobA *  blobs;
-	uint32_t       index;
+	uint64_t       timestamp_us;
+
+	timestamp_us = util::timestamp_us();
 
 	// Add blocks with normal signatures //
 
@@ -276,21 +639,36 @@ void PixyInterpreter::interpret_CCB1(const void * CCB1_data[]) {
 	number_of_blobs /= sizeof(BlobA) / sizeof(uint16_t);
 
 	add_normal_blocks(blobs, number_of_blobs);
+	track_frame(number_of_blobs, timestamp_us);
+	log_frame(number_of_blobs, timestamp_us);
+	record_frame(number_of_blobs, timestamp_us);
+
+	blocks_timestamp_us_ = timestamp_us;
+	++blocks_sequence_;
 	blocks_are_new_ = true;
 }
 
 
 void PixyInterpreter::interpret_CCB2(const void * CCB2_data[]) {
+	if (!has_args(CCB2_data, 7) || !is_array_of(CCB2_data[3], CRP_INTS16) || !is_array_of(CCB2_data[5], CRP_INTS16)) {
+		return;
+	}
+
+	PIXY_TRACE_BEGIN(trace::INTERPRET_CCB2, uid_.load(boost::memory_order_relaxed), 0);
 	boost::lock_guard<boost::mutex> guard(blocks_access_mutex_);
 
 	uint32_t       number_of_blobs;
 	const BlobA *  A_blobs;
 	const BlobB *  B_blobs;
-	uint32_t       index;
+	uint32_t       number_of_blocks;
+	uint64_t       timestamp_us;
+
+	timestamp_us = util::timestamp_us();
 
 	// The blocks container will only contain the newest //
 	// blocks                                            //
-	blocks_.clear();
+	blocks_head_ = 0;
+	blocks_count_ = 0;
 
 	// Add blocks with color code signatures //
 
@@ -299,6 +677,7 @@ void PixyInterpreter::interpret_CCB2(const void * CCB2_data[]) {
 
 	number_of_blobs /= sizeof(BlobB) / sizeof(uint16_t);
 	add_color_code_blocks(B_blobs, number_of_blobs);
+	number_of_blocks = number_of_blobs;
 
 	// Add blocks with normal signatures //
 
@@ -308,7 +687,15 @@ void PixyInterpreter::interpret_CCB2(const void * CCB2_data[]) {
 	number_of_blobs /= sizeof(BlobA) / sizeof(uint16_t);
 
 	add_normal_blocks(A_blobs, number_of_blobs);
+	number_of_blocks += number_of_blobs;
+	track_frame(number_of_blocks, timestamp_us);
+	log_frame(number_of_blocks, timestamp_us);
+	record_frame(number_of_blocks, timestamp_us);
+
+	blocks_timestamp_us_ = timestamp_us;
+	++blocks_sequence_;
 	blocks_are_new_ = true;
+	PIXY_TRACE_END(trace::INTERPRET_CCB2, uid_.load(boost::memory_order_relaxed), number_of_blocks);
 }
 
 void PixyInterpreter::add_normal_blocks(const BlobA * blocks, uint32_t count) {
@@ -332,15 +719,7 @@ void PixyInterpreter::add_normal_blocks(const BlobA * blocks, uint32_t count) {
 
 		// Store new block in block buffer //
 
-		if (blocks_.size() == PIXY_BLOCK_CAPACITY) {
-			// Blocks buffer is full - replace oldest received block with newest block //
-			blocks_.erase(blocks_.begin());
-			blocks_.push_back(block);
-		}
-		else {
-			// Add new block to blocks buffer //
-			blocks_.push_back(block);
-		}
+		store_block(block);
 	}
 }
 
@@ -362,16 +741,74 @@ void PixyInterpreter::add_color_code_blocks(const BlobB * blocks, uint32_t count
 
 		// Store new block in block buffer //
 
-		if (blocks_.size() == PIXY_BLOCK_CAPACITY) {
-			// Blocks buffer is full - replace oldest received block with newest block //
-			blocks_.erase(blocks_.begin());
-			blocks_.push_back(block);
+		store_block(block);
+	}
+}
+
+void PixyInterpreter::store_block(const Block & block) {
+	if (blocks_count_ == blocks_.size()) {
+		// Blocks buffer is full - replace oldest received block with newest block //
+		metrics_.blocks_dropped.add();
+		blocks_[blocks_head_] = block;
+		if (++blocks_head_ == blocks_.size()) {
+			blocks_head_ = 0;
 		}
-		else {
-			// Add new block to blocks buffer //
-			blocks_.push_back(block);
+	}
+	else {
+		// Add new block to blocks buffer //
+		blocks_[(blocks_head_ + blocks_count_) % blocks_.size()] = block;
+		++blocks_count_;
+	}
+}
+
+uint32_t PixyInterpreter::collect_frame(uint32_t count) {
+	uint16_t index;
+	uint16_t ring_index;
+
+	// Blocks beyond the buffer capacity were overwritten //
+
+	if (count > blocks_count_) {
+		count = blocks_count_;
+	}
+
+	frame_blocks_.resize(count);
+	ring_index = (blocks_head_ + blocks_count_ - count) % blocks_.size();
+
+	for (index = 0; index != count; ++index) {
+		frame_blocks_[index] = blocks_[ring_index];
+		if (++ring_index == blocks_.size()) {
+			ring_index = 0;
 		}
 	}
+
+	return count;
+}
+
+void PixyInterpreter::track_frame(uint32_t count, uint64_t timestamp_us) {
+	if (!tracking_enabled_) {
+		return;
+	}
+
+	count = collect_frame(count);
+	tracker_.update(count ? &frame_blocks_[0] : 0, count, timestamp_us);
+}
+
+void PixyInterpreter::log_frame(uint32_t count, uint64_t timestamp_us) {
+	if (!block_log_.is_open()) {
+		return;
+	}
+
+	count = collect_frame(count);
+	block_log_.write(count ? &frame_blocks_[0] : 0, count, timestamp_us);
+}
+
+void PixyInterpreter::record_frame(uint32_t count, uint64_t timestamp_us) {
+	metrics_.frames.add();
+	metrics_.blocks.add(count);
+
+	if (blocks_timestamp_us_) {
+		metrics_.frame_interval.record(timestamp_us - blocks_timestamp_us_);
+	}
 }
 
 int PixyInterpreter::blocks_are_new() {
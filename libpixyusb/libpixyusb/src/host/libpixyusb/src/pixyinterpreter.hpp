@@ -22,14 +22,21 @@
 #include <boost/thread/mutex.hpp>
 #include "pixytypes.h"
 #include "pixy.h"
-#include "usblink.h"
+#include "hostlink.h"
 #include "interpreter.hpp"
 #include "chirpreceiver.hpp"
+#include "blocktracker.hpp"
+#include "blocklog.hpp"
+#include "framearchive.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 
-#define PIXY_BLOCK_CAPACITY         250
 #define PIXY_FRAME_WIDTH            320
 #define PIXY_FRAME_HEIGHT           200
 
+// While capturing, a frame request without an answer is sent again after this //
+#define PIXY_CAPTURE_TIMEOUT_US     1000000
+
 class PixyInterpreter : public Interpreter
 {
   public:
@@ -39,7 +46,8 @@ class PixyInterpreter : public Interpreter
 
     /**
       @brief  Spawns an 'interpreter' thread which attempts to 
-              connect to Pixy using the USB interface. 
+              connect to Pixy using the USB interface, or a
+              replayed recording of it.
               On successful connection, this thread will 
               capture and store Pixy 'block' object data 
               which can be retreived using the getBlocks()
@@ -49,7 +57,7 @@ class PixyInterpreter : public Interpreter
 
     */
   
-	int init(USBLink *link);
+	int init(HostLink *link);
     
     /**
       @brief  Terminates the USB connection to Pixy and
@@ -82,6 +90,137 @@ class PixyInterpreter : public Interpreter
     */
     int get_blocks(int max_blocks, Block * blocks);
 
+    /**
+      @brief      Copies up to 'max_blocks' number of blocks into separate
+                  per-field arrays (structure of arrays).  Any array pointer
+                  may be NULL, in which case that field is skipped.
+      @param[in]  max_blocks Maximum number of blocks to copy.
+      @param[out] signature  Block signatures.
+      @param[out] x          Block center x positions.
+      @param[out] y          Block center y positions.
+      @param[out] width      Block widths.
+      @param[out] height     Block heights.
+      @return  Non-negative                  Success: Number of blocks copied
+      @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+    */
+    int get_blocks_soa(int max_blocks, uint16_t * signature, uint16_t * x, uint16_t * y, uint16_t * width, uint16_t * height);
+
+    /**
+      @brief      Sets the number of blocks held in the 'blocks_' buffer.
+                  When the buffer is full the oldest block is overwritten.
+                  The newest blocks are kept when the buffer shrinks.
+      @param[in]  capacity  Number of blocks. Must be non-zero.
+      @return  0                             Success
+      @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+    */
+    int set_block_capacity(uint16_t capacity);
+
+    /**
+      @brief      Copies the best 'k' blocks matching 'query' to 'blocks',
+                  best first, without allocating memory.
+      @param[in]  query   Filter to apply. NULL matches every block.
+      @param[in]  sort    One of the PIXY_SORT_* orders.
+      @param[in]  k       Maximum number of blocks to copy.
+      @param[out] blocks  Address of an array large enough to hold 'k' Blocks.
+      @return  Non-negative                  Success: Number of blocks copied
+      @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+    */
+    int query_blocks(const BlockQuery * query, uint8_t sort, uint16_t k, Block * blocks);
+
+    /**
+      @brief      Gets the receive time and sequence number of the latest
+                  block data.
+      @param[out] timestamp_us  Monotonic receive time in microseconds. May be NULL.
+      @param[out] sequence      Number of block messages received. May be NULL.
+      @return     0             Success
+    */
+    int get_blocks_timestamp(uint64_t * timestamp_us, uint32_t * sequence);
+
+    /**
+      @brief      Enables or disables the block tracker.
+      @param[in]  enable  Enable tracking when true.
+      @return     0       Success
+    */
+    int enable_tracking(bool enable);
+
+    /**
+      @brief      Copies up to 'max_tracks' tracked blocks to 'tracks'.
+      @return  Non-negative                  Success: Number of tracks copied
+      @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+    */
+    int get_tracked_blocks(uint16_t max_tracks, TrackedBlock * tracks);
+
+    /**
+      @brief      Copies up to 'max_tracks' tracked blocks to 'tracks',
+                  extrapolated to 'timestamp_us'.
+      @return  Non-negative                  Success: Number of tracks copied
+      @return  PIXY_ERROR_INVALID_PARAMETER  Invalid pararmeter specified
+    */
+    int predict_blocks(uint64_t timestamp_us, uint16_t max_tracks, TrackedBlock * tracks);
+
+    /**
+      @brief  Sets the uid of the trace records of this Pixy, once known.
+    */
+    void set_uid(uint32_t uid);
+
+    /**
+      @brief  Returns the metrics of this Pixy.
+    */
+    const metrics::Registry & get_metrics() const;
+
+    /**
+      @brief  Clears the metrics of this Pixy.
+    */
+    void reset_metrics();
+
+    /**
+      @brief      Writes every following USB transfer to a recording,
+                  between two Chirp messages.
+      @param[in]  uid  Pixy uid stored in the recording.
+      @return  0                             Success
+      @return  PIXY_ERROR_INVALID_PARAMETER  The file could not be created
+    */
+    int start_recording(const char * path, uint32_t uid);
+    void stop_recording();
+
+    /**
+      @brief      Writes the blocks of every following frame to a block log.
+      @param[in]  uid  Pixy uid stored in the log.
+      @return  0                             Success
+      @return  PIXY_ERROR_INVALID_PARAMETER  The file could not be created
+    */
+    int start_block_log(const char * path, uint32_t uid);
+
+    /**
+      @brief   Closes the block log, writing its index.
+      @return  0   Success, or no block log
+      @return  -1  A write failed
+    */
+    int stop_block_log();
+
+    /**
+      @brief      Captures every frame to a frame archive, requesting the
+                  next frame as soon as one arrives.
+      @param[in]  uid     Pixy uid stored in the archive.
+      @param[in]  frames  Number of frames the archive holds.
+      @return  0                             Success
+      @return  PIXY_ERROR_INVALID_PARAMETER  The archive could not be created
+    */
+    int start_capture(const char * path, uint32_t uid, uint32_t frames);
+
+    /**
+      @brief   Ends the capture, flushing the archive.
+      @return  0   Success, or no capture
+      @return  -1  The archive could not be flushed
+    */
+    int stop_capture();
+
+    /**
+      @brief  True when the link has nothing more to receive, as a
+              replay that reached the end of its recording.
+    */
+    bool link_at_end();
+
 	int update_frame();
 	void get_frame(uint8_t *frame);
 	void reset_frame_wait();
@@ -104,20 +243,33 @@ class PixyInterpreter : public Interpreter
 
   private:
 
-	USBLink *          link_;
+	HostLink *         link_;
     ChirpReceiver *    receiver_;
     boost::thread      thread_;
     volatile bool      is_closing_;
 	volatile bool      is_running_;
     std::vector<Block> blocks_;
+    uint16_t           blocks_head_;
+    uint16_t           blocks_count_;
     boost::mutex       blocks_access_mutex_;
 	boost::mutex       chirp_access_mutex_;
 	volatile bool      blocks_are_new_;
+    uint64_t           blocks_timestamp_us_;
+    uint32_t           blocks_sequence_;
+    BlockTracker       tracker_;
+    bool               tracking_enabled_;
+    std::vector<Block> frame_blocks_;
+    BlockLogWriter     block_log_;
+    metrics::Registry  metrics_;
+    boost::atomic<uint32_t> uid_;
 	ChirpProc          get_frame_proc_;
 	boost::mutex       frame_access_mutex_;
 	uint8_t            bayer_frame_[PIXY_FRAME_WIDTH * PIXY_FRAME_HEIGHT];
 	//uint8_t            color_frame_[3 * PIXY_FRAME_WIDTH * PIXY_FRAME_HEIGHT];
 	volatile bool      waiting_for_frame_;
+	uint64_t           frame_request_us_;
+	FrameArchive       capture_;
+	volatile bool      capturing_;
 	std::map<std::string, ChirpProc> proc_cache_;
 
     /**
@@ -171,6 +323,52 @@ class PixyInterpreter : public Interpreter
       @param[in] count   Size of the 'blocks' array.
     */
     void add_color_code_blocks(const BlobB * blocks, uint32_t count);
+
+    /**
+      @brief Stores a block in the 'blocks_' ring buffer, replacing the
+             oldest block when the buffer is full.
+
+      @param[in] block  Block to store.
+    */
+    void store_block(const Block & block);
+
+    /**
+      @brief Copies the newest 'count' blocks of the 'blocks_' buffer to
+             'frame_blocks_'.
+      @return Number of blocks copied, fewer when some were overwritten.
+    */
+    uint32_t collect_frame(uint32_t count);
+
+    /**
+      @brief Passes the newest 'count' blocks of the 'blocks_' buffer to
+             the block tracker as one frame.
+
+      @param[in] count         Number of blocks in the frame.
+      @param[in] timestamp_us  Time the frame was received.
+    */
+    void track_frame(uint32_t count, uint64_t timestamp_us);
+
+    /**
+      @brief Writes the newest 'count' blocks of the 'blocks_' buffer to
+             the block log, when one is open.
+
+      @param[in] count         Number of blocks in the frame.
+      @param[in] timestamp_us  Time the frame was received.
+    */
+    void log_frame(uint32_t count, uint64_t timestamp_us);
+
+    /**
+      @brief  Asks Pixy for a frame. The caller holds 'chirp_access_mutex_'.
+    */
+    int request_frame();
+
+    /**
+      @brief Updates the frame metrics for a block message.
+
+      @param[in] count         Number of blocks in the message.
+      @param[in] timestamp_us  Time the message was received.
+    */
+    void record_frame(uint32_t count, uint64_t timestamp_us);
 };
 
 #endif
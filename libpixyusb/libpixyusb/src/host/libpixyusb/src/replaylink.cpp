@@ -0,0 +1,216 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <boost/thread.hpp>
+#include "replaylink.h"
+#include "pixy.h"
+#include "debuglog.h"
+#include "libusb.h"
+
+ReplayLink::ReplayLink()
+{
+	m_blockSize = 64;
+	m_flags = LINK_FLAG_ERROR_CORRECTED;
+	uid_ = 0;
+	maxSpeed_ = false;
+	loop_ = false;
+	started_ = false;
+	ended_ = true;
+	next_ = 0;
+	pending_ = false;
+	recordData_ = 0;
+	consumed_ = 0;
+	time_us_ = 0;
+	start_us_ = 0;
+}
+
+ReplayLink::~ReplayLink()
+{
+	log("pixydebug: ReplayLink::~ReplayLink()\n");
+}
+
+int ReplayLink::open(const char *path, uint8_t flags)
+{
+	LinkRecordingHeader header;
+	FILE *file;
+	long size;
+
+	file = fopen(path, "rb");
+	if (!file)
+	{
+		log("pixydebug: ReplayLink::open(): cannot open %s\n", path);
+		return LINK_RESULT_ERROR;
+	}
+
+	if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < (long)sizeof(header) || fseek(file, 0, SEEK_SET))
+	{
+		fclose(file);
+		return LINK_RESULT_ERROR;
+	}
+
+	data_.resize(size);
+	if (fread(&data_[0], size, 1, file) != 1)
+	{
+		fclose(file);
+		data_.clear();
+		return LINK_RESULT_ERROR;
+	}
+	fclose(file);
+
+	memcpy(&header, &data_[0], sizeof(header));
+	if (header.magic != LINK_RECORDING_MAGIC || header.version != LINK_RECORDING_VERSION)
+	{
+		log("pixydebug: ReplayLink::open(): %s is not a recording\n", path);
+		data_.clear();
+		return LINK_RESULT_ERROR;
+	}
+
+	m_blockSize = header.blockSize;
+	uid_ = header.uid;
+	maxSpeed_ = (flags & PIXY_REPLAY_MAX_SPEED) != 0;
+	loop_ = (flags & PIXY_REPLAY_LOOP) != 0;
+	started_ = false;
+	ended_ = false;
+	next_ = sizeof(header);
+	pending_ = false;
+	time_us_ = 0;
+
+	return 0;
+}
+
+uint32_t ReplayLink::uid() const
+{
+	return uid_;
+}
+
+void ReplayLink::close()
+{
+	log("pixydebug: ReplayLink::close()\n");
+
+	stopRecording();
+	data_.clear();
+	pending_ = false;
+	ended_ = true;
+}
+
+void ReplayLink::start()
+{
+	started_ = true;
+	start_us_ = util::timestamp_us();
+}
+
+bool ReplayLink::atEnd()
+{
+	return ended_;
+}
+
+int ReplayLink::send(const uint8_t *data, uint32_t len, uint16_t timeoutMs)
+{
+	countTransfer(LINK_RECORD_SEND, 0, data, len);
+	return len;
+}
+
+int ReplayLink::receive(uint8_t *data, uint32_t len, uint16_t timeoutMs)
+{
+	uint64_t due_us;
+	uint32_t length;
+	int res;
+
+	if (!started_)
+		return LIBUSB_ERROR_TIMEOUT;
+
+	if (timeoutMs == 0) // 0 equals infinity
+		timeoutMs = 10;
+
+	// Past the end, time out as an idle Pixy would //
+	if (!pending_ && !nextReceive())
+	{
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(timeoutMs));
+		countTransfer(LINK_RECORD_RECEIVE, LIBUSB_ERROR_TIMEOUT, data, 0);
+		return LIBUSB_ERROR_TIMEOUT;
+	}
+
+	if (!maxSpeed_)
+	{
+		due_us = start_us_ + time_us_;
+		while (util::timestamp_us() < due_us)
+			boost::this_thread::sleep_for(boost::chrono::microseconds(due_us - util::timestamp_us()));
+	}
+
+	length = record_.length - consumed_;
+	if (length > len)
+		length = len;
+	memcpy(data, &data_[recordData_ + consumed_], length);
+	consumed_ += length;
+
+	res = (record_.result < 0 ? record_.result : (int)length);
+	if (consumed_ == record_.length || record_.result < 0)
+		pending_ = false;
+
+	countTransfer(LINK_RECORD_RECEIVE, res, data, length);
+	return res;
+}
+
+void ReplayLink::setTimer()
+{
+	timer_.reset();
+}
+
+uint32_t ReplayLink::getTimer()
+{
+	return timer_.elapsed();
+}
+
+bool ReplayLink::nextReceive()
+{
+	bool wrapped = false;
+
+	while (!ended_)
+	{
+		// A recording cut short ends at its last whole record. Records //
+		// may be unaligned, so they are copied out.                    //
+		if (next_ + sizeof(LinkRecord) <= data_.size())
+			memcpy(&record_, &data_[next_], sizeof(LinkRecord));
+		if (next_ + sizeof(LinkRecord) > data_.size() || next_ + sizeof(LinkRecord) + record_.length > data_.size())
+		{
+			// Stop rather than loop over a recording without receives //
+			if (!loop_ || wrapped)
+			{
+				ended_ = true;
+				break;
+			}
+			wrapped = true;
+			next_ = sizeof(LinkRecordingHeader);
+			time_us_ = 0;
+			start_us_ = util::timestamp_us();
+			continue;
+		}
+
+		recordData_ = next_ + sizeof(LinkRecord);
+		next_ = recordData_ + record_.length;
+		time_us_ += record_.delta_us;
+
+		if (record_.direction == LINK_RECORD_RECEIVE)
+		{
+			pending_ = true;
+			consumed_ = 0;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,77 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __REPLAYLINK_H__
+#define __REPLAYLINK_H__
+
+#include <vector>
+#include "hostlink.h"
+#include "utils/timer.hpp"
+
+/**
+  @brief  Plays back a recording made by HostLink::startRecording() as if
+          it came from Pixy. Each receive returns the next recorded receive,
+          error included, at its recorded time or as soon as asked. Sends
+          are accepted and dropped. The replay cannot answer the Chirp
+          handshake, so receives time out at once until start(): the
+          handshake fails quickly and commands are refused, but block
+          messages go through as they did from Pixy.
+*/
+class ReplayLink : public HostLink
+{
+public:
+    ReplayLink();
+    ~ReplayLink();
+
+    /**
+      @brief  Loads a whole recording in memory, so that reading it does
+              not show in the replay timing.
+      @param  flags  PIXY_REPLAY_* flags.
+      @return 0                   Success
+      @return LINK_RESULT_ERROR   Not a readable recording
+    */
+    int open(const char *path, uint8_t flags);
+    uint32_t uid() const;
+
+    virtual void close();
+    virtual void start();
+    virtual bool atEnd();
+    virtual int send(const uint8_t *data, uint32_t len, uint16_t timeoutMs);
+    virtual int receive(uint8_t *data, uint32_t len, uint16_t timeoutMs);
+    virtual void setTimer();
+    virtual uint32_t getTimer();
+
+private:
+    bool nextReceive();
+
+    std::vector<uint8_t> data_;
+    uint32_t uid_;
+    bool maxSpeed_;
+    bool loop_;
+    bool started_;
+    bool ended_;
+
+    size_t next_;               // offset of the next record in 'data_'
+    bool pending_;              // 'record_' has not been fully returned
+    LinkRecord record_;         // receive being returned
+    size_t recordData_;         // offset of its bytes in 'data_'
+    uint32_t consumed_;         // bytes of 'record_' already returned
+    uint64_t time_us_;          // of 'record_' since the recording started
+    uint64_t start_us_;         // util::timestamp_us() when the replay started
+
+    util::timer timer_;
+};
+
+#endif
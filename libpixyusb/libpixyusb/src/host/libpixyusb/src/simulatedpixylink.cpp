@@ -0,0 +1,569 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <string.h>
+#include <math.h>
+#include <deque>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include "simulatedpixylink.h"
+#include "chirp.hpp"
+#include "pixytypes.h"
+#include "debuglog.h"
+#include "libusb.h"
+
+#define SIM_FRAME_WIDTH     320
+#define SIM_FRAME_HEIGHT    200
+
+// Longest wait of the device thread, so that it notices close() //
+#define SIM_IDLE_US         10000
+
+namespace
+{
+	// Transfers in one direction between the host and the simulated Pixy //
+	class Pipe
+	{
+	public:
+		Pipe()
+		{
+			offset_ = 0;
+		}
+
+		void push(const uint8_t *data, uint32_t len)
+		{
+			boost::lock_guard<boost::mutex> guard(mutex_);
+
+			packets_.push_back(std::vector<uint8_t>(data, data + len));
+			ready_.notify_one();
+		}
+
+		// Copies up to 'len' bytes of the oldest transfer. Returns the //
+		// number of bytes, or -1 if none came before 'deadline_us'.    //
+		int pop(uint8_t *data, uint32_t len, uint64_t deadline_us)
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+			uint64_t now_us;
+
+			while (packets_.empty())
+			{
+				now_us = util::timestamp_us();
+				if (now_us >= deadline_us)
+					return -1;
+				ready_.wait_for(lock, boost::chrono::microseconds(deadline_us - now_us));
+			}
+
+			std::vector<uint8_t> &packet = packets_.front();
+
+			if (len > packet.size() - offset_)
+				len = packet.size() - offset_;
+			memcpy(data, &packet[offset_], len);
+			offset_ += len;
+
+			if (offset_ == packet.size())
+			{
+				packets_.pop_front();
+				offset_ = 0;
+			}
+
+			return len;
+		}
+
+	private:
+		boost::mutex mutex_;
+		boost::condition_variable ready_;
+		std::deque<std::vector<uint8_t> > packets_;
+		uint32_t offset_;   // bytes of the oldest transfer already read
+	};
+
+	uint32_t nextRandom(uint32_t *state)
+	{
+		// xorshift32 //
+		*state ^= *state << 13;
+		*state ^= *state >> 17;
+		*state ^= *state << 5;
+		return *state;
+	}
+
+	bool chance(uint32_t *state, float probability)
+	{
+		return nextRandom(state) < probability * 4294967296.0f;
+	}
+
+	// Device end of the link, as the firmware sees USB //
+	class DeviceLink : public Link
+	{
+	public:
+		DeviceLink(Pipe *in, Pipe *out, const PixySimulation &simulation, const uint64_t *wake_us)
+		{
+			m_blockSize = 64;
+			m_flags = LINK_FLAG_ERROR_CORRECTED;
+			in_ = in;
+			out_ = out;
+			packetLoss_ = simulation.packet_loss;
+			corruption_ = simulation.corruption;
+			random_ = simulation.seed * 2 + 1;
+			wake_us_ = wake_us;
+			faulty_ = false;
+		}
+
+		// Over USB a lost command or response fails the command, there //
+		// is no retry. Only block messages are lost or corrupted, so  //
+		// that enumeration and commands still work.                   //
+		void setFaulty(bool faulty)
+		{
+			faulty_ = faulty;
+		}
+
+		virtual int send(const uint8_t *data, uint32_t len, uint16_t timeoutMs)
+		{
+			if (faulty_ && chance(&random_, packetLoss_))
+				return len;
+
+			if (faulty_ && len && chance(&random_, corruption_))
+			{
+				std::vector<uint8_t> corrupted(data, data + len);
+				uint32_t index = nextRandom(&random_) % len;
+
+				// USB has its own CRC, so a flip stands for a firmware  //
+				// fault. It spares the type, proc and length of a       //
+				// header: the host would call whatever procedure they   //
+				// name, or wait for data that never comes.              //
+				if (index >= 4 && index < 12 && len >= 12 && *(const uint32_t *)data == CRP_START_CODE)
+					index = (len > 12 ? 12 + index % (len - 12) : 0);
+				corrupted[index] ^= 1 << (nextRandom(&random_) & 7);
+				out_->push(&corrupted[0], len);
+				return len;
+			}
+
+			out_->push(data, len);
+			return len;
+		}
+
+		// Without a timeout, waits until the next block message is due //
+		virtual int receive(uint8_t *data, uint32_t len, uint16_t timeoutMs)
+		{
+			uint64_t now_us = util::timestamp_us();
+			uint64_t deadline_us;
+			int res;
+
+			if (timeoutMs)
+				deadline_us = now_us + timeoutMs * 1000;
+			else
+				deadline_us = (*wake_us_ < now_us + SIM_IDLE_US ? *wake_us_ : now_us + SIM_IDLE_US);
+
+			res = in_->pop(data, len, deadline_us);
+			return (res < 0 ? LINK_RESULT_ERROR_RECV_TIMEOUT : res);
+		}
+
+		virtual void setTimer()
+		{
+			timer_.reset();
+		}
+
+		virtual uint32_t getTimer()
+		{
+			return timer_.elapsed();
+		}
+
+	private:
+		Pipe *in_;
+		Pipe *out_;
+		float packetLoss_;
+		float corruption_;
+		uint32_t random_;
+		const uint64_t *wake_us_;
+		bool faulty_;
+		util::timer timer_;
+	};
+}
+
+// Device side of Chirp, with the procedures of the firmware that //
+// libpixyusb calls                                               //
+class SimulatedPixy : public Chirp
+{
+public:
+	SimulatedPixy(const PixySimulation &simulation) :
+		Chirp(false, false),
+		link_(&toDevice_, &toHost_, simulation, &frameDue_us_)
+	{
+		simulation_ = simulation;
+		random_ = simulation.seed * 2 + 3;
+		frame_ = 0;
+		frameDue_us_ = util::timestamp_us();
+		frameBase_us_ = frameDue_us_;
+
+		led_ = 0;
+		ledMaxCurrent_ = 40000;
+		awb_ = 1;
+		wbv_ = 0x404040;
+		aec_ = 1;
+		ecv_ = 0x4000;
+		brightness_ = 80;
+		rcsPosition_[0] = rcsPosition_[1] = PIXY_RCS_CENTER_POS;
+		rcsFrequency_ = 50;
+		memset(signatures_, 0, sizeof(signatures_));
+
+		blobsA_.resize(simulation.blocks);
+		blobsB_.resize(simulation.color_code_blocks);
+
+		setLink(&link_);
+		setProc("getUID", (ProcPtr)getUID);
+		setProc("version", (ProcPtr)version);
+		setProc("led_set", (ProcPtr)led_set);
+		setProc("led_setMaxCurrent", (ProcPtr)led_setMaxCurrent);
+		setProc("led_getMaxCurrent", (ProcPtr)led_getMaxCurrent);
+		setProc("cam_setAWB", (ProcPtr)cam_setAWB);
+		setProc("cam_getAWB", (ProcPtr)cam_getAWB);
+		setProc("cam_setWBV", (ProcPtr)cam_setWBV);
+		setProc("cam_getWBV", (ProcPtr)cam_getWBV);
+		setProc("cam_setAEC", (ProcPtr)cam_setAEC);
+		setProc("cam_getAEC", (ProcPtr)cam_getAEC);
+		setProc("cam_setECV", (ProcPtr)cam_setECV);
+		setProc("cam_getECV", (ProcPtr)cam_getECV);
+		setProc("cam_setBrightness", (ProcPtr)cam_setBrightness);
+		setProc("cam_getBrightness", (ProcPtr)cam_getBrightness);
+		setProc("cam_getFrame", (ProcPtr)cam_getFrame);
+		setProc("rcs_setPos", (ProcPtr)rcs_setPos);
+		setProc("rcs_getPos", (ProcPtr)rcs_getPos);
+		setProc("rcs_setFreq", (ProcPtr)rcs_setFreq);
+		setProc("prm_set", (ProcPtr)prm_set);
+	}
+
+	Pipe &toHost()
+	{
+		return toHost_;
+	}
+
+	Pipe &toDevice()
+	{
+		return toDevice_;
+	}
+
+	// Answers one message from the host or waits for the next block //
+	// message, then sends the block message if it is due            //
+	void run()
+	{
+		service(false);
+
+		if (simulation_.frame_rate && util::timestamp_us() >= frameDue_us_)
+		{
+			sendBlocks();
+
+			frameBase_us_ += 1000000 / simulation_.frame_rate;
+			frameDue_us_ = frameBase_us_ + (simulation_.jitter_us ? nextRandom(&random_) % (simulation_.jitter_us + 1) : 0);
+		}
+		else if (!simulation_.frame_rate)
+			frameDue_us_ = util::timestamp_us() + SIM_IDLE_US;
+	}
+
+private:
+	static SimulatedPixy *pixy(Chirp *chirp)
+	{
+		return static_cast<SimulatedPixy *>(chirp);
+	}
+
+	// Blocks move along Lissajous curves, so that consecutive frames //
+	// look like tracked objects                                      //
+	void sendBlocks()
+	{
+		uint32_t index;
+		float    t = frame_ * 0.05f;
+
+		for (index = 0; index < blobsA_.size(); ++index)
+		{
+			uint16_t size = 8 + (index * 7) % 32;
+			uint16_t x = 20 + (uint16_t)((SIM_FRAME_WIDTH - 80) * (0.5f + 0.5f * sinf(t + index * 0.9f)));
+			uint16_t y = 20 + (uint16_t)((SIM_FRAME_HEIGHT - 80) * (0.5f + 0.5f * cosf(0.7f * t + index * 1.3f)));
+
+			blobsA_[index] = BlobA(1 + index % PIXY_MAX_SIGNATURE, x, x + size, y, y + size);
+		}
+
+		for (index = 0; index < blobsB_.size(); ++index)
+		{
+			uint16_t size = 12 + (index * 5) % 24;
+			uint16_t x = 20 + (uint16_t)((SIM_FRAME_WIDTH - 80) * (0.5f + 0.5f * cosf(t + index * 1.1f)));
+			uint16_t y = 20 + (uint16_t)((SIM_FRAME_HEIGHT - 80) * (0.5f + 0.5f * sinf(0.6f * t + index * 0.8f)));
+			int16_t  angle = (int16_t)((frame_ * 3 + index * 40) % 360) - 180;
+
+			// Color codes of two signatures, in octal as PixyMon shows them //
+			blobsB_[index] = BlobB((1 + index % PIXY_MAX_SIGNATURE) * 8 + 1 + (index + 1) % PIXY_MAX_SIGNATURE, x, x + size, y, y + size, angle);
+		}
+
+		link_.setFaulty(true);
+		assemble(0,
+			HTYPE(FOURCC('C', 'C', 'B', '2')),
+			HINT8(0),
+			HINT16(SIM_FRAME_WIDTH),
+			HINT16(SIM_FRAME_HEIGHT),
+			UINTS16(blobsA_.size() * sizeof(BlobA) / sizeof(uint16_t), blobsA_.empty() ? NULL : &blobsA_[0]),
+			UINTS16(blobsB_.size() * sizeof(BlobB) / sizeof(uint16_t), blobsB_.empty() ? NULL : &blobsB_[0]),
+			END);
+		link_.setFaulty(false);
+
+		++frame_;
+	}
+
+	static uint32_t getUID(Chirp *chirp)
+	{
+		return pixy(chirp)->simulation_.uid;
+	}
+
+	static uint32_t version(Chirp *chirp)
+	{
+		static uint16_t version[] = { 2, 0, 0 };
+
+		CRP_RETURN(chirp, UINTS16(3, version));
+		return 0;
+	}
+
+	static uint32_t led_set(const uint32_t &color, Chirp *chirp)
+	{
+		pixy(chirp)->led_ = color;
+		return 0;
+	}
+
+	static uint32_t led_setMaxCurrent(const uint32_t &current, Chirp *chirp)
+	{
+		pixy(chirp)->ledMaxCurrent_ = current;
+		return 0;
+	}
+
+	static uint32_t led_getMaxCurrent(Chirp *chirp)
+	{
+		return pixy(chirp)->ledMaxCurrent_;
+	}
+
+	static uint32_t cam_setAWB(const uint8_t &enable, Chirp *chirp)
+	{
+		pixy(chirp)->awb_ = enable;
+		return 0;
+	}
+
+	static uint32_t cam_getAWB(Chirp *chirp)
+	{
+		return pixy(chirp)->awb_;
+	}
+
+	static uint32_t cam_setWBV(const uint32_t &wbv, Chirp *chirp)
+	{
+		pixy(chirp)->wbv_ = wbv;
+		return 0;
+	}
+
+	static uint32_t cam_getWBV(Chirp *chirp)
+	{
+		return pixy(chirp)->wbv_;
+	}
+
+	static uint32_t cam_setAEC(const uint8_t &enable, Chirp *chirp)
+	{
+		pixy(chirp)->aec_ = enable;
+		return 0;
+	}
+
+	static uint32_t cam_getAEC(Chirp *chirp)
+	{
+		return pixy(chirp)->aec_;
+	}
+
+	static uint32_t cam_setECV(const uint32_t &ecv, Chirp *chirp)
+	{
+		pixy(chirp)->ecv_ = ecv;
+		return 0;
+	}
+
+	static uint32_t cam_getECV(Chirp *chirp)
+	{
+		return pixy(chirp)->ecv_;
+	}
+
+	static uint32_t cam_setBrightness(const uint8_t &brightness, Chirp *chirp)
+	{
+		pixy(chirp)->brightness_ = brightness;
+		return 0;
+	}
+
+	static uint32_t cam_getBrightness(Chirp *chirp)
+	{
+		return pixy(chirp)->brightness_;
+	}
+
+	// BGGR frame of diagonal stripes that move with each frame //
+	static uint32_t cam_getFrame(const uint8_t &mode, const uint16_t &xOffset, const uint16_t &yOffset, const uint16_t &width, const uint16_t &height, Chirp *chirp)
+	{
+		SimulatedPixy *self = pixy(chirp);
+		uint32_t x;
+		uint32_t y;
+
+		if (width == 0 || height == 0 || xOffset + width > SIM_FRAME_WIDTH || yOffset + height > SIM_FRAME_HEIGHT)
+			return -1;
+
+		self->pixels_.resize(width * height);
+		for (y = 0; y < height; ++y)
+			for (x = 0; x < width; ++x)
+				self->pixels_[y * width + x] = (uint8_t)((xOffset + x + yOffset + y + self->frame_) * 4);
+
+		CRP_RETURN(chirp, HTYPE(FOURCC('B', 'A', '8', '1')), HINT8(0), HINT16(width), HINT16(height), UINTS8(width * height, &self->pixels_[0]));
+		return 0;
+	}
+
+	static uint32_t rcs_setPos(const uint8_t &channel, const uint16_t &position, Chirp *chirp)
+	{
+		if (channel > 1 || position > PIXY_RCS_MAX_POS)
+			return -1;
+
+		pixy(chirp)->rcsPosition_[channel] = position;
+		return 0;
+	}
+
+	static uint32_t rcs_getPos(const uint8_t &channel, Chirp *chirp)
+	{
+		if (channel > 1)
+			return -1;
+
+		return pixy(chirp)->rcsPosition_[channel];
+	}
+
+	static uint32_t rcs_setFreq(const uint16_t &frequency, Chirp *chirp)
+	{
+		if (frequency < 20 || frequency > 300)
+			return -1;
+
+		pixy(chirp)->rcsFrequency_ = frequency;
+		return 0;
+	}
+
+	// Only the "signature1" to "signature7" parameters are kept //
+	static uint32_t prm_set(const char *name, const uint32_t &len, const uint8_t *data, Chirp *chirp)
+	{
+		uint32_t signum;
+
+		if (strncmp(name, "signature", 9) || name[9] < '1' || name[9] > '0' + PIXY_MAX_SIGNATURE || name[10])
+			return -1;
+
+		signum = name[9] - '1';
+		memcpy(&pixy(chirp)->signatures_[signum], data, len < sizeof(Signature) ? len : sizeof(Signature));
+		return 0;
+	}
+
+	Pipe toHost_;
+	Pipe toDevice_;
+	DeviceLink link_;
+	PixySimulation simulation_;
+	uint32_t random_;
+
+	uint32_t frame_;
+	uint64_t frameDue_us_;      // next block message, with jitter
+	uint64_t frameBase_us_;     // same, without jitter
+	std::vector<BlobA> blobsA_;
+	std::vector<BlobB> blobsB_;
+	std::vector<uint8_t> pixels_;
+
+	uint32_t led_;
+	uint32_t ledMaxCurrent_;
+	uint8_t awb_;
+	uint32_t wbv_;
+	uint8_t aec_;
+	uint32_t ecv_;
+	uint8_t brightness_;
+	uint16_t rcsPosition_[2];
+	uint16_t rcsFrequency_;
+	Signature signatures_[PIXY_MAX_SIGNATURE];
+};
+
+SimulatedPixyLink::SimulatedPixyLink()
+{
+	m_blockSize = 64;
+	m_flags = LINK_FLAG_ERROR_CORRECTED;
+	pixy_ = NULL;
+	closing_ = false;
+}
+
+SimulatedPixyLink::~SimulatedPixyLink()
+{
+	log("pixydebug: SimulatedPixyLink::~SimulatedPixyLink()\n");
+	close();
+}
+
+int SimulatedPixyLink::open(const PixySimulation &simulation)
+{
+	pixy_ = new SimulatedPixy(simulation);
+	closing_ = false;
+
+	try
+	{
+		thread_ = boost::thread(&SimulatedPixyLink::deviceThread, this);
+	}
+	catch (boost::thread_resource_error &)
+	{
+		delete pixy_;
+		pixy_ = NULL;
+		return LINK_RESULT_ERROR;
+	}
+
+	return 0;
+}
+
+void SimulatedPixyLink::close()
+{
+	log("pixydebug: SimulatedPixyLink::close()\n");
+
+	if (thread_.joinable())
+	{
+		closing_ = true;
+		thread_.join();
+	}
+
+	delete pixy_;
+	pixy_ = NULL;
+}
+
+int SimulatedPixyLink::send(const uint8_t *data, uint32_t len, uint16_t timeoutMs)
+{
+	pixy_->toDevice().push(data, len);
+	countTransfer(LINK_RECORD_SEND, 0, data, len);
+	return len;
+}
+
+int SimulatedPixyLink::receive(uint8_t *data, uint32_t len, uint16_t timeoutMs)
+{
+	int res;
+
+	if (timeoutMs == 0) // 0 equals infinity
+		timeoutMs = 10;
+
+	res = pixy_->toHost().pop(data, len, util::timestamp_us() + timeoutMs * 1000);
+	if (res < 0)
+		res = LIBUSB_ERROR_TIMEOUT;
+
+	countTransfer(LINK_RECORD_RECEIVE, res, data, res);
+	return res;
+}
+
+void SimulatedPixyLink::setTimer()
+{
+	timer_.reset();
+}
+
+uint32_t SimulatedPixyLink::getTimer()
+{
+	return timer_.elapsed();
+}
+
+void SimulatedPixyLink::deviceThread()
+{
+	while (!closing_)
+		pixy_->run();
+}
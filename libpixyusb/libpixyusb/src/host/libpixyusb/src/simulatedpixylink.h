@@ -0,0 +1,63 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __SIMULATEDPIXYLINK_H__
+#define __SIMULATEDPIXYLINK_H__
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include "hostlink.h"
+#include "pixy.h"
+#include "utils/timer.hpp"
+
+class SimulatedPixy;
+
+/**
+  @brief  Link to a Pixy simulated in-process. A thread runs the device
+          side of Chirp: it answers commands such as getUID, led_set or
+          cam_getFrame, and sends CCB2 block messages at the configured
+          rate. Transfers of block messages can be lost or corrupted at
+          random, to exercise the resync paths.
+*/
+class SimulatedPixyLink : public HostLink
+{
+public:
+    SimulatedPixyLink();
+    ~SimulatedPixyLink();
+
+    /**
+      @brief  Starts the simulated Pixy.
+      @return 0                   Success
+      @return LINK_RESULT_ERROR   The device thread could not be started
+    */
+    int open(const PixySimulation &simulation);
+
+    virtual void close();
+    virtual int send(const uint8_t *data, uint32_t len, uint16_t timeoutMs);
+    virtual int receive(uint8_t *data, uint32_t len, uint16_t timeoutMs);
+    virtual void setTimer();
+    virtual uint32_t getTimer();
+
+private:
+    void deviceThread();
+
+    SimulatedPixy *pixy_;
+    boost::thread thread_;
+    boost::atomic<bool> closing_;
+
+    util::timer timer_;
+};
+
+#endif
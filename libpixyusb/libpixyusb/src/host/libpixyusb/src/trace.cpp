@@ -0,0 +1,299 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <stdio.h>
+#include <set>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include "trace.hpp"
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+// Reading the monotonic clock takes most of the budget of a trace point, //
+// so x86 records the time stamp counter, converted at export.           //
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define TRACE_TSC
+#endif
+
+namespace
+{
+	// Single writer ring of one thread. 'head' counts every record ever //
+	// written; the writer publishes a record by releasing the new head.  //
+	struct Ring
+	{
+		boost::atomic<uint64_t> head;
+		boost::atomic<bool>     in_use;
+		uint32_t                thread;
+		trace::Record           records[TRACE_RING_RECORDS];
+	};
+
+	const char * const event_names[trace::EVENT_COUNT] = {
+		"usb_send",
+		"usb_receive",
+		"chirp_lock_wait",
+		"chirp_service",
+		"command",
+		"interpret_CCB2"
+	};
+
+	boost::atomic<bool> trace_enabled(false);
+
+	// Ticks and clock when tracing was first enabled //
+	boost::mutex        origin_mutex;
+	uint64_t            origin_ticks = 0;
+	uint64_t            origin_ns = 0;
+
+	// Rings are never freed, as threads may trace while the process  //
+	// exits: the ring of a thread that has exited goes back to the    //
+	// pool for the next new thread, records included.                 //
+	boost::mutex          rings_mutex;
+	std::vector<Ring *> & rings = *new std::vector<Ring *>;
+
+	// The thread local pointer is the fast path, the thread_specific_ptr //
+	// only returns the ring to the pool when its thread exits.           //
+	TRACE_THREAD_LOCAL Ring * thread_ring = 0;
+
+	void release_ring(Ring * ring) {
+		thread_ring = 0;
+		ring->in_use.store(false, boost::memory_order_release);
+	}
+
+	boost::thread_specific_ptr<Ring> ring_owner(release_ring);
+
+	Ring * acquire_ring() {
+		boost::lock_guard<boost::mutex> guard(rings_mutex);
+
+		Ring *   ring;
+		uint32_t index;
+
+		ring = 0;
+		for (index = 0; index < rings.size(); ++index) {
+			if (!rings[index]->in_use.load(boost::memory_order_acquire)) {
+				ring = rings[index];
+				break;
+			}
+		}
+
+		if (ring == 0) {
+			ring = new Ring;
+			ring->head.store(0, boost::memory_order_relaxed);
+			ring->thread = rings.size() + 1;
+			rings.push_back(ring);
+		}
+
+		ring->in_use.store(true, boost::memory_order_relaxed);
+		ring_owner.reset(ring);
+		thread_ring = ring;
+
+		return ring;
+	}
+
+	uint64_t timestamp_ns() {
+		using namespace boost::chrono;
+		return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	uint64_t ticks() {
+#ifdef TRACE_TSC
+		return __rdtsc();
+#else
+		return timestamp_ns();
+#endif
+	}
+
+	/**
+	  @brief  Copies the records of 'ring' still held once the copy is done.
+	*/
+	void snapshot(const Ring * ring, std::vector<trace::Record> & records) {
+		uint64_t head;
+		uint64_t first;
+		uint64_t index;
+
+		head = ring->head.load(boost::memory_order_acquire);
+		first = head > TRACE_RING_RECORDS ? head - TRACE_RING_RECORDS : 0;
+
+		records.clear();
+		for (index = first; index < head; ++index) {
+			records.push_back(ring->records[index & (TRACE_RING_RECORDS - 1)]);
+		}
+
+		// The writer may have overwritten the oldest records meanwhile, //
+		// and be writing the one after the new head.                    //
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		head = ring->head.load(boost::memory_order_relaxed);
+		if (head >= TRACE_RING_RECORDS && head - TRACE_RING_RECORDS + 1 > first) {
+			index = head - TRACE_RING_RECORDS + 1 - first;
+			records.erase(records.begin(), records.begin() + (index < records.size() ? index : records.size()));
+		}
+	}
+}
+
+bool trace::enabled() {
+	return trace_enabled.load(boost::memory_order_relaxed);
+}
+
+void trace::set_enabled(bool enable) {
+	if (enable) {
+		boost::lock_guard<boost::mutex> guard(origin_mutex);
+
+		if (origin_ns == 0) {
+			origin_ticks = ticks();
+			origin_ns = timestamp_ns();
+		}
+	}
+	trace_enabled.store(enable, boost::memory_order_relaxed);
+}
+
+void trace::record(Phase phase, Event event, uint32_t uid, int32_t arg) {
+	if (!enabled()) {
+		return;
+	}
+
+	Ring *   ring;
+	Record * record;
+	uint64_t head;
+
+	ring = thread_ring;
+	if (ring == 0) {
+		ring = acquire_ring();
+	}
+
+	head = ring->head.load(boost::memory_order_relaxed);
+	record = &ring->records[head & (TRACE_RING_RECORDS - 1)];
+	record->ticks = ticks();
+	record->uid = uid;
+	record->arg = arg;
+	record->event = event;
+	record->phase = phase;
+	ring->head.store(head + 1, boost::memory_order_release);
+}
+
+const char * trace::event_name(Event event) {
+	return event < EVENT_COUNT ? event_names[event] : "unknown";
+}
+
+int trace::export_chrome(const char * path) {
+	std::vector<Ring *>          all_rings;
+	std::vector<Record>          records;
+	std::set<uint32_t>           uids;
+	std::set<uint32_t>::iterator uid;
+	FILE *                       file;
+	const Ring *                 ring;
+	const Record *               record;
+	const char *                 separator;
+	uint32_t                     ring_index;
+	uint32_t                     index;
+	uint32_t                     depth;
+	uint64_t                     time_ns;
+	uint64_t                     now_ticks;
+	uint64_t                     now_ns;
+	uint64_t                     start_ticks;
+	uint64_t                     start_ns;
+	double                       ns_per_tick;
+	int                          count;
+
+	if (path == 0 || (file = fopen(path, "w")) == 0) {
+		return -1;
+	}
+
+	{
+		boost::lock_guard<boost::mutex> guard(origin_mutex);
+		start_ticks = origin_ticks;
+		start_ns = origin_ns;
+	}
+
+	now_ticks = ticks();
+	now_ns = timestamp_ns();
+	ns_per_tick = 1.0;
+	if (start_ns != 0 && now_ticks > start_ticks && now_ns > start_ns) {
+		ns_per_tick = (double) (now_ns - start_ns) / (now_ticks - start_ticks);
+	}
+
+	{
+		boost::lock_guard<boost::mutex> guard(rings_mutex);
+		all_rings = rings;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	separator = "\n";
+	count = 0;
+
+	for (ring_index = 0; ring_index < all_rings.size(); ++ring_index) {
+		ring = all_rings[ring_index];
+		snapshot(ring, records);
+
+		// Ends whose begin was overwritten would close nothing //
+		depth = 0;
+		for (index = 0; index < records.size(); ++index) {
+			record = &records[index];
+			if (record->phase == PHASE_END) {
+				if (depth == 0) {
+					continue;
+				}
+				--depth;
+			} else if (record->phase == PHASE_BEGIN) {
+				++depth;
+			}
+
+			if (record->ticks >= start_ticks) {
+				time_ns = start_ns + (uint64_t) ((record->ticks - start_ticks) * ns_per_tick);
+			} else {
+				time_ns = start_ns - (uint64_t) ((start_ticks - record->ticks) * ns_per_tick);
+			}
+
+			fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"libpixyusb\",\"ph\":\"%s\",\"ts\":%llu.%03u,\"pid\":%u,\"tid\":%u%s\"args\":{\"arg\":%d}}",
+			        separator, event_name((Event) record->event),
+			        record->phase == PHASE_BEGIN ? "B" : record->phase == PHASE_END ? "E" : "i",
+			        (unsigned long long) (time_ns / 1000), (unsigned) (time_ns % 1000),
+			        record->uid, ring->thread,
+			        record->phase == PHASE_INSTANT ? ",\"s\":\"t\"," : ",",
+			        record->arg);
+			separator = ",\n";
+			uids.insert(record->uid);
+			++count;
+		}
+	}
+
+	for (uid = uids.begin(); uid != uids.end(); ++uid) {
+		fprintf(file, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"Pixy 0x%08X\"}}", separator, *uid, *uid);
+		separator = ",\n";
+	}
+
+	fprintf(file, "\n]}\n");
+	if (fclose(file) != 0) {
+		return -1;
+	}
+
+	return count;
+}
+
+void trace::clear() {
+	boost::lock_guard<boost::mutex> guard(rings_mutex);
+
+	uint32_t index;
+
+	for (index = 0; index < rings.size(); ++index) {
+		rings[index]->head.store(0, boost::memory_order_release);
+	}
+}
@@ -0,0 +1,99 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <stdint.h>
+
+// Records kept per thread, the oldest are overwritten. Must be a power of two. //
+#define TRACE_RING_RECORDS  8192
+
+// Trace points. Built with PIXY_TRACE defined they record while tracing is //
+// enabled, else they compile to nothing.                                   //
+#ifdef PIXY_TRACE
+#define PIXY_TRACE_BEGIN(event, uid, arg)    trace::record(trace::PHASE_BEGIN, (event), (uid), (arg))
+#define PIXY_TRACE_END(event, uid, arg)      trace::record(trace::PHASE_END, (event), (uid), (arg))
+#define PIXY_TRACE_INSTANT(event, uid, arg)  trace::record(trace::PHASE_INSTANT, (event), (uid), (arg))
+#else
+#define PIXY_TRACE_BEGIN(event, uid, arg)
+#define PIXY_TRACE_END(event, uid, arg)
+#define PIXY_TRACE_INSTANT(event, uid, arg)
+#endif
+
+namespace trace
+{
+  enum Event
+  {
+    USB_SEND,           // arg: length, then transferred or libusb error
+    USB_RECEIVE,        // arg: length, then transferred or libusb error
+    CHIRP_LOCK_WAIT,    // waiting for the Chirp of a Pixy
+    CHIRP_SERVICE,      // interpreter thread servicing the Chirp
+    COMMAND,            // arg: procedure, then result
+    INTERPRET_CCB2,     // arg: blocks interpreted
+    EVENT_COUNT
+  };
+
+  enum Phase
+  {
+    PHASE_BEGIN,
+    PHASE_END,
+    PHASE_INSTANT
+  };
+
+  struct Record
+  {
+    uint64_t ticks;     // cycle counter where there is one, else ns
+    uint32_t uid;
+    int32_t  arg;
+    uint16_t event;
+    uint8_t  phase;
+  };
+
+  /**
+    @brief  Returns true when tracing is enabled. Tracing is disabled by
+            default; disabled trace points cost one relaxed load. Enabling
+            it the first time also calibrates record ticks against the
+            monotonic clock, up to the next export.
+  */
+  bool enabled();
+  void set_enabled(bool enable);
+
+  /**
+    @brief  Appends a record to the ring of the calling thread when
+            tracing is enabled. Lock-free, except for the first record
+            of a thread, which takes a ring from the shared pool.
+  */
+  void record(Phase phase, Event event, uint32_t uid, int32_t arg);
+
+  const char * event_name(Event event);
+
+  /**
+    @brief  Writes the records of every thread to 'path' in the Chrome
+            trace event format, which Perfetto and chrome://tracing open.
+            Each Pixy is a process named after its uid. Records overwritten
+            while they are copied are left out.
+    @return Number of records written, or -1 when 'path' cannot be written.
+  */
+  int export_chrome(const char * path);
+
+  /**
+    @brief  Discards every record. Must not race with trace points, as
+            when tracing is disabled and the traced calls have returned.
+  */
+  void clear();
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include "utils/timer.hpp"
 #include "debuglog.h"
 #include "chirpreceiver.hpp"
+#include "trace.hpp"
 
 USBLink::USBLink(libusb_device_handle *handle)
 {
@@ -49,14 +50,18 @@ void USBLink::close() {
 
 int USBLink::send(const uint8_t *data, uint32_t len, uint16_t timeoutMs)
 {
-	int res, transferred;
+	int res, transferred = 0;
 
 	//log("pixydebug: USBLink::send()\n");
 
 	if (timeoutMs == 0) // 0 equals infinity
 		timeoutMs = 10;
 
-	if ((res = libusb_bulk_transfer(m_handle, 0x02, (unsigned char *)data, len, &transferred, timeoutMs)) < 0)
+	PIXY_TRACE_BEGIN(trace::USB_SEND, traceUid_, len);
+	res = libusb_bulk_transfer(m_handle, 0x02, (unsigned char *)data, len, &transferred, timeoutMs);
+	PIXY_TRACE_END(trace::USB_SEND, traceUid_, res < 0 ? res : transferred);
+	countTransfer(LINK_RECORD_SEND, res, data, transferred);
+	if (res < 0)
 	{
 		//log("pixydebug: USBLink::send():     libusb_bulk_transfer(len = %d, transferred = %d, timeoutMs = %d) = %d\n", len, transferred, timeoutMs, res);
 		//log("pixydebug: USBLink::send() returned %d\n", res);
@@ -69,14 +74,18 @@ int USBLink::send(const uint8_t *data, uint32_t len, uint16_t timeoutMs)
 
 int USBLink::receive(uint8_t *data, uint32_t len, uint16_t timeoutMs)
 {
-	int res, transferred;
+	int res, transferred = 0;
 
 	//log("pixydebug: USBLink::receive()\n");
 
 	if (timeoutMs == 0) // 0 equals infinity
 		timeoutMs = 10;
 
-	if ((res = libusb_bulk_transfer(m_handle, 0x82, (unsigned char *)data, len, &transferred, timeoutMs)) < 0)
+	PIXY_TRACE_BEGIN(trace::USB_RECEIVE, traceUid_, len);
+	res = libusb_bulk_transfer(m_handle, 0x82, (unsigned char *)data, len, &transferred, timeoutMs);
+	PIXY_TRACE_END(trace::USB_RECEIVE, traceUid_, res < 0 ? res : transferred);
+	countTransfer(LINK_RECORD_RECEIVE, res, data, transferred);
+	if (res < 0)
 	{
 		//log("pixydebug: USBLink::receive():  libusb_bulk_transfer(len = %d, transferred = %d, timeoutMs = %d) = %d\n", len, transferred, timeoutMs, res);
 		return res;
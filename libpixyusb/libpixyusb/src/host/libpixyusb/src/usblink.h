@@ -16,17 +16,17 @@
 #ifndef __USBLINK_H__
 #define __USBLINK_H__
 
-#include "link.h"
+#include "hostlink.h"
 #include "utils/timer.hpp"
 #include "libusb.h"
 
-class USBLink : public Link
+class USBLink : public HostLink
 {
 public:
     USBLink(libusb_device_handle *handle);
     ~USBLink();
 
-	void close();
+    virtual void close();
     virtual int send(const uint8_t *data, uint32_t len, uint16_t timeoutMs);
     virtual int receive(uint8_t *data, uint32_t len, uint16_t timeoutMs);
     virtual void setTimer();
@@ -36,3 +36,8 @@ uint32_t util::timer::elapsed()
   mark = steady_clock::now();
   return duration_cast<milliseconds>(mark - epoch_).count();
 }
+
+uint64_t util::timestamp_us()
+{
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
@@ -35,6 +35,12 @@ namespace util
     
       boost::chrono::steady_clock::time_point epoch_;
   };
+
+  /**
+    @brief  Returns the current monotonic time in microseconds. The epoch is
+            unspecified, so only differences between timestamps are meaningful.
+  */
+  uint64_t timestamp_us();
 }
 
 #endif
@@ -0,0 +1,133 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Blob assembly on high clutter synthetic 320x200 frames, where each
+// signature color is scattered in thousands of small blobs. Reports
+// the time per frame and the heap allocations per frame once the
+// assembler pools have grown.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    20
+
+namespace
+{
+  uint64_t allocations = 0;
+}
+
+// Count every heap allocation of the process, the library's included //
+
+void * operator new(size_t size) {
+  void * memory;
+
+  ++allocations;
+  memory = malloc(size ? size : 1);
+  if (memory == 0) {
+    throw std::bad_alloc();
+  }
+
+  return memory;
+}
+
+void * operator new(size_t size, const std::nothrow_t &) throw() {
+  ++allocations;
+  return malloc(size ? size : 1);
+}
+
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t & nothrow) throw() {
+  return operator new(size, nothrow);
+}
+
+void operator delete(void * memory) throw() {
+  free(memory);
+}
+
+void operator delete(void * memory, const std::nothrow_t &) throw() {
+  free(memory);
+}
+
+void operator delete[](void * memory) throw() {
+  free(memory);
+}
+
+void operator delete[](void * memory, const std::nothrow_t &) throw() {
+  free(memory);
+}
+
+// Sized deletes would otherwise go to the library's operator delete //
+
+void operator delete(void * memory, size_t) throw() {
+  free(memory);
+}
+
+void operator delete[](void * memory, size_t) throw() {
+  free(memory);
+}
+
+int main() {
+  VisionEngine         engine;
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  uint32_t *           runs;
+  uint32_t             length;
+  uint32_t             segments;
+  uint32_t             repeat;
+  uint32_t             index;
+  uint32_t             entry;
+  uint64_t             start_ns;
+  uint64_t             warm_allocations;
+  double               frame_us;
+
+  for (index = 0; index < 3; ++index) {
+    engine.set_signature(index + 1, signature(colors[index]));
+  }
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_clutter_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+
+  // Warm up: the first pass grows the pools to the largest frame //
+
+  for (index = 0, segments = 0; index < BENCH_FRAMES; ++index) {
+    engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+    engine.get_runlengths(&runs, &length);
+    for (entry = 0; entry < length; ++entry) {
+      segments += (runs[entry] != 0);
+    }
+  }
+
+  warm_allocations = allocations;
+  start_ns = now_ns();
+  for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+    for (index = 0; index < BENCH_FRAMES; ++index) {
+      engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+    }
+  }
+  frame_us = (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+
+  printf("%ux%u clutter, %u frames, %u segments per frame\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES, segments / BENCH_FRAMES);
+  printf("%8.1f us/frame, %.1f heap allocations per frame after warm-up\n", frame_us,
+         (double)(allocations - warm_allocations) / (BENCH_REPEAT * BENCH_FRAMES));
+
+  return EXIT_SUCCESS;
+}
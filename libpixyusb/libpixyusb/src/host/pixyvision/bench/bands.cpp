@@ -0,0 +1,136 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Banded blob assembly of a single signature on synthetic 640x400
+// frames, with large rectangles and with high clutter. Reports how many
+// of the blocks of the serial assembly each band count finds, in any
+// order, then the time per frame of each.
+
+#define BENCH_WIDTH     640
+#define BENCH_HEIGHT    400
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <boost/thread.hpp>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    10
+#define BENCH_THREADS   4
+
+namespace
+{
+  const uint8_t band_counts[] = { 2, 4, 8 };
+
+  uint32_t count_found(const VisionBlock * blocks, int count, const VisionBlock * serial_blocks, int serial_count) {
+    uint32_t found;
+    int      serial_index;
+    int      index;
+
+    for (serial_index = 0, found = 0; serial_index < serial_count; ++serial_index) {
+      for (index = 0; index < count; ++index) {
+        if (memcmp(&blocks[index], &serial_blocks[serial_index], sizeof(VisionBlock)) == 0) {
+          ++found;
+          break;
+        }
+      }
+    }
+
+    return found;
+  }
+
+  double time_frames(VisionEngine & engine, const std::vector<uint8_t> & frames) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+      }
+    }
+
+    return (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+  }
+
+  void run(const char * name, const std::vector<uint8_t> & frames) {
+    VisionEngine serial_engine;
+    VisionEngine engines[sizeof(band_counts)];
+    VisionBlock  serial_blocks[PIXYVISION_MAX_BLOCKS];
+    VisionBlock  blocks[PIXYVISION_MAX_BLOCKS];
+    uint32_t     found[sizeof(band_counts)];
+    uint32_t     total;
+    uint32_t     index;
+    uint32_t     bands;
+    int          serial_count;
+    int          count;
+    double       serial_us;
+    double       us;
+
+    serial_engine.set_signature(1, signature(colors[0]));
+    for (bands = 0; bands < sizeof(band_counts); ++bands) {
+      engines[bands].set_signature(1, signature(colors[0]));
+      if (engines[bands].set_threads(BENCH_THREADS) < 0 || engines[bands].set_bands(band_counts[bands]) < 0) {
+        fprintf(stderr, "cannot start %u threads with %u bands\n", BENCH_THREADS, band_counts[bands]);
+        exit(EXIT_FAILURE);
+      }
+      found[bands] = 0;
+    }
+
+    for (index = 0, total = 0; index < BENCH_FRAMES; ++index) {
+      const uint8_t * frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+
+      serial_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+      serial_count = serial_engine.get_blocks(PIXYVISION_MAX_BLOCKS, serial_blocks);
+      total += serial_count;
+
+      for (bands = 0; bands < sizeof(band_counts); ++bands) {
+        engines[bands].process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+        count = engines[bands].get_blocks(PIXYVISION_MAX_BLOCKS, blocks);
+        found[bands] += count_found(blocks, count, serial_blocks, serial_count);
+      }
+    }
+
+    serial_us = time_frames(serial_engine, frames);
+    printf("%s\n", name);
+    printf("  serial                   %8.1f us/frame\n", serial_us);
+    for (bands = 0; bands < sizeof(band_counts); ++bands) {
+      us = time_frames(engines[bands], frames);
+      printf("  %u threads, %u bands      %8.1f us/frame  (%.2fx), %u/%u serial blocks\n", BENCH_THREADS, band_counts[bands], us,
+             serial_us / us, found[bands], total);
+    }
+  }
+}
+
+int main() {
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  uint32_t             index;
+
+  printf("%ux%u, %u frames, 1 signature, %u cores\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES, boost::thread::hardware_concurrency());
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_frame(index, &frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+  run("rectangles", frames);
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_clutter_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+  run("clutter", frames);
+
+  return EXIT_SUCCESS;
+}
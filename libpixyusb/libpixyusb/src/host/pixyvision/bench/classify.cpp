@@ -0,0 +1,258 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Per-pixel cost of the color classification on synthetic 320x200
+// frames: the integer division of the queue path, clDivide(), and the
+// row kernel with the exact and the table classifier. Also checks that
+// clDivide() matches the division for every input, and how far the
+// table classifier is from the exact one, per cell and per block.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    20
+
+namespace
+{
+  // Scalar classification of every cell of a line pair, with the //
+  // division of Blobs::runlengthAnalysis() or with clDivide().    //
+  template <bool RECIPROCAL>
+  uint32_t classify_scalar(const uint8_t * line, uint16_t width, const uint8_t * lut, const ColorLUT & clut) {
+    const RuntimeSignature * runtime_sig;
+    uint32_t                 passed;
+    uint16_t                 x;
+    int32_t                  r;
+    int32_t                  g1;
+    int32_t                  g2;
+    int32_t                  b;
+    int32_t                  u;
+    int32_t                  v;
+    int32_t                  c;
+    uint8_t                  sig;
+
+    for (x = 1, passed = 0; x < width; x += 2) {
+      r  = line[x];
+      g1 = line[x - 1];
+      g2 = line[x - width];
+      b  = line[x - width - 1];
+
+      sig = lut[((((r - g1) >> 3) & 0x3f) << 6) | (((b - g2) >> 3) & 0x3f)];
+      if (sig == 0) {
+        continue;
+      }
+
+      c = r + g1 + b;
+      if (c == 0) {
+        c = 1;
+      }
+      if (RECIPROCAL) {
+        u = clDivide(r - g1, c);
+        v = clDivide(b - g2, c);
+      }
+      else {
+        u = ((r - g1) << CL_LUT_ENTRY_SCALE) / c;
+        v = ((b - g2) << CL_LUT_ENTRY_SCALE) / c;
+      }
+
+      runtime_sig = &clut.m_runtimeSigs[sig - 1];
+      if (runtime_sig->m_uMin < u && u < runtime_sig->m_uMax && runtime_sig->m_vMin < v && v < runtime_sig->m_vMax &&
+          c >= (int32_t)clut.m_miny) {
+        ++passed;
+      }
+    }
+
+    return passed;
+  }
+
+  template <bool RECIPROCAL>
+  double time_scalar(const std::vector<uint8_t> & frames, const uint8_t * lut, const ColorLUT & clut, uint32_t * passed) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+    uint32_t y;
+
+    start_ns = now_ns();
+    for (repeat = 0, *passed = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        for (y = 1; y < BENCH_HEIGHT; y += 2) {
+          *passed += classify_scalar<RECIPROCAL>(&frames[(index * BENCH_HEIGHT + y) * BENCH_WIDTH], BENCH_WIDTH, lut, clut);
+        }
+      }
+    }
+
+    return (double)(now_ns() - start_ns) / ((double)BENCH_REPEAT * BENCH_FRAMES * (BENCH_HEIGHT / 2) * (BENCH_WIDTH / 2));
+  }
+
+  double time_kernel(const std::vector<uint8_t> & frames, RowKernel & kernel) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+    uint32_t y;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        for (y = 1; y < BENCH_HEIGHT; y += 2) {
+          kernel.classify(&frames[(index * BENCH_HEIGHT + y) * BENCH_WIDTH], BENCH_WIDTH);
+        }
+      }
+    }
+
+    return (double)(now_ns() - start_ns) / ((double)BENCH_REPEAT * BENCH_FRAMES * (BENCH_HEIGHT / 2) * (BENCH_WIDTH / 2));
+  }
+
+  uint32_t count_bits(uint32_t bits) {
+    uint32_t count;
+
+    for (count = 0; bits; bits &= bits - 1) {
+      ++count;
+    }
+
+    return count;
+  }
+
+  ColorSignature color_signature(const VisionSignature & signature) {
+    ColorSignature color_signature;
+
+    color_signature.m_uMin  = signature.u_min;
+    color_signature.m_uMax  = signature.u_max;
+    color_signature.m_uMean = signature.u_mean;
+    color_signature.m_vMin  = signature.v_min;
+    color_signature.m_vMax  = signature.v_max;
+    color_signature.m_vMean = signature.v_mean;
+    color_signature.m_rgb   = signature.rgb;
+    color_signature.m_type  = signature.type;
+
+    return color_signature;
+  }
+}
+
+int main() {
+  uint8_t              exact_lut[CL_LUT_SIZE];
+  uint8_t              table_lut[CL_LUT_SIZE];
+  ColorLUT             exact_clut(exact_lut);
+  ColorLUT             table_clut(table_lut);
+  RowKernel            exact_kernel(exact_lut, &exact_clut);
+  RowKernel            table_kernel(table_lut, &table_clut);
+  VisionEngine         exact_engine;
+  VisionEngine         table_engine;
+  VisionSignature      sig;
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  VisionBlock          exact_blocks[PIXYVISION_MAX_BLOCKS];
+  VisionBlock          table_blocks[PIXYVISION_MAX_BLOCKS];
+  uint64_t             hits;
+  uint64_t             passes;
+  uint64_t             differences;
+  uint32_t             exact_passed;
+  uint32_t             reciprocal_passed;
+  uint32_t             index;
+  uint32_t             word;
+  uint32_t             y;
+  uint32_t             total_blocks;
+  uint32_t             same_blocks;
+  int32_t              x;
+  int32_t              c;
+  int                  exact_count;
+  int                  table_count;
+  int                  block;
+  double               division_ns;
+  double               reciprocal_ns;
+  double               exact_ns;
+  double               table_ns;
+
+  // clDivide() must match the division for every cell //
+
+  for (x = -255; x <= 255; ++x) {
+    for (c = 1; c <= CL_MAX_Y; ++c) {
+      if (clDivide(x, c) != (x << CL_LUT_ENTRY_SCALE) / c) {
+        fprintf(stderr, "clDivide(%d, %d) = %d, expected %d\n", x, c, clDivide(x, c), (x << CL_LUT_ENTRY_SCALE) / c);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  for (index = 0; index < 3; ++index) {
+    sig = signature(colors[index]);
+    exact_clut.setSignature(index + 1, color_signature(sig));
+    table_clut.setSignature(index + 1, color_signature(sig));
+    exact_engine.set_signature(index + 1, sig);
+    table_engine.set_signature(index + 1, sig);
+  }
+  exact_clut.generateLUT();
+  table_clut.generateLUT();
+  table_clut.setClassifier(CL_CLASSIFIER_TABLE);
+  table_engine.set_classifier(PIXYVISION_CLASSIFIER_TABLE);
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_frame(index, &frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+
+  // Table classifier against the exact one, per cell and per block //
+
+  hits = passes = differences = 0;
+  total_blocks = same_blocks = 0;
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    const uint8_t * frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+
+    for (y = 1; y < BENCH_HEIGHT; y += 2) {
+      exact_kernel.classify(frame + y * BENCH_WIDTH, BENCH_WIDTH);
+      table_kernel.classify(frame + y * BENCH_WIDTH, BENCH_WIDTH);
+
+      for (word = 0; word < (BENCH_WIDTH / 2 + 31) / 32; ++word) {
+        hits += count_bits(exact_kernel.m_mask[word]);
+        passes += count_bits(exact_kernel.m_pass[word]);
+        differences += count_bits(exact_kernel.m_pass[word] ^ table_kernel.m_pass[word]);
+      }
+    }
+
+    exact_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    table_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    exact_count = exact_engine.get_blocks(PIXYVISION_MAX_BLOCKS, exact_blocks);
+    table_count = table_engine.get_blocks(PIXYVISION_MAX_BLOCKS, table_blocks);
+
+    total_blocks += exact_count;
+    for (block = 0; block < exact_count && block < table_count; ++block) {
+      if (memcmp(&exact_blocks[block], &table_blocks[block], sizeof(VisionBlock)) == 0) {
+        ++same_blocks;
+      }
+    }
+  }
+
+  division_ns = time_scalar<false>(frames, exact_lut, exact_clut, &exact_passed);
+  reciprocal_ns = time_scalar<true>(frames, exact_lut, exact_clut, &reciprocal_passed);
+  exact_ns = time_kernel(frames, exact_kernel);
+  table_ns = time_kernel(frames, table_kernel);
+
+  if (exact_passed != reciprocal_passed) {
+    fprintf(stderr, "clDivide() passed %u cells, the division %u\n", reciprocal_passed, exact_passed);
+    return EXIT_FAILURE;
+  }
+
+  printf("%ux%u, %u frames, %.1f%% of the cells hit the LUT, %.1f%% pass\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES,
+         100.0 * hits / (BENCH_FRAMES * (BENCH_HEIGHT / 2) * (BENCH_WIDTH / 2)),
+         100.0 * passes / (BENCH_FRAMES * (BENCH_HEIGHT / 2) * (BENCH_WIDTH / 2)));
+  printf("clDivide: exact for all inputs\n");
+  printf("table classifier: %.2f%% of the LUT hits differ, %u/%u blocks identical\n",
+         100.0 * differences / (hits ? hits : 1), same_blocks, total_blocks);
+  printf("division        %6.2f ns/cell\n", division_ns);
+  printf("clDivide        %6.2f ns/cell  (%.1fx)\n", reciprocal_ns, division_ns / reciprocal_ns);
+  printf("kernel exact    %6.2f ns/cell  (%.1fx)\n", exact_ns, division_ns / exact_ns);
+  printf("kernel table    %6.2f ns/cell  (%.1fx)\n", table_ns, division_ns / table_ns);
+
+  return EXIT_SUCCESS;
+}
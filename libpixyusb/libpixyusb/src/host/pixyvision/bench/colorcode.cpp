@@ -0,0 +1,123 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Color code grouping (Blobs::processCC()) with every pair of blobs
+// compared and with the grid index, on high clutter synthetic 640x400
+// frames where every signature is part of color codes, so adjacent cells
+// of different colors form color codes. Half of MAX_BLOBS goes to the
+// blobs, split evenly between the signatures, as the color codes are
+// stored after them, and the cells are sized to the blobs kept. Checks
+// that both give the same blocks, and that there are color codes, then
+// reports the time per frame of each. Build with a large
+// PIXYVISION_MAX_BLOBS (e.g. 4000) to see the quadratic cost.
+
+#define BENCH_WIDTH     640
+#define BENCH_HEIGHT    400
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    5
+#define BENCH_MIN_AREA  4
+
+namespace
+{
+  double time_frames(VisionEngine & engine, const std::vector<uint8_t> & frames) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+      }
+    }
+
+    return (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+  }
+}
+
+int main() {
+  VisionEngine             pair_engine;
+  VisionEngine             grid_engine;
+  std::vector<uint8_t>     frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  std::vector<VisionBlock> pair_blocks(MAX_BLOBS);
+  std::vector<VisionBlock> grid_blocks(MAX_BLOBS);
+  uint32_t                 scale;
+  uint32_t                 index;
+  uint32_t                 blocks;
+  uint32_t                 cc_blocks;
+  int                      block;
+  int                      pair_count;
+  int                      grid_count;
+  double                   pair_us;
+  double                   grid_us;
+
+  for (index = 0; index < 3; ++index) {
+    pair_engine.set_signature(index + 1, signature(colors[index]));
+    grid_engine.set_signature(index + 1, signature(colors[index]));
+  }
+  pair_engine.set_params(MAX_BLOBS / 2, MAX_BLOBS / 6, BENCH_MIN_AREA, PIXYVISION_CC_ONLY);
+  grid_engine.set_params(MAX_BLOBS / 2, MAX_BLOBS / 6, BENCH_MIN_AREA, PIXYVISION_CC_ONLY);
+  pair_engine.set_use_grid(false);
+
+  // About 8 cells per blob kept, so the largest blobs of different //
+  // colors still touch                                               //
+  for (scale = 1; (BENCH_WIDTH / 4 / scale) * (BENCH_HEIGHT / 2 / scale) > 8 * MAX_BLOBS; ++scale);
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_clutter_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], scale);
+  }
+
+  // The grid must give the blocks of the pairwise comparison, in order //
+
+  for (index = 0, blocks = cc_blocks = 0; index < BENCH_FRAMES; ++index) {
+    const uint8_t * frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+
+    pair_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    grid_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    pair_count = pair_engine.get_blocks(MAX_BLOBS, &pair_blocks[0]);
+    grid_count = grid_engine.get_blocks(MAX_BLOBS, &grid_blocks[0]);
+
+    if (pair_count != grid_count || memcmp(&pair_blocks[0], &grid_blocks[0], pair_count * sizeof(VisionBlock))) {
+      fprintf(stderr, "frame %u: the grid differs from the pairwise comparison (%d/%d blocks)\n", index, grid_count, pair_count);
+      return EXIT_FAILURE;
+    }
+    blocks += pair_count;
+    for (block = 0; block < pair_count; ++block) {
+      cc_blocks += (pair_blocks[block].type == PIXYVISION_BLOCKTYPE_COLOR_CODE);
+    }
+  }
+
+  if (cc_blocks == 0) {
+    fprintf(stderr, "no color codes in %u frames, processCC() was not tested\n", BENCH_FRAMES);
+    return EXIT_FAILURE;
+  }
+
+  printf("%ux%u clutter, %u frames, MAX_BLOBS %u, %u blocks per frame, %u color codes: identical output\n", BENCH_WIDTH, BENCH_HEIGHT,
+         BENCH_FRAMES, MAX_BLOBS, blocks / BENCH_FRAMES, cc_blocks / BENCH_FRAMES);
+
+  pair_us = time_frames(pair_engine, frames);
+  grid_us = time_frames(grid_engine, frames);
+
+  printf("pairwise   %8.1f us/frame\n", pair_us);
+  printf("grid       %8.1f us/frame  (%.2fx)\n", grid_us, pair_us / grid_us);
+
+  return EXIT_SUCCESS;
+}
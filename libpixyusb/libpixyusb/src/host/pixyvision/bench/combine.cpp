@@ -0,0 +1,104 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Blob merging and enclosure removal (Blobs::combine2(), Blobs::combine())
+// with every pair compared and with the grid index, on high clutter
+// synthetic 640x400 frames where every blob is kept. Checks that both give
+// the same blocks, then reports the time per frame of each. Build with a
+// large PIXYVISION_MAX_BLOBS (e.g. 4000) to see the quadratic cost.
+
+#define BENCH_WIDTH     640
+#define BENCH_HEIGHT    400
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    5
+#define BENCH_MIN_AREA  4
+
+namespace
+{
+  double time_frames(VisionEngine & engine, const std::vector<uint8_t> & frames) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+      }
+    }
+
+    return (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+  }
+}
+
+int main() {
+  VisionEngine             pair_engine;
+  VisionEngine             grid_engine;
+  std::vector<uint8_t>     frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  std::vector<VisionBlock> pair_blocks(MAX_BLOBS);
+  std::vector<VisionBlock> grid_blocks(MAX_BLOBS);
+  uint32_t                 index;
+  uint32_t                 blocks;
+  int                      pair_count;
+  int                      grid_count;
+  double                   pair_us;
+  double                   grid_us;
+
+  for (index = 0; index < 3; ++index) {
+    pair_engine.set_signature(index + 1, signature(colors[index]));
+    grid_engine.set_signature(index + 1, signature(colors[index]));
+  }
+  pair_engine.set_params(MAX_BLOBS, MAX_BLOBS, BENCH_MIN_AREA, PIXYVISION_CC_DISABLED);
+  grid_engine.set_params(MAX_BLOBS, MAX_BLOBS, BENCH_MIN_AREA, PIXYVISION_CC_DISABLED);
+  pair_engine.set_use_grid(false);
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_clutter_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+
+  // The grid must give the blocks of the pairwise comparison, in order //
+
+  for (index = 0, blocks = 0; index < BENCH_FRAMES; ++index) {
+    const uint8_t * frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+
+    pair_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    grid_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    pair_count = pair_engine.get_blocks(MAX_BLOBS, &pair_blocks[0]);
+    grid_count = grid_engine.get_blocks(MAX_BLOBS, &grid_blocks[0]);
+
+    if (pair_count != grid_count || memcmp(&pair_blocks[0], &grid_blocks[0], pair_count * sizeof(VisionBlock))) {
+      fprintf(stderr, "frame %u: the grid differs from the pairwise comparison (%d/%d blocks)\n", index, grid_count, pair_count);
+      return EXIT_FAILURE;
+    }
+    blocks += pair_count;
+  }
+
+  printf("%ux%u clutter, %u frames, MAX_BLOBS %u, %u blocks per frame: identical output\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES,
+         MAX_BLOBS, blocks / BENCH_FRAMES);
+
+  pair_us = time_frames(pair_engine, frames);
+  grid_us = time_frames(grid_engine, frames);
+
+  printf("pairwise   %8.1f us/frame\n", pair_us);
+  printf("grid       %8.1f us/frame  (%.2fx)\n", grid_us, pair_us / grid_us);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// LUT regeneration while a dashboard tunes the signature ranges: each
+// step changes the range or the color of one of three signatures, then
+// regenerates the whole LUT on one ColorLUT and only that signature on
+// another. Checks that the LUTs and the classifier tables are the same
+// after every step, and reports the time of each. Runs with three distinct
+// colors, then with three shades of red whose ranges overlap, so that bins
+// match several signatures.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_STEPS     200
+
+namespace
+{
+  ColorSignature color_signature(const VisionSignature & signature) {
+    ColorSignature color_signature;
+
+    color_signature.m_uMin  = signature.u_min;
+    color_signature.m_uMax  = signature.u_max;
+    color_signature.m_uMean = signature.u_mean;
+    color_signature.m_vMin  = signature.v_min;
+    color_signature.m_vMax  = signature.v_max;
+    color_signature.m_vMean = signature.v_mean;
+    color_signature.m_rgb   = signature.rgb;
+    color_signature.m_type  = signature.type;
+
+    return color_signature;
+  }
+
+  const Color overlapping_colors[] = { { 200, 40, 40 }, { 190, 55, 40 }, { 200, 40, 60 } };
+
+  struct Tuning
+  {
+    uint8_t        signum;
+    float          range;
+    bool           recolor;
+    ColorSignature signature;
+  };
+
+  // Range of 1.0 to 4.0, or every 8th step a shifted color, which may //
+  // overlap with the other signatures                                 //
+  Tuning next_tuning(uint32_t step, const Color * palette) {
+    Tuning tuning;
+    Color  color;
+
+    tuning.signum  = next_random() % 3 + 1;
+    tuning.range   = 1.0f + (next_random() % 301) / 100.0f;
+    tuning.recolor = (step % 8 == 7);
+
+    color    = palette[tuning.signum - 1];
+    color.r += next_random() % 61 - 30;
+    color.b += next_random() % 61 - 30;
+    tuning.signature = color_signature(signature(color));
+
+    return tuning;
+  }
+
+  void tune(ColorLUT & clut, const Tuning & tuning) {
+    if (tuning.recolor) {
+      clut.setSignature(tuning.signum, tuning.signature);
+    }
+    clut.setSigRange(tuning.signum, tuning.range);
+  }
+
+  // Times BENCH_STEPS steps, returns false if the LUTs differ //
+  bool run(bool table, const Color * palette, double * full_us, double * update_us) {
+    static uint8_t full_lut[CL_LUT_SIZE];
+    static uint8_t update_lut[CL_LUT_SIZE];
+    ColorLUT       full_clut(full_lut);
+    ColorLUT       update_clut(update_lut);
+    Tuning         tuning;
+    uint64_t       full_ns;
+    uint64_t       update_ns;
+    uint64_t       start_ns;
+    uint32_t       index;
+    uint32_t       step;
+
+    random_state = 12345;
+
+    for (index = 0; index < 3; ++index) {
+      full_clut.setSignature(index + 1, color_signature(signature(palette[index])));
+      update_clut.setSignature(index + 1, color_signature(signature(palette[index])));
+    }
+    full_clut.generateLUT();
+    update_clut.generateLUT();
+    if (table) {
+      full_clut.setClassifier(CL_CLASSIFIER_TABLE);
+      update_clut.setClassifier(CL_CLASSIFIER_TABLE);
+    }
+
+    for (step = 0, full_ns = update_ns = 0; step < BENCH_STEPS; ++step) {
+      tuning = next_tuning(step, palette);
+
+      start_ns = now_ns();
+      tune(full_clut, tuning);
+      full_clut.generateLUT();
+      full_ns += now_ns() - start_ns;
+
+      start_ns = now_ns();
+      tune(update_clut, tuning);
+      update_clut.updateLUT(tuning.signum);
+      update_ns += now_ns() - start_ns;
+
+      if (memcmp(full_lut, update_lut, CL_LUT_SIZE) ||
+          (table && memcmp(full_clut.m_table, update_clut.m_table, CL_TABLE_SIZE))) {
+        fprintf(stderr, "step %u: signature %u LUT differs from generateLUT()\n", step, tuning.signum);
+        return false;
+      }
+    }
+
+    *full_us = full_ns / 1000.0 / BENCH_STEPS;
+    *update_us = update_ns / 1000.0 / BENCH_STEPS;
+
+    return true;
+  }
+}
+
+int main() {
+  double full_us;
+  double update_us;
+
+  if (!run(false, colors, &full_us, &update_us)) {
+    return EXIT_FAILURE;
+  }
+  printf("%u steps, identical LUTs\n", BENCH_STEPS);
+  printf("exact classifier  generateLUT %8.1f us  updateLUT %8.1f us  (%.1fx)\n", full_us, update_us, full_us / update_us);
+
+  if (!run(true, colors, &full_us, &update_us)) {
+    return EXIT_FAILURE;
+  }
+  printf("table classifier  generateLUT %8.1f us  updateLUT %8.1f us  (%.1fx)\n", full_us, update_us, full_us / update_us);
+
+  if (!run(false, overlapping_colors, &full_us, &update_us) ||
+      !run(true, overlapping_colors, &full_us, &update_us)) {
+    return EXIT_FAILURE;
+  }
+  printf("%u steps with overlapping signatures, identical LUTs\n", BENCH_STEPS);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Parallel blob assembly on high clutter synthetic 320x200 frames with
+// three signatures: checks that every thread count gives the blocks of
+// the serial assembly, then reports the time per frame of each, and of
+// each signature alone as the target.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <boost/thread.hpp>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    20
+#define BENCH_THREADS   4
+
+namespace
+{
+  double time_frames(VisionEngine & engine, const std::vector<uint8_t> & frames) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+      }
+    }
+
+    return (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+  }
+}
+
+int main() {
+  VisionEngine         serial_engine;
+  VisionEngine         engines[BENCH_THREADS + 1];
+  VisionEngine         single_engines[3];
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  VisionBlock          serial_blocks[PIXYVISION_MAX_BLOCKS];
+  VisionBlock          blocks[PIXYVISION_MAX_BLOCKS];
+  uint32_t             index;
+  uint32_t             threads;
+  int                  serial_count;
+  int                  count;
+  double               serial_us;
+  double               single_us;
+  double               us;
+
+  for (index = 0; index < 3; ++index) {
+    serial_engine.set_signature(index + 1, signature(colors[index]));
+    single_engines[index].set_signature(index + 1, signature(colors[index]));
+    for (threads = 2; threads <= BENCH_THREADS; ++threads) {
+      engines[threads].set_signature(index + 1, signature(colors[index]));
+    }
+  }
+  for (threads = 2; threads <= BENCH_THREADS; ++threads) {
+    if (engines[threads].set_threads(threads) < 0) {
+      fprintf(stderr, "cannot start %u threads\n", threads);
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_clutter_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+
+  // Every thread count must give the serial blocks, in the same order //
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    const uint8_t * frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+
+    serial_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    serial_count = serial_engine.get_blocks(PIXYVISION_MAX_BLOCKS, serial_blocks);
+
+    for (threads = 2; threads <= BENCH_THREADS; ++threads) {
+      engines[threads].process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+      count = engines[threads].get_blocks(PIXYVISION_MAX_BLOCKS, blocks);
+
+      if (count != serial_count || memcmp(blocks, serial_blocks, count * sizeof(VisionBlock))) {
+        fprintf(stderr, "frame %u: %u threads differ from serial assembly (%d/%d blocks)\n", index, threads, count, serial_count);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  printf("%ux%u clutter, %u frames, 3 signatures, %u cores: identical output\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES,
+         boost::thread::hardware_concurrency());
+
+  for (index = 0, single_us = 0.0; index < 3; ++index) {
+    us = time_frames(single_engines[index], frames);
+    single_us = (us > single_us ? us : single_us);
+  }
+  serial_us = time_frames(serial_engine, frames);
+
+  printf("busiest signature alone  %8.1f us/frame\n", single_us);
+  printf("serial                   %8.1f us/frame\n", serial_us);
+  for (threads = 2; threads <= BENCH_THREADS; ++threads) {
+    us = time_frames(engines[threads], frames);
+    printf("%u threads                %8.1f us/frame  (%.2fx)\n", threads, us, serial_us / us);
+  }
+
+  return EXIT_SUCCESS;
+}
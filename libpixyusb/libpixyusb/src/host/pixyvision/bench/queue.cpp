@@ -0,0 +1,177 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Host Qqueue between two threads: checks that a producer thread's Qvals
+// arrive in order and reports the Qvals per second one at a time and in
+// batches. Then streams high clutter 640x400 frames, too large for the
+// queue, from a decoder thread and checks the blocks against the row
+// kernel.
+
+#define BENCH_WIDTH     640
+#define BENCH_HEIGHT    400
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <boost/thread.hpp>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_QVALS     (1 << 22)
+#define BENCH_BATCH     64
+#define BENCH_REPEAT    5
+
+namespace
+{
+  struct Transfer
+  {
+    Qqueue * queue;
+    uint32_t batch;
+  };
+
+  // Qval number 'index', which the consumer can check //
+  Qval numbered(uint32_t index) {
+    return Qval(index >> 16, index & 0xffff, 0, 1);
+  }
+
+  void produce(Transfer * transfer) {
+    Qval     qvals[BENCH_BATCH];
+    uint32_t index;
+    uint32_t count;
+
+    for (index = 0; index < BENCH_QVALS; index += count) {
+      for (count = 0; count < transfer->batch && index + count < BENCH_QVALS; ++count) {
+        qvals[count] = numbered(index + count);
+      }
+      if (transfer->batch == 1) {
+        transfer->queue->enqueue(&qvals[0]);
+      }
+      else {
+        transfer->queue->enqueue(qvals, count);
+      }
+    }
+  }
+
+  // Qvals per second, or 0 if one arrived out of order //
+  double transfer(Qqueue & queue, uint32_t batch) {
+    Transfer transfer = { &queue, batch };
+    Qval     qvals[BENCH_BATCH];
+    uint64_t start_ns;
+    uint32_t index;
+    uint32_t count;
+    uint32_t i;
+    bool     ordered;
+
+    start_ns = now_ns();
+    boost::thread producer(produce, &transfer);
+
+    for (index = 0, ordered = true; index < BENCH_QVALS; index += count) {
+      count = (batch == 1 ? queue.dequeue(&qvals[0]) : queue.dequeue(qvals, batch));
+      for (i = 0; i < count; ++i) {
+        ordered = ordered && (uint16_t)qvals[i].m_u == (index + i) >> 16 && (uint16_t)qvals[i].m_v == ((index + i) & 0xffff);
+      }
+    }
+
+    producer.join();
+    return ordered ? BENCH_QVALS / ((now_ns() - start_ns) / 1e9) : 0.0;
+  }
+
+  double time_frames(VisionEngine & engine, const std::vector<uint8_t> & frames) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+      }
+    }
+
+    return (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+  }
+}
+
+int main() {
+  Qqueue               queue;
+  VisionEngine         queue_engine;
+  VisionEngine         row_engine;
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  VisionBlock          queue_blocks[PIXYVISION_MAX_BLOCKS];
+  VisionBlock          row_blocks[PIXYVISION_MAX_BLOCKS];
+  uint32_t             index;
+  int                  queue_count;
+  int                  row_count;
+  double               single;
+  double               batched;
+
+  // Qvals between two threads //
+
+  if (queue.setBlocking(true) < 0) {
+    fprintf(stderr, "cannot make the queue blocking\n");
+    return EXIT_FAILURE;
+  }
+  single  = transfer(queue, 1);
+  batched = transfer(queue, BENCH_BATCH);
+  if (single == 0.0 || batched == 0.0) {
+    fprintf(stderr, "Qvals arrived out of order\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%u Qvals between 2 threads, %u cores: in order\n", BENCH_QVALS, boost::thread::hardware_concurrency());
+  printf("one at a time      %8.1f M Qvals/s\n", single / 1e6);
+  printf("%3u at a time      %8.1f M Qvals/s  (%.1fx)\n", BENCH_BATCH, batched / 1e6, batched / single);
+
+  // Frames streamed from a decoder thread //
+
+  for (index = 0; index < 3; ++index) {
+    queue_engine.set_signature(index + 1, signature(colors[index]));
+    row_engine.set_signature(index + 1, signature(colors[index]));
+  }
+  queue_engine.set_use_queue(true);
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_clutter_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+
+  if (queue_engine.process_frame(&frames[0], BENCH_WIDTH, BENCH_HEIGHT) != PIXYVISION_ERROR_OVERRUN) {
+    fprintf(stderr, "a %ux%u clutter frame should overrun the serial queue path\n", BENCH_WIDTH, BENCH_HEIGHT);
+    return EXIT_FAILURE;
+  }
+  if (queue_engine.set_threads(2) < 0) {
+    fprintf(stderr, "cannot start 2 threads\n");
+    return EXIT_FAILURE;
+  }
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    const uint8_t * frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+
+    queue_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    queue_count = queue_engine.get_blocks(PIXYVISION_MAX_BLOCKS, queue_blocks);
+    row_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    row_count = row_engine.get_blocks(PIXYVISION_MAX_BLOCKS, row_blocks);
+
+    if (queue_count != row_count || memcmp(queue_blocks, row_blocks, row_count * sizeof(VisionBlock))) {
+      fprintf(stderr, "frame %u: streamed queue path differs from the row kernel (%d/%d blocks)\n", index, queue_count, row_count);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("%ux%u clutter, %u frames: streamed blocks match the row kernel\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES);
+  printf("streamed queue path  %8.1f us/frame\n", time_frames(queue_engine, frames));
+  printf("row kernel           %8.1f us/frame\n", time_frames(row_engine, frames));
+
+  return EXIT_SUCCESS;
+}
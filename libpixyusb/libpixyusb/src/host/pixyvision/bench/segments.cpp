@@ -0,0 +1,105 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Compares the row kernel with the Qqueue path on synthetic 320x200
+// frames: checks that both produce the same run lengths and blocks,
+// then reports the time per frame of each.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    50
+
+namespace
+{
+  double time_frames(VisionEngine & engine, const std::vector<uint8_t> & frames) {
+    uint64_t start_ns;
+    uint32_t repeat;
+    uint32_t index;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+      }
+    }
+
+    return (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+  }
+}
+
+int main() {
+  VisionEngine         queue_engine;
+  VisionEngine         row_engine;
+  VisionSignature      sig;
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  VisionBlock          queue_blocks[PIXYVISION_MAX_BLOCKS];
+  VisionBlock          row_blocks[PIXYVISION_MAX_BLOCKS];
+  uint32_t *           queue_runs;
+  uint32_t *           row_runs;
+  uint32_t             queue_length;
+  uint32_t             row_length;
+  uint32_t             index;
+  uint32_t             runs;
+  int                  queue_count;
+  int                  row_count;
+  double               queue_us;
+  double               row_us;
+
+  for (index = 0; index < 3; ++index) {
+    sig = signature(colors[index]);
+    queue_engine.set_signature(index + 1, sig);
+    row_engine.set_signature(index + 1, sig);
+  }
+  queue_engine.set_use_queue(true);
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_frame(index, &frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+
+  // Both paths must agree on every frame //
+
+  for (index = 0, runs = 0; index < BENCH_FRAMES; ++index) {
+    const uint8_t * frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+
+    queue_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    row_engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+
+    queue_engine.get_runlengths(&queue_runs, &queue_length);
+    row_engine.get_runlengths(&row_runs, &row_length);
+    queue_count = queue_engine.get_blocks(PIXYVISION_MAX_BLOCKS, queue_blocks);
+    row_count = row_engine.get_blocks(PIXYVISION_MAX_BLOCKS, row_blocks);
+
+    if (queue_length != row_length || memcmp(queue_runs, row_runs, queue_length * sizeof(uint32_t)) ||
+        queue_count != row_count || memcmp(queue_blocks, row_blocks, queue_count * sizeof(VisionBlock))) {
+      fprintf(stderr, "frame %u: row kernel differs from queue path (%u/%u runs, %d/%d blocks)\n",
+              index, row_length, queue_length, row_count, queue_count);
+      return EXIT_FAILURE;
+    }
+    runs += queue_length;
+  }
+
+  queue_us = time_frames(queue_engine, frames);
+  row_us = time_frames(row_engine, frames);
+
+  printf("%ux%u, %u frames, %u runs per frame: identical output\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES, runs / BENCH_FRAMES);
+  printf("queue path  %8.1f us/frame\n", queue_us);
+  printf("row kernel  %8.1f us/frame  (%.1fx)\n", row_us, queue_us / row_us);
+
+  return EXIT_SUCCESS;
+}
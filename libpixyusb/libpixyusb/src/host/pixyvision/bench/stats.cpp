@@ -0,0 +1,145 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Block stats: checks the centroid and angle of a synthetic bar drawn at
+// several angles, then reports the time per frame of the rectangle and
+// clutter frames. Build once with -DPIXYVISION_STATS=OFF to compare with
+// bounding boxes only, the checks are skipped then.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+#define BENCH_REPEAT    20
+#define BENCH_ANGLES    12
+
+namespace
+{
+  // Bar of signature color 0, 'length' x 'width' pixels, centered on //
+  // (cx, cy) and turned by 'angle' radians, on a gray background      //
+  void make_bar(float cx, float cy, float angle, float length, float width, uint8_t * frame) {
+    const Color & color = colors[0];
+    uint32_t x;
+    uint32_t y;
+    float    along;
+    float    across;
+    int32_t  value;
+
+    for (y = 0; y < BENCH_HEIGHT; ++y) {
+      for (x = 0; x < BENCH_WIDTH; ++x) {
+        along  = (x - cx) * cosf(angle) + (y - cy) * sinf(angle);
+        across = (y - cy) * cosf(angle) - (x - cx) * sinf(angle);
+        if (fabsf(along) < length / 2 && fabsf(across) < width / 2) {
+          value = ((y & 1) && (x & 1)) ? color.r : (!(y & 1) && !(x & 1)) ? color.b : color.g;
+        }
+        else {
+          value = 90;
+        }
+        frame[y * BENCH_WIDTH + x] = noisy(value, 10);
+      }
+    }
+  }
+
+  double time_frames(VisionEngine & engine, const std::vector<uint8_t> & frames, bool stats) {
+    VisionBlockStats block_stats[PIXYVISION_MAX_BLOCKS];
+    uint64_t         start_ns;
+    uint32_t         repeat;
+    uint32_t         index;
+
+    start_ns = now_ns();
+    for (repeat = 0; repeat < BENCH_REPEAT; ++repeat) {
+      for (index = 0; index < BENCH_FRAMES; ++index) {
+        engine.process_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT);
+        if (stats) {
+          engine.get_block_stats(PIXYVISION_MAX_BLOCKS, block_stats);
+        }
+      }
+    }
+
+    return (now_ns() - start_ns) / 1000.0 / (BENCH_REPEAT * BENCH_FRAMES);
+  }
+}
+
+int main() {
+  VisionEngine         engine;
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  VisionBlock          block;
+  VisionBlockStats     stats;
+  uint32_t             index;
+  float                angle;
+  float                error;
+  float                worst_angle;
+  float                worst_centroid;
+  bool                 supported;
+
+  for (index = 0; index < 3; ++index) {
+    engine.set_signature(index + 1, signature(colors[index]));
+  }
+
+  // A bar turned by 'angle' has its major axis at 'angle', modulo PI. //
+  // Bayer cells are classified whole, so the centroid may be off by   //
+  // a pixel or so, as the block edges are.                            //
+
+  engine.process_frame(&frames[0], BENCH_WIDTH, BENCH_HEIGHT);
+  supported = engine.get_block_stats(1, &stats) != PIXYVISION_ERROR_UNSUPPORTED;
+
+  for (index = 0, worst_angle = 0.0f, worst_centroid = 0.0f; supported && index < BENCH_ANGLES; ++index) {
+    angle = -M_PI / 2 + M_PI * (index + 0.5f) / BENCH_ANGLES;
+    make_bar(BENCH_WIDTH / 2, BENCH_HEIGHT / 2, angle, 120, 24, &frames[0]);
+    engine.process_frame(&frames[0], BENCH_WIDTH, BENCH_HEIGHT);
+
+    if (engine.get_blocks(1, &block) != 1 || engine.get_block_stats(1, &stats) != 1) {
+      fprintf(stderr, "bar at %.2f rad: no block\n", angle);
+      return EXIT_FAILURE;
+    }
+
+    error = fabsf(stats.angle - angle);
+    error = (error > M_PI / 2 ? M_PI - error : error);
+    worst_angle = (error > worst_angle ? error : worst_angle);
+    error = hypotf(stats.x - BENCH_WIDTH / 2, stats.y - BENCH_HEIGHT / 2);
+    worst_centroid = (error > worst_centroid ? error : worst_centroid);
+
+    if (stats.major_diameter < 2 * stats.minor_diameter) {
+      fprintf(stderr, "bar at %.2f rad: diameters %.1f and %.1f\n", angle, stats.major_diameter, stats.minor_diameter);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (supported) {
+    printf("%u bars: angle within %.3f rad, centroid within %.2f pixels\n", BENCH_ANGLES, worst_angle, worst_centroid);
+    if (worst_angle > 0.05f || worst_centroid > 2.5f) {
+      fprintf(stderr, "stats are off\n");
+      return EXIT_FAILURE;
+    }
+  }
+  else {
+    printf("built without PIXYVISION_STATS, bounding boxes only\n");
+  }
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_frame(index, &frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+  printf("%ux%u rectangles %8.1f us/frame\n", BENCH_WIDTH, BENCH_HEIGHT, time_frames(engine, frames, supported));
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_clutter_frame(&frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+  printf("%ux%u clutter    %8.1f us/frame\n", BENCH_WIDTH, BENCH_HEIGHT, time_frames(engine, frames, supported));
+
+  return EXIT_SUCCESS;
+}
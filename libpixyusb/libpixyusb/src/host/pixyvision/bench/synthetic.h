@@ -0,0 +1,138 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __SYNTHETIC_H__
+#define __SYNTHETIC_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "pixyvision.h"
+
+// Synthetic BGGR frames shared by the benchmarks //
+
+#ifndef BENCH_WIDTH
+#define BENCH_WIDTH     320
+#define BENCH_HEIGHT    200
+#endif
+#define BENCH_FRAMES    32
+
+namespace
+{
+  uint32_t random_state = 12345;
+
+  inline uint32_t next_random() {
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 16) & 0x7fff;
+  }
+
+  inline uint8_t noisy(int32_t value, int32_t noise) {
+    value += (int32_t)(next_random() % (2 * noise + 1)) - noise;
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+  }
+
+  inline uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  }
+
+  struct Color
+  {
+    int32_t r;
+    int32_t g;
+    int32_t b;
+  };
+
+  const Color colors[] = { { 200, 40, 40 }, { 40, 160, 50 }, { 40, 60, 190 } };
+
+  inline VisionSignature signature(const Color & color) {
+    VisionSignature signature;
+    int32_t         y = color.r + color.g + color.b;
+
+    memset(&signature, 0, sizeof(signature));
+    signature.u_mean = ((color.r - color.g) << 15) / y;
+    signature.v_mean = ((color.b - color.g) << 15) / y;
+    signature.u_min  = signature.u_mean - 3000;
+    signature.u_max  = signature.u_mean + 3000;
+    signature.v_min  = signature.v_mean - 3000;
+    signature.v_max  = signature.v_mean + 3000;
+    signature.rgb    = (color.r << 16) | (color.g << 8) | color.b;
+
+    return signature;
+  }
+
+  // BGGR Bayer frame: gray noise with a few noisy colored rectangles //
+  inline void make_frame(uint32_t index, uint8_t * frame) {
+    uint32_t x;
+    uint32_t y;
+    uint32_t rect;
+
+    for (y = 0; y < BENCH_HEIGHT; ++y) {
+      for (x = 0; x < BENCH_WIDTH; ++x) {
+        frame[y * BENCH_WIDTH + x] = noisy(90, 30);
+      }
+    }
+
+    for (rect = 0; rect < 12; ++rect) {
+      const Color & color = colors[rect % 3];
+      uint32_t left   = (rect * 53 + index * 7) % (BENCH_WIDTH - 60);
+      uint32_t top    = (rect * 37 + index * 3) % (BENCH_HEIGHT - 40);
+      uint32_t right  = left + 10 + (rect * 13) % 50;
+      uint32_t bottom = top + 6 + (rect * 11) % 34;
+
+      for (y = top; y < bottom; ++y) {
+        for (x = left; x < right; ++x) {
+          int32_t value = ((y & 1) && (x & 1)) ? color.r : (!(y & 1) && !(x & 1)) ? color.b : color.g;
+          frame[y * BENCH_WIDTH + x] = noisy(value, 25);
+        }
+      }
+    }
+  }
+
+  // BGGR Bayer frame where every cell of 'scale' x 'scale' 4x2 pixel //
+  // cells is either gray or one of the signature colors at random, so //
+  // each color is scattered in many small blobs                        //
+  inline void make_clutter_frame(uint8_t * frame, uint32_t scale = 1) {
+    uint32_t x;
+    uint32_t y;
+    uint32_t cell_x;
+    uint32_t cell_y;
+    uint32_t pick;
+
+    for (cell_y = 0; cell_y < BENCH_HEIGHT; cell_y += 2 * scale) {
+      for (cell_x = 0; cell_x < BENCH_WIDTH; cell_x += 4 * scale) {
+        pick = next_random() % 5;
+        const Color gray = { 90, 90, 90 };
+        const Color & color = pick < 3 ? colors[pick] : gray;
+
+        for (y = cell_y; y < cell_y + 2 * scale && y < BENCH_HEIGHT; y += 2) {
+          for (x = cell_x; x < cell_x + 4 * scale && x < BENCH_WIDTH; x += 4) {
+            frame[y * BENCH_WIDTH + x]           = noisy(color.b, 15);
+            frame[y * BENCH_WIDTH + x + 1]       = noisy(color.g, 15);
+            frame[y * BENCH_WIDTH + x + 2]       = noisy(color.b, 15);
+            frame[y * BENCH_WIDTH + x + 3]       = noisy(color.g, 15);
+            frame[(y + 1) * BENCH_WIDTH + x]     = noisy(color.g, 15);
+            frame[(y + 1) * BENCH_WIDTH + x + 1] = noisy(color.r, 15);
+            frame[(y + 1) * BENCH_WIDTH + x + 2] = noisy(color.g, 15);
+            frame[(y + 1) * BENCH_WIDTH + x + 3] = noisy(color.r, 15);
+          }
+        }
+      }
+    }
+  }
+}
+
+#endif
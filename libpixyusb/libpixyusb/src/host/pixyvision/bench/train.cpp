@@ -0,0 +1,123 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+// Signature training on stored synthetic 320x200 frames: teaches the
+// red signature from a rectangle and from a seed pixel of each frame,
+// checks that every trained signature finds the rectangle it came from,
+// and reports the time to retrain on all of the frames.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "visionengine.hpp"
+#include "synthetic.h"
+
+namespace
+{
+  // The 4th rectangle of make_frame(), which has the first color //
+  struct Rect
+  {
+    uint16_t left;
+    uint16_t top;
+    uint16_t width;
+    uint16_t height;
+  };
+
+  Rect trained_rect(uint32_t index) {
+    Rect rect;
+
+    rect.left   = (3 * 53 + index * 7) % (BENCH_WIDTH - 60);
+    rect.top    = (3 * 37 + index * 3) % (BENCH_HEIGHT - 40);
+    rect.width  = 10 + (3 * 13) % 50;
+    rect.height = 6 + (3 * 11) % 34;
+
+    return rect;
+  }
+
+  // True if a block of signature 1 is centered inside 'rect' //
+  bool finds(VisionEngine & engine, const uint8_t * frame, const Rect & rect) {
+    VisionBlock blocks[PIXYVISION_MAX_BLOCKS];
+    int         count;
+    int         index;
+
+    engine.process_frame(frame, BENCH_WIDTH, BENCH_HEIGHT);
+    count = engine.get_blocks(PIXYVISION_MAX_BLOCKS, blocks);
+
+    for (index = 0; index < count; ++index) {
+      if (blocks[index].signature == 1 &&
+          blocks[index].x >= rect.left && blocks[index].x < rect.left + rect.width &&
+          blocks[index].y >= rect.top && blocks[index].y < rect.top + rect.height) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+}
+
+int main() {
+  VisionEngine         engine;
+  std::vector<uint8_t> frames(BENCH_FRAMES * BENCH_WIDTH * BENCH_HEIGHT);
+  const uint8_t *      frame;
+  Rect                 rect;
+  uint32_t             index;
+  uint64_t             start_ns;
+  double               region_ms;
+  double               seed_ms;
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    make_frame(index, &frames[index * BENCH_WIDTH * BENCH_HEIGHT]);
+  }
+
+  // Each trained signature must find its own rectangle //
+
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    frame = &frames[index * BENCH_WIDTH * BENCH_HEIGHT];
+    rect  = trained_rect(index);
+
+    if (engine.train_region(1, frame, BENCH_WIDTH, BENCH_HEIGHT, rect.left + 4, rect.top + 4, rect.width - 8, rect.height - 8, 0) < 0 ||
+        !finds(engine, frame, rect)) {
+      fprintf(stderr, "frame %u: region trained signature misses its rectangle\n", index);
+      return EXIT_FAILURE;
+    }
+    if (engine.train_seed(1, frame, BENCH_WIDTH, BENCH_HEIGHT, rect.left + rect.width / 2, rect.top + rect.height / 2, 0) < 0 ||
+        !finds(engine, frame, rect)) {
+      fprintf(stderr, "frame %u: seed trained signature misses its rectangle\n", index);
+      return EXIT_FAILURE;
+    }
+  }
+
+  start_ns = now_ns();
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    rect = trained_rect(index);
+    engine.train_region(1, &frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT,
+                        rect.left + 4, rect.top + 4, rect.width - 8, rect.height - 8, 0);
+  }
+  region_ms = (now_ns() - start_ns) / 1000000.0;
+
+  start_ns = now_ns();
+  for (index = 0; index < BENCH_FRAMES; ++index) {
+    rect = trained_rect(index);
+    engine.train_seed(1, &frames[index * BENCH_WIDTH * BENCH_HEIGHT], BENCH_WIDTH, BENCH_HEIGHT,
+                      rect.left + rect.width / 2, rect.top + rect.height / 2, 0);
+  }
+  seed_ms = (now_ns() - start_ns) / 1000000.0;
+
+  printf("%ux%u, %u frames: every trained signature finds its rectangle\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES);
+  printf("region training  %8.2f ms for all frames\n", region_ms);
+  printf("seed training    %8.2f ms for all frames\n", seed_ms);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,231 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __PIXYVISION_H__
+#define __PIXYVISION_H__
+
+#include <stdint.h>
+
+// Pixy Vision C API //
+//
+// Runs Pixy's color connected components algorithm on the host, on
+// raw Bayer frames such as the ones returned by pixy_cam_get_frame().
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  #define PIXYVISION_MAX_SIGNATURE          7
+
+  // Largest frame accepted by pixyvision_process_frame() //
+  #define PIXYVISION_MAX_WIDTH              1024
+  #define PIXYVISION_MAX_HEIGHT             1020
+
+  // Default maximum number of blocks per frame //
+  #define PIXYVISION_MAX_BLOCKS             100
+
+  // Block types
+  #define PIXYVISION_BLOCKTYPE_NORMAL       0
+  #define PIXYVISION_BLOCKTYPE_COLOR_CODE   1
+
+  // Color code modes
+  #define PIXYVISION_CC_DISABLED            0
+  #define PIXYVISION_CC_ENABLED             1
+  #define PIXYVISION_CC_ONLY                2
+  #define PIXYVISION_CC_MIXED               3
+
+  // Classifiers, see pixyvision_set_classifier()
+  #define PIXYVISION_CLASSIFIER_EXACT       0
+  #define PIXYVISION_CLASSIFIER_TABLE       1
+
+  // Error codes
+  #define PIXYVISION_ERROR_INVALID_PARAMETER  -150
+  #define PIXYVISION_ERROR_OVERRUN            -153
+  #define PIXYVISION_ERROR_THREAD             -154
+  #define PIXYVISION_ERROR_UNSUPPORTED        -155
+
+  struct PixyVision;
+
+  /**
+    @brief  Same layout as 'struct Block' in pixy.h. Coordinates are
+            in pixels of the processed frame.
+  */
+  struct VisionBlock
+  {
+    uint16_t type;
+    uint16_t signature;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    int16_t  angle;
+  };
+
+  /**
+    @brief  Shape of a block from the moments of its pixels, in the
+            coordinates of 'struct VisionBlock'. A color code block
+            combines the blobs of its colors.
+  */
+  struct VisionBlockStats
+  {
+    uint32_t area;            // pixels
+    float    x;               // centroid
+    float    y;
+    float    angle;           // of the major axis, -PI/2 to PI/2 radians,
+                              // 0 points right and PI/2 down
+    float    major_diameter;  // 4 standard deviations along each axis
+    float    minor_diameter;
+  };
+
+  /**
+    @brief  Color signature, as stored by Pixy in its "signature1" to
+            "signature7" parameters.
+  */
+  struct VisionSignature
+  {
+    int32_t  u_min;
+    int32_t  u_max;
+    int32_t  u_mean;
+    int32_t  v_min;
+    int32_t  v_max;
+    int32_t  v_mean;
+    uint32_t rgb;
+    uint32_t type;
+  };
+
+  /**
+    @brief  Creates a vision engine with no signatures and Pixy's
+            default parameters.
+    @return Engine handle, or NULL if out of memory.
+  */
+  struct PixyVision * pixyvision_create();
+
+  void pixyvision_destroy(struct PixyVision * vision);
+
+  /**
+    @brief      Sets a color signature. A signature with zero u_min and
+                u_max is disabled.
+    @param[in]  signum  Signature number, 1 to PIXYVISION_MAX_SIGNATURE.
+    @return     0      Success
+    @return     Negative  Error
+  */
+  int pixyvision_set_signature(struct PixyVision * vision, uint8_t signum, const struct VisionSignature * signature);
+
+  int pixyvision_get_signature(struct PixyVision * vision, uint8_t signum, struct VisionSignature * signature);
+
+  /**
+    @brief      Teaches a signature from a rectangle of a raw Bayer frame,
+                as PixyMon's "Set signature" does, and sets it. The result
+                can be sent to Pixy with pixy_cam_set_signature().
+    @param[in]  frame      width * height bytes, as for pixyvision_process_frame().
+    @param[in]  x, y       Top left corner of the rectangle, in pixels.
+    @param[in]  w, h       Size of the rectangle, at least 2x2 and inside the frame.
+    @param[out] signature  The new signature. May be NULL.
+    @return     0      Success
+    @return     PIXYVISION_ERROR_INVALID_PARAMETER
+  */
+  int pixyvision_train_region(struct PixyVision * vision, uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                              uint16_t x, uint16_t y, uint16_t w, uint16_t h, struct VisionSignature * signature);
+
+  /**
+    @brief      Same as pixyvision_train_region(), but grows the region
+                from a seed pixel while its color stays close, as Pixy's
+                button training does.
+  */
+  int pixyvision_train_seed(struct PixyVision * vision, uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                            uint16_t x, uint16_t y, struct VisionSignature * signature);
+
+  /**
+    @brief      Sets the range of a signature, as Pixy's "Signature N range"
+                parameter. Larger values accept more colors.
+  */
+  int pixyvision_set_signature_range(struct PixyVision * vision, uint8_t signum, float range);
+
+  /**
+    @brief      Sets the minimum brightness, as Pixy's "Min brightness"
+                parameter, in [0.0, 1.0].
+  */
+  int pixyvision_set_min_brightness(struct PixyVision * vision, float brightness);
+
+  /**
+    @brief      Sets the blob parameters.
+    @param[in]  max_blocks                Maximum blocks per frame.
+    @param[in]  max_blocks_per_signature  Maximum blocks per signature.
+    @param[in]  min_area                  Minimum block area in pixels.
+    @param[in]  cc_mode                   One of the PIXYVISION_CC_ modes.
+  */
+  int pixyvision_set_params(struct PixyVision * vision, uint16_t max_blocks, uint16_t max_blocks_per_signature, uint32_t min_area, uint8_t cc_mode);
+
+  /**
+    @brief      Selects how pixels are checked against the signature bounds.
+                PIXYVISION_CLASSIFIER_EXACT (default) divides the chroma of
+                each pixel by its brightness, as Pixy does.
+                PIXYVISION_CLASSIFIER_TABLE looks the result up in a 192 KB
+                table quantized by color and brightness instead. It is
+                faster, but pixels close to the edges of a signature may be
+                classified differently.
+    @return     0      Success
+    @return     PIXYVISION_ERROR_INVALID_PARAMETER
+  */
+  int pixyvision_set_classifier(struct PixyVision * vision, uint8_t classifier);
+
+  /**
+    @brief      Sets the number of threads that assemble blobs. Each
+                signature is assembled on its own thread, so frames with
+                several signatures take about as long as the busiest one.
+                The blocks don't depend on the number of threads.
+    @param[in]  threads  1 (default) assembles on the calling thread, 0
+                         uses one thread per core. At most
+                         PIXYVISION_MAX_SIGNATURE threads are used.
+    @return     0      Success
+    @return     PIXYVISION_ERROR_THREAD  Threads could not be started,
+                                         blobs are assembled serially.
+  */
+  int pixyvision_set_threads(struct PixyVision * vision, uint8_t threads);
+
+  /**
+    @brief      Finds the blocks of a raw Bayer frame (BGGR, as sent by
+                Pixy). Replaces the blocks of the previous frame.
+    @param[in]  frame   width * height bytes.
+    @return     Number of blocks found
+    @return     PIXYVISION_ERROR_INVALID_PARAMETER
+    @return     PIXYVISION_ERROR_OVERRUN  The frame had more segments or
+                                          blobs than could be stored, it
+                                          has no blocks.
+  */
+  int pixyvision_process_frame(struct PixyVision * vision, const uint8_t * frame, uint16_t width, uint16_t height);
+
+  /**
+    @brief      Copies the blocks of the last processed frame, normal
+                blocks first, then color code blocks.
+    @return     Number of blocks copied
+  */
+  int pixyvision_get_blocks(struct PixyVision * vision, uint16_t max_blocks, struct VisionBlock * blocks);
+
+  /**
+    @brief      Copies the stats of the blocks of the last processed frame,
+                in the order of pixyvision_get_blocks().
+    @return     Number of stats copied
+    @return     PIXYVISION_ERROR_INVALID_PARAMETER
+    @return     PIXYVISION_ERROR_UNSUPPORTED  Built without PIXYVISION_STATS
+  */
+  int pixyvision_get_block_stats(struct PixyVision * vision, uint16_t max_blocks, struct VisionBlockStats * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <new>
+#include "pixyvision.h"
+#include "visionengine.hpp"
+
+// A PixyVision handle is a VisionEngine //
+struct PixyVision : public VisionEngine
+{
+};
+
+extern "C"
+{
+  struct PixyVision * pixyvision_create()
+  {
+    return new (std::nothrow) PixyVision;
+  }
+
+  void pixyvision_destroy(struct PixyVision * vision)
+  {
+    delete vision;
+  }
+
+  int pixyvision_set_signature(struct PixyVision * vision, uint8_t signum, const struct VisionSignature * signature)
+  {
+    if (vision == 0 || signature == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->set_signature(signum, *signature);
+  }
+
+  int pixyvision_get_signature(struct PixyVision * vision, uint8_t signum, struct VisionSignature * signature)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->get_signature(signum, signature);
+  }
+
+  int pixyvision_train_region(struct PixyVision * vision, uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                              uint16_t x, uint16_t y, uint16_t w, uint16_t h, struct VisionSignature * signature)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->train_region(signum, frame, width, height, x, y, w, h, signature);
+  }
+
+  int pixyvision_train_seed(struct PixyVision * vision, uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                            uint16_t x, uint16_t y, struct VisionSignature * signature)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->train_seed(signum, frame, width, height, x, y, signature);
+  }
+
+  int pixyvision_set_signature_range(struct PixyVision * vision, uint8_t signum, float range)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->set_signature_range(signum, range);
+  }
+
+  int pixyvision_set_min_brightness(struct PixyVision * vision, float brightness)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->set_min_brightness(brightness);
+  }
+
+  int pixyvision_set_params(struct PixyVision * vision, uint16_t max_blocks, uint16_t max_blocks_per_signature, uint32_t min_area, uint8_t cc_mode)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->set_params(max_blocks, max_blocks_per_signature, min_area, cc_mode);
+  }
+
+  int pixyvision_set_classifier(struct PixyVision * vision, uint8_t classifier)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->set_classifier(classifier);
+  }
+
+  int pixyvision_set_threads(struct PixyVision * vision, uint8_t threads)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->set_threads(threads);
+  }
+
+  int pixyvision_process_frame(struct PixyVision * vision, const uint8_t * frame, uint16_t width, uint16_t height)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->process_frame(frame, width, height);
+  }
+
+  int pixyvision_get_blocks(struct PixyVision * vision, uint16_t max_blocks, struct VisionBlock * blocks)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->get_blocks(max_blocks, blocks);
+  }
+
+  int pixyvision_get_block_stats(struct PixyVision * vision, uint16_t max_blocks, struct VisionBlockStats * stats)
+  {
+    if (vision == 0) {
+      return PIXYVISION_ERROR_INVALID_PARAMETER;
+    }
+
+    return vision->get_block_stats(max_blocks, stats);
+  }
+}
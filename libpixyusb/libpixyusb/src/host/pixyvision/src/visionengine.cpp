@@ -0,0 +1,432 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include <string.h>
+#include <new>
+#include "visionengine.hpp"
+#include "debug.h"
+
+// Qval column markers understood by Blobs::runlengthAnalysis() //
+#define QVAL_ROW_START      0x0000
+#define QVAL_OVERRUN        0xfffe
+#define QVAL_END_OF_FRAME   0xffff
+
+VisionEngine::VisionEngine() : queue_(), blobs_(&queue_, lut_) {
+	lut_dirty_ = false;
+	dirty_signatures_ = 0;
+	use_queue_ = false;
+	pool_      = 0;
+
+	blocks_.reserve(MAX_BLOBS);
+	moments_.reserve(MAX_BLOBS);
+	blobs_.setParams(PIXYVISION_MAX_BLOCKS, MAX_BLOBS_PER_MODEL, MIN_AREA, DISABLED);
+}
+
+VisionEngine::~VisionEngine() {
+	blobs_.setTaskRunner(0);
+	delete pool_;
+}
+
+int VisionEngine::set_signature(uint8_t signum, const VisionSignature & signature) {
+	ColorSignature color_signature;
+
+	if (signum < 1 || signum > PIXYVISION_MAX_SIGNATURE) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	color_signature.m_uMin  = signature.u_min;
+	color_signature.m_uMax  = signature.u_max;
+	color_signature.m_uMean = signature.u_mean;
+	color_signature.m_vMin  = signature.v_min;
+	color_signature.m_vMax  = signature.v_max;
+	color_signature.m_vMean = signature.v_mean;
+	color_signature.m_rgb   = signature.rgb;
+	color_signature.m_type  = signature.type;
+
+	blobs_.m_clut.setSignature(signum, color_signature);
+	dirty_signatures_ |= 1 << (signum - 1);
+
+	return 0;
+}
+
+int VisionEngine::get_signature(uint8_t signum, VisionSignature * signature) {
+	ColorSignature * color_signature;
+
+	if (signum < 1 || signum > PIXYVISION_MAX_SIGNATURE || signature == 0) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	color_signature = blobs_.m_clut.getSignature(signum);
+
+	signature->u_min  = color_signature->m_uMin;
+	signature->u_max  = color_signature->m_uMax;
+	signature->u_mean = color_signature->m_uMean;
+	signature->v_min  = color_signature->m_vMin;
+	signature->v_max  = color_signature->m_vMax;
+	signature->v_mean = color_signature->m_vMean;
+	signature->rgb    = color_signature->m_rgb;
+	signature->type   = color_signature->m_type;
+
+	return 0;
+}
+
+int VisionEngine::train_region(uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                               uint16_t x, uint16_t y, uint16_t w, uint16_t h, VisionSignature * signature) {
+	Frame8 frame8((uint8_t *)frame, width, height);
+	RectA  region(x, y, w, h);
+
+	if (signum < 1 || signum > PIXYVISION_MAX_SIGNATURE || frame == 0 || width > PIXYVISION_MAX_WIDTH || height > PIXYVISION_MAX_HEIGHT ||
+	    w < 2 || h < 2 || x + w > width || y + h > height) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	blobs_.m_clut.generateSignature(frame8, region, signum);
+
+	IterPixel pixels(frame8, region);
+	return trained(signum, pixels, signature);
+}
+
+int VisionEngine::train_seed(uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                             uint16_t x, uint16_t y, VisionSignature * signature) {
+	Frame8 frame8((uint8_t *)frame, width, height);
+	Points points;
+
+	if (signum < 1 || signum > PIXYVISION_MAX_SIGNATURE || frame == 0 || width > PIXYVISION_MAX_WIDTH || height > PIXYVISION_MAX_HEIGHT ||
+	    x + CL_GROW_INC > width || y + CL_GROW_INC > height) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	blobs_.m_clut.generateSignature(frame8, Point16(x, y), &points, signum);
+
+	IterPixel pixels(frame8, &points);
+	return trained(signum, pixels, signature);
+}
+
+int VisionEngine::trained(uint8_t signum, IterPixel & pixels, VisionSignature * signature) {
+	ColorSignature color_signature;
+
+	// generateSignature() leaves the color, which Pixy takes from the //
+	// average of the trained pixels                                   //
+
+	color_signature       = *blobs_.m_clut.getSignature(signum);
+	color_signature.m_rgb = pixels.averageRgb();
+	blobs_.m_clut.setSignature(signum, color_signature);
+	dirty_signatures_ |= 1 << (signum - 1);
+
+	return signature ? get_signature(signum, signature) : 0;
+}
+
+int VisionEngine::set_signature_range(uint8_t signum, float range) {
+	if (signum < 1 || signum > PIXYVISION_MAX_SIGNATURE || range <= 0.0f) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	blobs_.m_clut.setSigRange(signum, range);
+	dirty_signatures_ |= 1 << (signum - 1);
+
+	return 0;
+}
+
+int VisionEngine::set_min_brightness(float brightness) {
+	if (brightness < 0.0f || brightness > 1.0f) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	blobs_.m_clut.setMinBrightness(brightness);
+	lut_dirty_ = true;
+
+	return 0;
+}
+
+int VisionEngine::set_params(uint16_t max_blocks, uint16_t max_blocks_per_signature, uint32_t min_area, uint8_t cc_mode) {
+	if (cc_mode > PIXYVISION_CC_MIXED) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	return blobs_.setParams(max_blocks, max_blocks_per_signature, min_area, (ColorCodeMode)cc_mode);
+}
+
+int VisionEngine::set_classifier(uint8_t classifier) {
+	if (classifier != PIXYVISION_CLASSIFIER_EXACT && classifier != PIXYVISION_CLASSIFIER_TABLE) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	// The table follows the signatures from the next LUT update on //
+
+	return blobs_.m_clut.setClassifier(classifier == PIXYVISION_CLASSIFIER_TABLE ? CL_CLASSIFIER_TABLE : CL_CLASSIFIER_EXACT);
+}
+
+int VisionEngine::set_threads(uint8_t threads) {
+	if (threads == 0) {
+		threads = boost::thread::hardware_concurrency();
+	}
+	if (threads > PIXYVISION_MAX_SIGNATURE) {
+		threads = PIXYVISION_MAX_SIGNATURE;
+	}
+
+	blobs_.setTaskRunner(0);
+	delete pool_;
+	pool_ = 0;
+	queue_.setBlocking(false);
+
+	if (threads > 1) {
+		try {
+			pool_ = new WorkPool(threads);
+		}
+		catch (...) {
+			DBG("pixyvision: cannot start %d threads", threads);
+			return PIXYVISION_ERROR_THREAD;
+		}
+		blobs_.setTaskRunner(pool_);
+
+		// The queue path streams from a decoder thread, see process_frame() //
+		if (queue_.setBlocking(true) < 0) {
+			return PIXYVISION_ERROR_THREAD;
+		}
+	}
+
+	return 0;
+}
+
+int VisionEngine::set_bands(uint8_t bands) {
+	return blobs_.setBands(bands) < 0 ? PIXYVISION_ERROR_INVALID_PARAMETER : 0;
+}
+
+int VisionEngine::process_frame(const uint8_t * frame, uint16_t width, uint16_t height) {
+	int           return_value;
+	uint8_t       signum;
+	boost::thread decoder;
+
+	if (frame == 0 || width < 2 || height < 2 || width > PIXYVISION_MAX_WIDTH || height > PIXYVISION_MAX_HEIGHT) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	// Signature changes only regenerate their own LUT bins //
+
+	if (lut_dirty_) {
+		blobs_.m_clut.generateLUT();
+		lut_dirty_ = false;
+		dirty_signatures_ = 0;
+	}
+	for (signum = 1; dirty_signatures_; ++signum, dirty_signatures_ >>= 1) {
+		if (dirty_signatures_ & 1) {
+			blobs_.m_clut.updateLUT(signum);
+		}
+	}
+
+	blocks_.clear();
+	moments_.clear();
+
+	if (use_queue_ && pool_) {
+		// A decoder thread streams the Qvals to blobify() through the //
+		// blocking queue, as Pixy's M0 core does, so no frame is too   //
+		// large for the queue                                          //
+		try {
+			decoder = boost::thread(&VisionEngine::queue_frame, this, frame, width, height, true);
+		}
+		catch (...) {
+			return PIXYVISION_ERROR_THREAD;
+		}
+		return_value = blobs_.blobify();
+		decoder.join();
+
+		if (return_value < 0) {
+			DBG("pixyvision: cannot assemble the blobs of %dx%d frame", width, height);
+			return PIXYVISION_ERROR_OVERRUN;
+		}
+	}
+	else if (use_queue_) {
+		return_value = queue_frame(frame, width, height, false);
+
+		if (blobs_.blobify() < 0 || return_value < 0) {
+			DBG("pixyvision: queue overrun on %dx%d frame", width, height);
+			return PIXYVISION_ERROR_OVERRUN;
+		}
+	}
+	else if (blobs_.blobify(Frame8((uint8_t *)frame, width, height)) < 0) {
+		DBG("pixyvision: cannot assemble the blobs of %dx%d frame", width, height);
+		return PIXYVISION_ERROR_OVERRUN;
+	}
+
+	gather_blocks();
+
+	return blocks_.size();
+}
+
+int VisionEngine::get_blocks(uint16_t max_blocks, VisionBlock * blocks) const {
+	uint16_t count;
+
+	if (blocks == 0) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	count = (blocks_.size() < max_blocks ? blocks_.size() : max_blocks);
+	if (count) {
+		memcpy(blocks, &blocks_[0], count * sizeof(VisionBlock));
+	}
+
+	return count;
+}
+
+int VisionEngine::get_block_stats(uint16_t max_blocks, VisionBlockStats * stats) const {
+#ifdef INCLUDE_STATS
+	SMoments     moments;
+	SMomentStats moment_stats;
+	uint16_t     count;
+	uint16_t     index;
+
+	if (stats == 0) {
+		return PIXYVISION_ERROR_INVALID_PARAMETER;
+	}
+
+	// Blob rows count line pairs: y doubles, and every row stands for //
+	// two lines of the same pixels, which only doubles the area.       //
+
+	count = (moments_.size() < max_blocks ? moments_.size() : max_blocks);
+	for (index = 0; index != count; ++index) {
+		moments        = moments_[index];
+		moments.sumY  *= 2;
+		moments.sumXY *= 2;
+		moments.sumYY *= 4;
+		moments.GetStats(moment_stats);
+
+		stats[index].area           = moment_stats.area * 2;
+		stats[index].x              = moment_stats.centroidX;
+		stats[index].y              = moment_stats.centroidY;
+		stats[index].angle          = moment_stats.angle;
+		stats[index].major_diameter = moment_stats.majorDiameter;
+		stats[index].minor_diameter = moment_stats.minorDiameter;
+	}
+
+	return count;
+#else
+	return PIXYVISION_ERROR_UNSUPPORTED;
+#endif
+}
+
+void VisionEngine::set_use_queue(bool use_queue) {
+	use_queue_ = use_queue;
+}
+
+void VisionEngine::set_use_grid(bool use_grid) {
+	blobs_.setUseGrid(use_grid);
+}
+
+void VisionEngine::get_runlengths(uint32_t ** runlengths, uint32_t * length) {
+	blobs_.getRunlengths(runlengths, length);
+}
+
+int VisionEngine::queue_frame(const uint8_t * frame, uint16_t width, uint16_t height, bool stream) {
+	const uint8_t * pixels;
+	uint32_t        queued;
+	uint32_t        count;
+	uint16_t        x;
+	uint16_t        y;
+	int32_t         r;
+	int32_t         g1;
+	int32_t         g2;
+	int32_t         b;
+	uint8_t         signature;
+	Qval            qval;
+	Qval            row[PIXYVISION_MAX_WIDTH / 2 + 1];
+
+	// Pixy's M0 core: every odd pixel of every odd line is a 2x2 Bayer //
+	// cell (red at the pixel itself). Only cells whose color hits the  //
+	// lookup table are queued, each line is preceded by a row start.   //
+	// Each line is queued at once.                                      //
+
+	queued = 0;
+
+	for (y = 1; y < height; y += 2) {
+		pixels = frame + (uint32_t)y * width;
+		row[0] = Qval(0, 0, 0, QVAL_ROW_START);
+		count  = 1;
+
+		for (x = 1; x < width; x += 2) {
+			r  = pixels[x];
+			g1 = pixels[x - 1];
+			g2 = pixels[x - width];
+			b  = pixels[x - width - 1];
+
+			signature = lut_[((((r - g1) >> 3) & 0x3f) << 6) | (((b - g2) >> 3) & 0x3f)];
+			if (signature != 0) {
+				row[count++] = Qval(r - g1, b - g2, r + g1 + b, (x << 3) | signature);
+			}
+		}
+
+		// Unless streaming, always leave room for the final marker //
+		queued += count;
+		if (!stream && queued >= QQ_MEM_SIZE) {
+			break;
+		}
+		queue_.enqueue(row, count);
+	}
+
+	if (y < height) {
+		qval = Qval(0, 0, 0, QVAL_OVERRUN);
+		queue_.enqueue(&qval);
+		return PIXYVISION_ERROR_OVERRUN;
+	}
+
+	qval = Qval(0, 0, 0, QVAL_END_OF_FRAME);
+	queue_.enqueue(&qval);
+
+	return 0;
+}
+
+void VisionEngine::gather_blocks() {
+	BlobA *  blobs;
+	BlobB *  cc_blobs;
+	uint32_t count;
+	uint32_t cc_count;
+	uint32_t index;
+#ifdef INCLUDE_STATS
+	SMoments * moments;
+	SMoments * cc_moments;
+#endif
+
+	blobs_.getBlobs(&blobs, &count, &cc_blobs, &cc_count);
+#ifdef INCLUDE_STATS
+	blobs_.getMoments(&moments, &cc_moments);
+	moments_.insert(moments_.end(), moments, moments + count);
+	moments_.insert(moments_.end(), cc_moments, cc_moments + cc_count);
+#endif
+
+	for (index = 0; index != count; ++index) {
+		add_block(PIXYVISION_BLOCKTYPE_NORMAL, blobs[index].m_model, blobs[index].m_left, blobs[index].m_right,
+		          blobs[index].m_top, blobs[index].m_bottom, 0);
+	}
+
+	for (index = 0; index != cc_count; ++index) {
+		add_block(PIXYVISION_BLOCKTYPE_COLOR_CODE, cc_blobs[index].m_model, cc_blobs[index].m_left, cc_blobs[index].m_right,
+		          cc_blobs[index].m_top, cc_blobs[index].m_bottom, cc_blobs[index].m_angle);
+	}
+}
+
+void VisionEngine::add_block(uint16_t type, uint16_t model, uint16_t left, uint16_t right, uint16_t top, uint16_t bottom, int16_t angle) {
+	VisionBlock block;
+
+	// Blob rows count line pairs, scale them back to frame lines //
+
+	block.type      = type;
+	block.signature = model;
+	block.width     = right - left;
+	block.height    = (bottom - top) * 2;
+	block.x         = left + block.width / 2;
+	block.y         = top * 2 + block.height / 2;
+	block.angle     = angle;
+
+	blocks_.push_back(block);
+}
@@ -0,0 +1,107 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __VISIONENGINE_HPP__
+#define __VISIONENGINE_HPP__
+
+#include <stdint.h>
+#include <vector>
+#include "pixyvision.h"
+#include "blobs.h"
+#include "workpool.hpp"
+
+/**
+  @brief  Host side of Pixy's color connected components pipeline.
+          Runs the same Blobs and ColorLUT code as Pixy's M4 core. By
+          default the run lengths come straight from the Bayer frame
+          (Blobs::blobify(const Frame8 &)); the queue path does the work
+          of Pixy's M0 core instead (Bayer pixels to LUT-matched Qvals)
+          and is kept as the reference implementation.
+*/
+class VisionEngine
+{
+  public:
+
+    VisionEngine();
+    ~VisionEngine();
+
+    int set_signature(uint8_t signum, const VisionSignature & signature);
+    int get_signature(uint8_t signum, VisionSignature * signature);
+    int set_signature_range(uint8_t signum, float range);
+    int train_region(uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                     uint16_t x, uint16_t y, uint16_t w, uint16_t h, VisionSignature * signature);
+    int train_seed(uint8_t signum, const uint8_t * frame, uint16_t width, uint16_t height,
+                   uint16_t x, uint16_t y, VisionSignature * signature);
+    int set_min_brightness(float brightness);
+    int set_params(uint16_t max_blocks, uint16_t max_blocks_per_signature, uint32_t min_area, uint8_t cc_mode);
+    int set_classifier(uint8_t classifier);
+    int set_threads(uint8_t threads);
+
+    int process_frame(const uint8_t * frame, uint16_t width, uint16_t height);
+    int get_blocks(uint16_t max_blocks, VisionBlock * blocks) const;
+    int get_block_stats(uint16_t max_blocks, VisionBlockStats * stats) const;
+
+    /**
+      @brief  Selects the Qqueue path instead of the row kernel. Both
+              produce the same blocks with PIXYVISION_CLASSIFIER_EXACT.
+              The queue path always uses the exact classifier. With more
+              than one thread, a decoder thread streams the Qvals to the
+              calling thread, and frames of any size fit the queue.
+    */
+    void set_use_queue(bool use_queue);
+
+    /**
+      @brief  Compares every pair of blobs when merging and removing
+              enclosed blobs instead of using the grid index, see
+              Blobs::setUseGrid(). Same blocks either way.
+    */
+    void set_use_grid(bool use_grid);
+
+    /**
+      @brief  Splits each signature into 1 (default) to BA_MAX_BANDS
+              horizontal bands, assembled on separate threads, see
+              CBandAssembler. Not in pixyvision.h, as the blocks differ
+              from serial assembly where a blob connects only through the
+              span of its bottom row; bench/bands.cpp counts them. Has no
+              effect with a single thread.
+      @return 0  Success
+      @return PIXYVISION_ERROR_INVALID_PARAMETER
+    */
+    int set_bands(uint8_t bands);
+
+    /**
+      @brief  Run lengths of the last frame, see Blobs::getRunlengths().
+    */
+    void get_runlengths(uint32_t ** runlengths, uint32_t * length);
+
+  private:
+
+    uint8_t                  lut_[CL_LUT_SIZE];
+    Qqueue                   queue_;
+    Blobs                    blobs_;
+    bool                     lut_dirty_;         // regenerate the whole LUT
+    uint8_t                  dirty_signatures_;  // or these, bit signum - 1
+    bool                     use_queue_;
+    WorkPool *               pool_;
+    std::vector<VisionBlock> blocks_;
+    std::vector<SMoments>    moments_; // of each block, with INCLUDE_STATS
+
+    int  trained(uint8_t signum, IterPixel & pixels, VisionSignature * signature);
+    int  queue_frame(const uint8_t * frame, uint16_t width, uint16_t height, bool stream);
+    void gather_blocks();
+    void add_block(uint16_t type, uint16_t model, uint16_t left, uint16_t right, uint16_t top, uint16_t bottom, int16_t angle);
+};
+
+#endif
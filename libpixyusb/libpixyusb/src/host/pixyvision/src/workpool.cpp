@@ -0,0 +1,94 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#include "workpool.hpp"
+
+WorkPool::WorkPool(uint32_t threads) {
+	uint32_t index;
+
+	task_     = 0;
+	arg_      = 0;
+	count_    = 0;
+	next_     = 0;
+	finished_ = 0;
+	stop_     = false;
+
+	for (index = 1; index < threads; ++index) {
+		workers_.create_thread(boost::bind(&WorkPool::work, this));
+	}
+}
+
+WorkPool::~WorkPool() {
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	start_.notify_all();
+	workers_.join_all();
+}
+
+void WorkPool::run(void (*task)(void * arg, uint32_t index), void * arg, uint32_t count) {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+
+	// The previous run has finished every task, so no worker //
+	// is still using task_ or arg_.                          //
+
+	task_     = task;
+	arg_      = arg;
+	count_    = count;
+	next_     = 0;
+	finished_ = 0;
+	start_.notify_all();
+
+	run_tasks(lock);
+
+	while (finished_ < count_) {
+		done_.wait(lock);
+	}
+}
+
+void WorkPool::work() {
+	boost::unique_lock<boost::mutex> lock(mutex_);
+
+	while (true) {
+		while (!stop_ && next_ >= count_) {
+			start_.wait(lock);
+		}
+		if (stop_) {
+			return;
+		}
+		run_tasks(lock);
+	}
+}
+
+void WorkPool::run_tasks(boost::unique_lock<boost::mutex> & lock) {
+	void  (* task)(void * arg, uint32_t index);
+	void *   arg;
+	uint32_t index;
+
+	while (next_ < count_) {
+		task  = task_;
+		arg   = arg_;
+		index = next_++;
+
+		lock.unlock();
+		task(arg, index);
+		lock.lock();
+
+		if (++finished_ == count_) {
+			done_.notify_all();
+		}
+	}
+}
@@ -0,0 +1,57 @@
+//
+// begin license header
+//
+// This file is part of Pixy CMUcam5 or "Pixy" for short
+//
+// All Pixy source code is provided under the terms of the
+// GNU General Public License v2 (http://www.gnu.org/licenses/gpl-2.0.html).
+// Those wishing to use Pixy source code, software and/or
+// technologies under different licensing terms should contact us at
+// cmucam@cs.cmu.edu. Such licensing terms are available for
+// all portions of the Pixy codebase presented here.
+//
+// end license header
+//
+
+#ifndef __WORKPOOL_HPP__
+#define __WORKPOOL_HPP__
+
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include "blobs.h"
+
+/**
+  @brief  Small thread pool for per-frame tasks. The calling thread
+          works too, so a pool of N threads starts N - 1 workers. Idle
+          threads take the next unclaimed task in order, so tasks
+          should be queued longest first.
+*/
+class WorkPool : public TaskRunner
+{
+  public:
+
+    WorkPool(uint32_t threads);
+    ~WorkPool();
+
+    void run(void (*task)(void * arg, uint32_t index), void * arg, uint32_t count);
+
+  private:
+
+    boost::thread_group       workers_;
+    boost::mutex              mutex_;
+    boost::condition_variable start_;
+    boost::condition_variable done_;
+    void                   (* task_)(void * arg, uint32_t index);
+    void *                    arg_;
+    uint32_t                  count_;
+    uint32_t                  next_;
+    uint32_t                  finished_;
+    bool                      stop_;
+
+    void work();
+
+    // Runs claimed tasks until none is left, 'lock' is held in between //
+    void run_tasks(boost::unique_lock<boost::mutex> & lock);
+};
+
+#endif